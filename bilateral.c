@@ -0,0 +1,351 @@
+/* Copyright (C) 2013 Henry Gomersall <heng@cantab.net> 
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the organization nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY  THE AUTHOR ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+/* The bilateral filter,
+ *     out(p) = sum_q w(p, q) in(q) / sum_q w(p, q)
+ *     w(p, q) = exp(-|p - q|^2 / (2 sigma_space^2)
+ *                   - (in(p) - in(q))^2 / (2 sigma_range^2))
+ * over the window around p.
+ *
+ * Small windows are done directly, a vector of outputs at a time: for
+ * each offset in the window the neighbours of the whole vector are one
+ * unaligned load, as for the direct 2D convolution. The weight is
+ * needed for every tap, so rather than a call to expf it is the limit
+ *     exp(-y) = lim (1 - y/n)^n
+ * with n = 256, which is a multiply-add, a max and eight squarings, and
+ * is within 1.1e-3 of the exponential for all y >= 0, the worst being
+ * near y = 2.
+ *
+ * Large windows use the bilateral grid (Paris and Durand, "A Fast
+ * Approximation of the Bilateral Filter using a Signal Processing
+ * Approach", 2006). The image is splatted into a 3D grid, x by y by value,
+ * sampled every sigma_space pixels and every sigma_range in value, of the
+ * sum of the values and the count of the pixels landing in each cell. A
+ * Gaussian blur of the grid, one cell wide along every axis, is then the
+ * bilateral filter's sums at the grid's resolution, which is done with
+ * the separable 3D convolution in convolve_2d.c. Each output is read back
+ * from the blurred grid by trilinear interpolation at its position and
+ * value. The cost no longer depends on the window, and the window is not
+ * truncated at ``radius'', which only sets the output's size. The grid
+ * has a slice for every sigma_range of the image's range of values, so
+ * a sigma_range that is tiny against that range can make it too big to
+ * index with an int, and the filter then returns -1.
+ * */
+
+#include "bilateral.h"
+#include "convolve_2d.h"
+#include "simd.h"
+
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef SSE3
+
+/* The widest instruction set that is built. */
+#if defined(AVX512)
+#define SIMD_ISA avx512
+#elif defined(AVX)
+#define SIMD_ISA avx
+#else
+#define SIMD_ISA sse
+#endif
+
+/* Above this radius the grid is faster. Found by timing 1920x1080 with
+ * sigma_space = radius/2 and AVX-512.
+ * */
+#define DIRECT_MAX_RADIUS 4
+
+/* The blur of the grid is a Gaussian of one cell, to two cells each
+ * side.
+ * */
+#define GRID_KERNEL_LENGTH 5
+#define GRID_PAD (GRID_KERNEL_LENGTH/2)
+
+/* exp(-y) as (1 - y/256)^256; ``x'' is already 1 - y/256. */
+static inline __attribute__ ((always_inline))
+SIMD_T _exp_limit(SIMD_T x)
+{
+    x = SIMD_OP(max)(x, SIMD_OP(zero)());
+    for(int i=0; i<8; i++){
+        x = SIMD_OP(mul)(x, x);
+    }
+    return x;
+}
+
+static inline float _exp_limit_scalar(float x)
+{
+    x = x > 0.0f ? x : 0.0f;
+    for(int i=0; i<8; i++){
+        x *= x;
+    }
+    return x;
+}
+
+static int _bilateral_direct(float* in, float* out, int cols, int rows,
+        int radius, float sigma_space, float sigma_range)
+{
+    int window = 2*radius + 1;
+    int out_cols = cols - 2*radius;
+    int out_rows = rows - 2*radius;
+
+    // The weight of each tap is (1 - spatial - diff^2 * range_scale)^256
+    float spatial[window*window];
+    float range_scale = 1.0f / (2*sigma_range*sigma_range*256);
+
+    for(int dy=0; dy<window; dy++){
+        for(int dx=0; dx<window; dx++){
+            float distance = (dx - radius)*(dx - radius)
+                + (dy - radius)*(dy - radius);
+            spatial[dy*window + dx] = 1.0f - distance
+                / (2*sigma_space*sigma_space*256);
+        }
+    }
+
+    #pragma omp parallel for
+    for(int row=0; row<out_rows; row++){
+
+        SIMD_T spatial_v[window*window];
+        SIMD_T minus_range_scale = SIMD_OP(set1)(-range_scale);
+
+        for(int i=0; i<window*window; i++){
+            spatial_v[i] = SIMD_OP(set1)(spatial[i]);
+        }
+
+        float* centre_row = in + (row + radius)*cols + radius;
+        float* out_row = out + row*out_cols;
+
+        int c = 0;
+        for(; c<=out_cols - SIMD_WIDTH; c+=SIMD_WIDTH){
+
+            SIMD_T centre = SIMD_OP(loadu)(centre_row + c);
+            SIMD_T sum = SIMD_OP(zero)();
+            SIMD_T total_weight = SIMD_OP(zero)();
+
+            for(int dy=0; dy<window; dy++){
+                float* in_row = in + (row + dy)*cols + c;
+
+                for(int dx=0; dx<window; dx++){
+                    SIMD_T value = SIMD_OP(loadu)(in_row + dx);
+                    SIMD_T diff = SIMD_OP(sub)(value, centre);
+                    SIMD_T weight = _exp_limit(SIMD_OP(fmadd)(
+                                SIMD_OP(mul)(diff, diff), minus_range_scale,
+                                spatial_v[dy*window + dx]));
+
+                    sum = SIMD_OP(fmadd)(weight, value, sum);
+                    total_weight = SIMD_OP(add)(total_weight, weight);
+                }
+            }
+
+            // The centre's own weight is 1, so this is never 0/0
+            SIMD_OP(storeu)(out_row + c, SIMD_OP(div)(sum, total_weight));
+        }
+
+        for(; c<out_cols; c++){
+
+            float centre = centre_row[c];
+            float sum = 0.0f;
+            float total_weight = 0.0f;
+
+            for(int dy=0; dy<window; dy++){
+                for(int dx=0; dx<window; dx++){
+                    float value = in[(row + dy)*cols + c + dx];
+                    float diff = value - centre;
+                    float weight = _exp_limit_scalar(
+                            spatial[dy*window + dx]
+                            - diff*diff*range_scale);
+
+                    sum += weight*value;
+                    total_weight += weight;
+                }
+            }
+            out_row[c] = sum / total_weight;
+        }
+    }
+
+    return 0;
+}
+
+static int _bilateral_grid(float* in, float* out, int cols, int rows,
+        int radius, float sigma_space, float sigma_range)
+{
+    int out_cols = cols - 2*radius;
+    int out_rows = rows - 2*radius;
+
+    float lowest = in[0];
+    float highest = in[0];
+    for(int i=1; i<cols*rows; i++){
+        lowest = in[i] < lowest ? in[i] : lowest;
+        highest = in[i] > highest ? in[i] : highest;
+    }
+
+    float space_scale = 1.0f / sigma_space;
+    float range_scale = 1.0f / sigma_range;
+
+    // The grid's extent, with the same products as the slicing below so
+    // that rounding can't put the last pixel or value past the grid
+    float last_x = (cols - 1)*space_scale;
+    float last_y = (rows - 1)*space_scale;
+    float last_z = (highest - lowest)*range_scale;
+
+    // The blurred grid, with one more cell each way for the interpolation
+    double cells = ((double) last_x + 2 + 2*GRID_PAD)
+        * ((double) last_y + 2 + 2*GRID_PAD)
+        * ((double) last_z + 2 + 2*GRID_PAD);
+    if (!(cells <= INT_MAX)){
+        return -1;
+    }
+
+    int grid_cols = (int) last_x + 2;
+    int grid_rows = (int) last_y + 2;
+    int grid_slices = (int) last_z + 2;
+
+    // The splatted grid, padded for the valid part of the blur to be all
+    int padded_cols = grid_cols + 2*GRID_PAD;
+    int padded_rows = grid_rows + 2*GRID_PAD;
+    int padded_slices = grid_slices + 2*GRID_PAD;
+
+    int padded_length = padded_cols*padded_rows*padded_slices;
+    int grid_length = grid_cols*grid_rows*grid_slices;
+    int plane = grid_cols*grid_rows;
+
+    float* sums = calloc(padded_length, sizeof(float));
+    float* counts = calloc(padded_length, sizeof(float));
+    float* blurred_sums = malloc(grid_length*sizeof(float));
+    float* blurred_counts = malloc(grid_length*sizeof(float));
+
+    if (sums == NULL || counts == NULL || blurred_sums == NULL
+            || blurred_counts == NULL){
+        free(sums);
+        free(counts);
+        free(blurred_sums);
+        free(blurred_counts);
+        return -1;
+    }
+
+    float kernel[GRID_KERNEL_LENGTH];
+    for(int i=0; i<GRID_KERNEL_LENGTH; i++){
+        kernel[i] = expf(-0.5f * (i - GRID_PAD)*(i - GRID_PAD));
+    }
+
+    // Splat each pixel into its nearest cell
+    for(int row=0; row<rows; row++){
+        int y = (int) (row*space_scale + 0.5f) + GRID_PAD;
+
+        for(int col=0; col<cols; col++){
+            float value = in[row*cols + col];
+            int x = (int) (col*space_scale + 0.5f) + GRID_PAD;
+            int z = (int) ((value - lowest)*range_scale + 0.5f) + GRID_PAD;
+
+            int cell = (z*padded_rows + y)*padded_cols + x;
+            sums[cell] += value;
+            counts[cell] += 1.0f;
+        }
+    }
+
+    int failed = convolve_sse_3d_separable(sums, blurred_sums, padded_cols,
+            padded_rows, padded_slices, kernel, GRID_KERNEL_LENGTH);
+    failed |= convolve_sse_3d_separable(counts, blurred_counts, padded_cols,
+            padded_rows, padded_slices, kernel, GRID_KERNEL_LENGTH);
+
+    if (failed){
+        free(sums);
+        free(counts);
+        free(blurred_sums);
+        free(blurred_counts);
+        return -1;
+    }
+
+    // Slice the blurred grid at each output's position and value
+    #pragma omp parallel for
+    for(int row=0; row<out_rows; row++){
+
+        float gy = (row + radius)*space_scale;
+        int y = (int) gy;
+        float fy = gy - y;
+
+        for(int col=0; col<out_cols; col++){
+
+            float value = in[(row + radius)*cols + col + radius];
+
+            float gx = (col + radius)*space_scale;
+            float gz = (value - lowest)*range_scale;
+            int x = (int) gx;
+            int z = (int) gz;
+            float fx = gx - x;
+            float fz = gz - z;
+
+            int cell = (z*grid_rows + y)*grid_cols + x;
+            float sum = 0.0f;
+            float count = 0.0f;
+
+            for(int k=0; k<8; k++){
+                int dx = k & 1;
+                int dy = (k >> 1) & 1;
+                int dz = k >> 2;
+
+                float weight = (dx ? fx : 1.0f - fx)
+                    * (dy ? fy : 1.0f - fy) * (dz ? fz : 1.0f - fz);
+                int corner = cell + dz*plane + dy*grid_cols + dx;
+
+                sum += weight*blurred_sums[corner];
+                count += weight*blurred_counts[corner];
+            }
+
+            out[row*out_cols + col] = count > 0.0f ? sum / count : value;
+        }
+    }
+
+    free(sums);
+    free(counts);
+    free(blurred_sums);
+    free(blurred_counts);
+
+    return 0;
+}
+
+int convolve_sse_2d_bilateral(float* in, float* out, int cols, int rows,
+        int radius, float sigma_space, float sigma_range)
+{
+    // Written so that NaN sigmas fail too
+    if (radius < 0 || !(sigma_space > 0.0f) || !(sigma_range > 0.0f)){
+        return -1;
+    }
+    if (cols <= 2*radius || rows <= 2*radius){
+        return 0;
+    }
+
+    if (radius <= DIRECT_MAX_RADIUS){
+        return _bilateral_direct(in, out, cols, rows, radius, sigma_space,
+                sigma_range);
+    }
+    return _bilateral_grid(in, out, cols, rows, radius, sigma_space,
+            sigma_range);
+}
+
+#endif
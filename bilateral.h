@@ -0,0 +1,48 @@
+/* Copyright (C) 2013 Henry Gomersall <heng@cantab.net> 
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the organization nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY  THE AUTHOR ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+#ifndef _BILATERAL_H
+#define _BILATERAL_H
+
+/* The bilateral filter, an edge preserving blur: each output is the
+ * average of the window around it, weighted by a Gaussian of distance
+ * (sigma_space) times a Gaussian of the difference in value
+ * (sigma_range). See bilateral.c.
+ *
+ * As for the convolutions, only the valid part is computed: the window
+ * is (2*radius+1) x (2*radius+1), so ``out'' is
+ * (cols-2*radius) x (rows-2*radius), and nothing is written if the
+ * image is smaller than the window. Returns 0, or -1 if radius is
+ * negative, either sigma is not positive, or the bilateral grid would
+ * be too big or runs out of memory.
+ * */
+#ifdef SSE3
+int convolve_sse_2d_bilateral(float* in, float* out, int cols, int rows,
+        int radius, float sigma_space, float sigma_range);
+#endif
+
+#endif /* Header guard */
@@ -26,8 +26,10 @@
  */
 
 #include "convolve.h"
+#include "simd.h"
 #include <string.h>
 #include <stdio.h>
+#include <math.h>
 
 #define SSE_SIMD_LENGTH 4
 #define AVX_SIMD_LENGTH 8
@@ -83,8 +85,41 @@ int convolve_reversed_naive(float* in, float* out, int length,
     return 0;
 }
 
+/* Instantiate the generic kernels, and the strategy kernel the hand tuned
+ * kernels below are built from, for each instruction set.
+ * */
 #ifdef SSE3
+#define SIMD_ISA sse
+#include "convolve_template.h"
+#undef SIMD_ISA
+#endif
+
+#ifdef AVX
+#define SIMD_ISA avx
+#include "convolve_template.h"
+#undef SIMD_ISA
+#endif
+
+#ifdef AVX512
+#define SIMD_ISA avx512
+#include "convolve_template.h"
+#undef SIMD_ISA
+#endif
+
+#ifdef NEON
+#define SIMD_ISA neon
+#include "convolve_template.h"
+#undef SIMD_ISA
+#endif
+
+/* The hand tuned kernels. Each one is a step in tuning the convolution,
+ * and is the strategy kernel of convolve_template.h with that step's
+ * choices:
+ *     convolve_<isa>_strategy(in, out, length, kernel, kernel_length,
+ *             n_acc, tap_unroll, copies, load, fused, local)
+ * */
 
+#ifdef SSE3
 
 /* Vectorize the algorithm to compute 4 output samples in parallel.
  *
@@ -100,47 +135,8 @@ int convolve_reversed_naive(float* in, float* out, int length,
 int convolve_sse_simple(float* in, float* out, int length,
         float* kernel, int kernel_length)
 {
-    __m128 kernel_reverse[kernel_length] __attribute__ ((aligned (16)));    
-    __m128 data_block __attribute__ ((aligned (16)));
-
-    __m128 prod __attribute__ ((aligned (16)));
-    __m128 acc __attribute__ ((aligned (16)));
-
-    // Reverse the kernel and repeat each value across a 4-vector
-    for(int i=0; i<kernel_length; i++){
-        kernel_reverse[i] = _mm_set1_ps(kernel[kernel_length - i - 1]);
-    }
-
-    for(int i=0; i<length-kernel_length; i+=4){
-
-        // Zero the accumulator
-        acc = _mm_setzero_ps();
-
-        /* After this loop, we have computed 4 output samples
-         * for the price of one.
-         * */
-        for(int k=0; k<kernel_length; k++){
-
-            // Load 4-float data block. These needs to be an unaliged
-            // load (_mm_loadu_ps) as we step one sample at a time.
-            data_block = _mm_loadu_ps(in + i + k);
-            prod = _mm_mul_ps(kernel_reverse[k], data_block);
-
-            // Accumulate the 4 parallel values
-            acc = _mm_add_ps(acc, prod);
-        }
-        _mm_storeu_ps(out+i, acc);
-
-    }
-
-    // Need to do the last value as a special case
-    int i = length - kernel_length;
-    out[i] = 0.0;
-    for(int k=0; k<kernel_length; k++){
-        out[i] += in[i+k] * kernel[kernel_length - k - 1];
-    }
-
-    return 0;
+    return convolve_sse_strategy(in, out, length, kernel, kernel_length,
+            1, 1, 0, _STRATEGY_LOADU, 0, 0);
 }
 
 /* As convolve_sse_simple plus...
@@ -152,48 +148,10 @@ int convolve_sse_simple(float* in, float* out, int length,
 int convolve_sse_partial_unroll(float* in, float* out, int length,
         float* kernel, int kernel_length)
 {
-    __m128 kernel_reverse[kernel_length] __attribute__ ((aligned (16)));    
-    __m128 data_block __attribute__ ((aligned (16)));
-
-    __m128 prod __attribute__ ((aligned (16)));
-    __m128 acc __attribute__ ((aligned (16)));
-
-    // Reverse the kernel and repeat each value across a 4-vector
-    for(int i=0; i<kernel_length; i++){
-        kernel_reverse[i] = _mm_set1_ps(kernel[kernel_length - i - 1]);
-    }
-    
-    for(int i=0; i<length-kernel_length; i+=4){
-
-        acc = _mm_setzero_ps();
-
-        for(int k=0; k<kernel_length; k+=4){
-
-            int data_offset = i + k;
-
-            for (int l = 0; l < 4; l++){
-
-                data_block = _mm_loadu_ps(in + data_offset + l);
-                prod = _mm_mul_ps(kernel_reverse[k+l], data_block);
-
-                acc = _mm_add_ps(acc, prod);
-            }
-        }
-        _mm_storeu_ps(out+i, acc);
-
-    }
-
-    // Need to do the last value as a special case
-    int i = length - kernel_length;
-    out[i] = 0.0;
-    for(int k=0; k<kernel_length; k++){
-        out[i] += in[i+k] * kernel[kernel_length - k - 1];
-    }
-
-    return 0;
+    return convolve_sse_strategy(in, out, length, kernel, kernel_length,
+            1, 4, 0, _STRATEGY_LOADU, 0, 0);
 }
 
-
 /* As convolve_sse_partial_unroll plus...
  *
  * We repeat the input data 4 times, with each repeat being shifted
@@ -219,54 +177,8 @@ int convolve_sse_partial_unroll(float* in, float* out, int length,
 int convolve_sse_in_aligned(float* in, float* out, int length,
         float* kernel, int kernel_length)
 {
-    float in_aligned[4][length] __attribute__ ((aligned (16)));
-
-    __m128 kernel_reverse[kernel_length] __attribute__ ((aligned (16)));    
-    __m128 data_block __attribute__ ((aligned (16)));
-
-    __m128 prod __attribute__ ((aligned (16)));
-    __m128 acc __attribute__ ((aligned (16)));
-
-    // Reverse the kernel and repeat each value across a 4-vector
-    for(int i=0; i<kernel_length; i++){
-        kernel_reverse[i] = _mm_set1_ps(kernel[kernel_length - i - 1]);
-    }
-
-    /* Create a set of 4 aligned arrays
-     * Each array is offset by one sample from the one before
-     */
-    for(int i=0; i<4; i++){
-        memcpy(in_aligned[i], (in+i), (length-i)*sizeof(float));
-    }
-
-    for(int i=0; i<length-kernel_length; i+=4){
-
-        acc = _mm_setzero_ps();
-
-        for(int k=0; k<kernel_length; k+=4){
-
-            int data_offset = i + k;
-
-            for (int l = 0; l < 4; l++){
-
-                data_block = _mm_load_ps(in_aligned[l] + data_offset);
-                prod = _mm_mul_ps(kernel_reverse[k+l], data_block);
-
-                acc = _mm_add_ps(acc, prod);
-            }
-        }
-        _mm_storeu_ps(out+i, acc);
-
-    }
-
-    // Need to do the last value as a special case
-    int i = length - kernel_length;
-    out[i] = 0.0;
-    for(int k=0; k<kernel_length; k++){
-        out[i] += in_aligned[0][i+k] * kernel[kernel_length - k - 1];
-    }
-
-    return 0;
+    return convolve_sse_strategy(in, out, length, kernel, kernel_length,
+            1, 1, SSE_SIMD_LENGTH, _STRATEGY_LOAD, 0, 0);
 }
 
 /* In this case, the kernel is assumed to be a fixed length, this
@@ -275,296 +187,43 @@ int convolve_sse_in_aligned(float* in, float* out, int length,
 int convolve_sse_in_aligned_fixed_kernel(float* in, float* out, int length,
         float* kernel, int kernel_length)
 {
-    float in_aligned[4][length] __attribute__ ((aligned (16)));
-
-    __m128 kernel_reverse[KERNEL_LENGTH] __attribute__ ((aligned (16)));    
-    __m128 data_block __attribute__ ((aligned (16)));
-
-    __m128 prod __attribute__ ((aligned (16)));
-    __m128 acc __attribute__ ((aligned (16)));
-
-    // Reverse the kernel and repeat each value across a 4-vector
-    for(int i=0; i<kernel_length; i++){
-        kernel_reverse[i] = _mm_set1_ps(kernel[kernel_length - i - 1]);
-    }
-
-    /* Create a set of 4 aligned arrays
-     * Each array is offset by one sample from the one before
-     */
-    for(int i=0; i<4; i++){
-        memcpy(in_aligned[i], (in+i), (length-i)*sizeof(float));
-    }
-
-    for(int i=0; i<length-KERNEL_LENGTH; i+=4){
-
-        acc = _mm_setzero_ps();
-
-        for(int k=0; k<KERNEL_LENGTH; k+=4){
-
-            int data_offset = i + k;
-
-            for (int l = 0; l < 4; l++){
-
-                data_block = _mm_load_ps(in_aligned[l] + data_offset);
-                prod = _mm_mul_ps(kernel_reverse[k+l], data_block);
-
-                acc = _mm_add_ps(acc, prod);
-            }
-        }
-        _mm_storeu_ps(out+i, acc);
-
-    }
-
-    // Need to do the last value as a special case
-    int i = length - KERNEL_LENGTH;
-    out[i] = 0.0;
-    for(int k=0; k<KERNEL_LENGTH; k++){
-        out[i] += in_aligned[0][i+k] * kernel[KERNEL_LENGTH - k - 1];
-    }
-
-    return 0;
+    return convolve_sse_strategy(in, out, length, kernel, KERNEL_LENGTH,
+            1, 1, SSE_SIMD_LENGTH, _STRATEGY_LOAD, 0, 0);
 }
 
 /* As convolve_sse_in_aligned_fixed_kernel but with AVX instructions
- * emulated with SSE.
+ * emulated with SSE: two accumulators give 8 output samples at a time.
  * */
-#define KERNEL_LENGTH 16
-#define ALIGNMENT 32
 int convolve_sse_unrolled_avx_vector(float* in, float* out, int length,
         float* kernel, int kernel_length)
 {
-    float in_aligned[SSE_SIMD_LENGTH][length] __attribute__ (
-            (aligned (ALIGNMENT)));
-
-    __m128 kernel_reverse[KERNEL_LENGTH] __attribute__ (
-            (aligned (ALIGNMENT)));    
-    __m128 data_block __attribute__ ((aligned (ALIGNMENT)));
-
-    __m128 prod __attribute__ ((aligned (ALIGNMENT)));
-    __m128 acc0 __attribute__ ((aligned (ALIGNMENT)));
-    __m128 acc1 __attribute__ ((aligned (ALIGNMENT)));
-
-    // Reverse the kernel and repeat each value across a 4-vector
-    for(int i=0; i<KERNEL_LENGTH; i++){
-        kernel_reverse[i] = _mm_set1_ps(kernel[KERNEL_LENGTH - i - 1]);
-    }
-
-    /* Create a set of FLOATS_PER_SIMD_LENGTH aligned arrays
-     * Each array is offset by one sample from the one before
-     */
-    for(int i=0; i<4; i++){
-        memcpy(in_aligned[i], (in+i), (length-i)*sizeof(float));
-    }
-
-    for(int i=0; i<length-KERNEL_LENGTH; i+=AVX_SIMD_LENGTH){
-
-        acc0 = _mm_setzero_ps();
-        acc1 = _mm_setzero_ps();
-
-        for(int k=0; k<KERNEL_LENGTH; k+=AVX_SIMD_LENGTH){
-
-            int data_offset = i + k;
-
-            for (int l = 0; l < 4; l++){
-
-                data_block = _mm_load_ps(in_aligned[l] + data_offset);
-                prod = _mm_mul_ps(kernel_reverse[k+l], data_block);
-
-                acc0 = _mm_add_ps(acc0, prod);
-
-                data_block = _mm_load_ps(in_aligned[l] + data_offset + 4);
-                prod = _mm_mul_ps(kernel_reverse[k+l], data_block);
-
-                acc1 = _mm_add_ps(acc1, prod);
-
-                data_block = _mm_load_ps(in_aligned[l] + data_offset + 4);
-                prod = _mm_mul_ps(kernel_reverse[k+l+4], data_block);
-
-                acc0 = _mm_add_ps(acc0, prod);
-
-                data_block = _mm_load_ps(in_aligned[l] + data_offset + 8);
-                prod = _mm_mul_ps(kernel_reverse[k+l+4], data_block);
-
-                acc1 = _mm_add_ps(acc1, prod);
-            }
-        }
-        _mm_storeu_ps(out+i, acc0);
-        _mm_storeu_ps(out+i+4, acc1);
-
-    }
-
-    // Need to do the last value as a special case
-    int i = length - KERNEL_LENGTH;
-    out[i] = 0.0;
-    for(int k=0; k<KERNEL_LENGTH; k++){
-        out[i] += in_aligned[0][i+k] * kernel[KERNEL_LENGTH - k - 1];
-    }
-
-    return 0;
+    return convolve_sse_strategy(in, out, length, kernel, KERNEL_LENGTH,
+            2, 1, SSE_SIMD_LENGTH, _STRATEGY_LOAD, 0, 0);
 }
 
-#define VECTOR_LENGTH 16
+/* As convolve_sse_unrolled_avx_vector, but with four accumulators, so
+ * 16 output samples at a time.
+ * */
 int convolve_sse_unrolled_vector(float* in, float* out, 
         int length, float* kernel, int kernel_length)
 {
-    float in_aligned[SSE_SIMD_LENGTH][length] __attribute__ (
-            (aligned (ALIGNMENT)));
-
-    __m128 kernel_reverse[KERNEL_LENGTH] __attribute__ (
-            (aligned (ALIGNMENT)));    
-    __m128 data_block __attribute__ ((aligned (ALIGNMENT)));
-
-    __m128 prod __attribute__ ((aligned (ALIGNMENT)));
-    __m128 acc0 __attribute__ ((aligned (ALIGNMENT)));
-    __m128 acc1 __attribute__ ((aligned (ALIGNMENT)));
-    __m128 acc2 __attribute__ ((aligned (ALIGNMENT)));
-    __m128 acc3 __attribute__ ((aligned (ALIGNMENT)));
-
-    // Reverse the kernel and repeat each value across a 4-vector
-    for(int i=0; i<KERNEL_LENGTH; i++){
-        kernel_reverse[i] = _mm_set1_ps(kernel[KERNEL_LENGTH - i - 1]);
-    }
-
-    /* Create a set of 4 aligned arrays
-     * Each array is offset by one sample from the one before
-     */
-    for(int i=0; i < SSE_SIMD_LENGTH; i++){
-        memcpy(in_aligned[i], (in+i), (length-i)*sizeof(float));
-    }
-
-    for(int i=0; i<length-KERNEL_LENGTH; i+=VECTOR_LENGTH){
-
-        acc0 = _mm_setzero_ps();
-        acc1 = _mm_setzero_ps();
-        acc2 = _mm_setzero_ps();
-        acc3 = _mm_setzero_ps();
-
-        for(int k=0; k<KERNEL_LENGTH; k+=VECTOR_LENGTH){
-
-            int data_offset = i + k;
-
-            for (int l = 0; l < SSE_SIMD_LENGTH; l++){
-
-                for (int m = 0; m < VECTOR_LENGTH; m+=SSE_SIMD_LENGTH) {
-
-                    data_block = _mm_load_ps(
-                            in_aligned[l] + data_offset + m);
-                    prod = _mm_mul_ps(kernel_reverse[k+l+m], data_block);
-
-                    acc0 = _mm_add_ps(acc0, prod);
-
-                    data_block = _mm_load_ps(in_aligned[l] + data_offset 
-                            + m + SSE_SIMD_LENGTH);
-                    prod = _mm_mul_ps(kernel_reverse[k+l+m], data_block);
-
-                    acc1 = _mm_add_ps(acc1, prod);
-
-                    data_block = _mm_load_ps(in_aligned[l] + data_offset 
-                            + m + SSE_SIMD_LENGTH * 2);
-                    prod = _mm_mul_ps(kernel_reverse[k+l+m], data_block);
-
-                    acc2 = _mm_add_ps(acc2, prod);
-
-                    data_block = _mm_load_ps(in_aligned[l] + data_offset 
-                            + m + SSE_SIMD_LENGTH * 3);
-                    prod = _mm_mul_ps(kernel_reverse[k+l+m], data_block);
-
-                    acc3 = _mm_add_ps(acc3, prod);
-                }
-            }
-        }
-        _mm_storeu_ps(out+i, acc0);
-        _mm_storeu_ps(out+i+SSE_SIMD_LENGTH, acc1);
-        _mm_storeu_ps(out+i+SSE_SIMD_LENGTH*2, acc2);
-        _mm_storeu_ps(out+i+SSE_SIMD_LENGTH*3, acc3);
-
-    }
-
-    // Need to do the last value as a special case
-    int i = length - KERNEL_LENGTH;
-    out[i] = 0.0;
-    for(int k=0; k<KERNEL_LENGTH; k++){
-        out[i] += in_aligned[0][i+k] * kernel[KERNEL_LENGTH - k - 1];
-    }
-
-    return 0;
+    return convolve_sse_strategy(in, out, length, kernel, KERNEL_LENGTH,
+            4, 1, SSE_SIMD_LENGTH, _STRATEGY_LOAD, 0, 0);
 }
 
-
 #endif
 
 #ifdef AVX
-#define VECTOR_LENGTH 16
-#define ALIGNMENT 32
 
+/* convolve_sse_unrolled_vector with AVX vectors, so two accumulators
+ * give 16 output samples. There are still only 4 shifted copies, so the
+ * loads are unaligned.
+ * */
 int convolve_avx_unrolled_vector(float* in, float* out, 
         int length, float* kernel, int kernel_length)
 {
-    float in_aligned[AVX_SIMD_LENGTH][length] __attribute__ (
-            (aligned (ALIGNMENT)));
-
-    __m256 kernel_reverse[KERNEL_LENGTH] __attribute__ (
-            (aligned (ALIGNMENT)));    
-    __m256 data_block __attribute__ ((aligned (ALIGNMENT)));
-
-    __m256 prod __attribute__ ((aligned (ALIGNMENT)));
-    __m256 acc0 __attribute__ ((aligned (ALIGNMENT)));
-    __m256 acc1 __attribute__ ((aligned (ALIGNMENT)));
-
-    // Repeat the kernel across the vector
-    for(int i=0; i<KERNEL_LENGTH; i++){
-        kernel_reverse[i] = _mm256_broadcast_ss(
-                &kernel[KERNEL_LENGTH - i - 1]);
-    }
-
-    /* Create a set of 4 aligned arrays
-     * Each array is offset by one sample from the one before
-     */
-    for(int i=0; i < SSE_SIMD_LENGTH; i++){
-        memcpy(in_aligned[i], (in+i), (length-i)*sizeof(float));
-    }
-
-    for(int i=0; i<length-KERNEL_LENGTH; i+=VECTOR_LENGTH){
-
-        acc0 = _mm256_setzero_ps();
-        acc1 = _mm256_setzero_ps();
-
-        for(int k=0; k<KERNEL_LENGTH; k+=VECTOR_LENGTH){
-
-            int data_offset = i + k;
-
-            for (int l = 0; l < SSE_SIMD_LENGTH; l++){
-
-                for (int m = 0; m < VECTOR_LENGTH; m+=SSE_SIMD_LENGTH) {
-
-                    data_block = _mm256_loadu_ps(
-                            in_aligned[l] + data_offset + m);
-                    prod = _mm256_mul_ps(kernel_reverse[k+l+m], data_block);
-
-                    acc0 = _mm256_add_ps(acc0, prod);
-
-                    data_block = _mm256_loadu_ps(in_aligned[l] + data_offset 
-                            + m + AVX_SIMD_LENGTH);
-                    prod = _mm256_mul_ps(kernel_reverse[k+l+m], data_block);
-
-                    acc1 = _mm256_add_ps(acc1, prod);
-
-                }
-            }
-        }
-        _mm256_storeu_ps(out+i, acc0);
-        _mm256_storeu_ps(out+i+AVX_SIMD_LENGTH, acc1);
-
-    }
-
-    // Need to do the last value as a special case
-    int i = length - KERNEL_LENGTH;
-    out[i] = 0.0;
-    for(int k=0; k<KERNEL_LENGTH; k++){
-        out[i] += in_aligned[0][i+k] * kernel[KERNEL_LENGTH - k - 1];
-    }
-
-    return 0;
+    return convolve_avx_strategy(in, out, length, kernel, KERNEL_LENGTH,
+            2, 1, SSE_SIMD_LENGTH, _STRATEGY_LOADU, 0, 0);
 }
 
 /* Like convolve_avx_unrolled_vector but without creating the 
@@ -573,62 +232,8 @@ int convolve_avx_unrolled_vector(float* in, float* out,
 int convolve_avx_unrolled_vector_unaligned(float* in, float* out, 
         int length, float* kernel, int kernel_length)
 {
-
-    __m256 kernel_reverse[KERNEL_LENGTH] __attribute__ (
-            (aligned (ALIGNMENT)));    
-    __m256 data_block __attribute__ ((aligned (ALIGNMENT)));
-
-    __m256 prod __attribute__ ((aligned (ALIGNMENT)));
-    __m256 acc0 __attribute__ ((aligned (ALIGNMENT)));
-    __m256 acc1 __attribute__ ((aligned (ALIGNMENT)));
-
-    // Repeat the kernel across the vector
-    for(int i=0; i<KERNEL_LENGTH; i++){
-        kernel_reverse[i] = _mm256_broadcast_ss(
-                &kernel[KERNEL_LENGTH - i - 1]);
-    }
-
-    for(int i=0; i<length-KERNEL_LENGTH; i+=VECTOR_LENGTH){
-
-        acc0 = _mm256_setzero_ps();
-        acc1 = _mm256_setzero_ps();
-
-        for(int k=0; k<KERNEL_LENGTH; k+=VECTOR_LENGTH){
-
-            int data_offset = i + k;
-
-            for (int l = 0; l < SSE_SIMD_LENGTH; l++){
-
-                for (int m = 0; m < VECTOR_LENGTH; m+=SSE_SIMD_LENGTH) {
-
-                    data_block = _mm256_loadu_ps(
-                            in + l + data_offset + m);
-                    prod = _mm256_mul_ps(kernel_reverse[k+l+m], data_block);
-
-                    acc0 = _mm256_add_ps(acc0, prod);
-
-                    data_block = _mm256_loadu_ps(in + l + data_offset 
-                            + m + AVX_SIMD_LENGTH);
-                    prod = _mm256_mul_ps(kernel_reverse[k+l+m], data_block);
-
-                    acc1 = _mm256_add_ps(acc1, prod);
-
-                }
-            }
-        }
-        _mm256_storeu_ps(out+i, acc0);
-        _mm256_storeu_ps(out+i+AVX_SIMD_LENGTH, acc1);
-
-    }
-
-    // Need to do the last value as a special case
-    int i = length - KERNEL_LENGTH;
-    out[i] = 0.0;
-    for(int k=0; k<KERNEL_LENGTH; k++){
-        out[i] += in[i+k] * kernel[KERNEL_LENGTH - k - 1];
-    }
-
-    return 0;
+    return convolve_avx_strategy(in, out, length, kernel, KERNEL_LENGTH,
+            2, 1, 0, _STRATEGY_LOADU, 0, 0);
 }
 
 /* Like convolve_avx_unrolled_vector_unaligned but using FMA
@@ -636,64 +241,8 @@ int convolve_avx_unrolled_vector_unaligned(float* in, float* out,
 int convolve_avx_unrolled_vector_unaligned_fma(float* in, float* out, 
         int length, float* kernel, int kernel_length)
 {
-
-    __m256 kernel_reverse[KERNEL_LENGTH] __attribute__ (
-            (aligned (ALIGNMENT)));    
-    __m256 data_block __attribute__ ((aligned (ALIGNMENT)));
-
-    __m256 acc0 __attribute__ ((aligned (ALIGNMENT)));
-    __m256 acc1 __attribute__ ((aligned (ALIGNMENT)));
-
-    // Repeat the kernel across the vector
-    for(int i=0; i<KERNEL_LENGTH; i++){
-        kernel_reverse[i] = _mm256_broadcast_ss(
-                &kernel[KERNEL_LENGTH - i - 1]);
-    }
-
-    for(int i=0; i<length-KERNEL_LENGTH; i+=VECTOR_LENGTH){
-
-        acc0 = _mm256_setzero_ps();
-        acc1 = _mm256_setzero_ps();
-
-        for(int k=0; k<KERNEL_LENGTH; k+=VECTOR_LENGTH){
-
-            int data_offset = i + k;
-
-            for (int l = 0; l < SSE_SIMD_LENGTH; l++){
-
-                for (int m = 0; m < VECTOR_LENGTH; m+=SSE_SIMD_LENGTH) {
-
-                    data_block = _mm256_loadu_ps(
-                            in + l + data_offset + m);
-
-                    //acc0 = kernel_reverse[k+l+m] * data_block + acc0;
-                    acc0 = _mm256_fmadd_ps(
-                            kernel_reverse[k+l+m], data_block, acc0);
-
-                    data_block = _mm256_loadu_ps(in + l + data_offset 
-                            + m + AVX_SIMD_LENGTH);
-
-                    //acc1 = kernel_reverse[k+l+m] * data_block + acc1;
-                    acc1 = _mm256_fmadd_ps(
-                           kernel_reverse[k+l+m], data_block, acc1);
-                    
-
-                }
-            }
-        }
-        _mm256_storeu_ps(out+i, acc0);
-        _mm256_storeu_ps(out+i+AVX_SIMD_LENGTH, acc1);
-
-    }
-
-    // Need to do the last value as a special case
-    int i = length - KERNEL_LENGTH;
-    out[i] = 0.0;
-    for(int k=0; k<KERNEL_LENGTH; k++){
-        out[i] += in[i+k] * kernel[KERNEL_LENGTH - k - 1];
-    }
-
-    return 0;
+    return convolve_avx_strategy(in, out, length, kernel, KERNEL_LENGTH,
+            2, 1, 0, _STRATEGY_LOADU, 1, 0);
 }
 
 /* Like avx_unrolled_vector but with the data loaded using aligned SSE load
@@ -702,253 +251,30 @@ int convolve_avx_unrolled_vector_unaligned_fma(float* in, float* out,
 int convolve_avx_unrolled_vector_m128_load(float* in, float* out, 
         int length, float* kernel, int kernel_length)
 {
-    float in_aligned[AVX_SIMD_LENGTH][length] __attribute__ (
-            (aligned (ALIGNMENT)));
-
-    __m256 kernel_reverse[KERNEL_LENGTH] __attribute__ (
-            (aligned (ALIGNMENT)));    
-    __m256 data_block __attribute__ ((aligned (ALIGNMENT)));
-    __m128 upper_data_block __attribute__ ((aligned (ALIGNMENT)));
-    __m128 lower_data_block __attribute__ ((aligned (ALIGNMENT)));
-
-    __m256 prod __attribute__ ((aligned (ALIGNMENT)));
-    __m256 acc0 __attribute__ ((aligned (ALIGNMENT)));
-    __m256 acc1 __attribute__ ((aligned (ALIGNMENT)));
-
-    // Repeat the kernel across the vector
-    for(int i=0; i<KERNEL_LENGTH; i++){
-        kernel_reverse[i] = _mm256_broadcast_ss(
-                &kernel[KERNEL_LENGTH - i - 1]);
-    }
-
-    /* Create a set of 4 aligned arrays
-     * Each array is offset by one sample from the one before
-     */
-    for(int i=0; i < SSE_SIMD_LENGTH; i++){
-        memcpy(in_aligned[i], (in+i), (length-i)*sizeof(float));
-    }
-
-    for(int i=0; i<length-KERNEL_LENGTH; i+=VECTOR_LENGTH){
-
-        acc0 = _mm256_setzero_ps();
-        acc1 = _mm256_setzero_ps();
-
-        for(int k=0; k<KERNEL_LENGTH; k+=VECTOR_LENGTH){
-
-            int data_offset = i + k;
-
-            for (int l = 0; l < SSE_SIMD_LENGTH; l++){
-
-                for (int m = 0; m < VECTOR_LENGTH; m+=SSE_SIMD_LENGTH) {
-
-                    lower_data_block = _mm_load_ps(
-                            in_aligned[l] + data_offset + m);
-                    upper_data_block = _mm_load_ps(
-                            in_aligned[l] + data_offset + m + SSE_SIMD_LENGTH);
-
-                    data_block = _mm256_castps128_ps256(lower_data_block);
-                    data_block = _mm256_insertf128_ps(
-                            data_block, upper_data_block, 1);
-
-                    prod = _mm256_mul_ps(kernel_reverse[k+l+m], data_block);
-
-                    acc0 = _mm256_add_ps(acc0, prod);
-
-                    lower_data_block = _mm_load_ps(
-                            in_aligned[l] + data_offset + m + 
-                            AVX_SIMD_LENGTH);
-                    upper_data_block = _mm_load_ps(
-                            in_aligned[l] + data_offset + m + 
-                            AVX_SIMD_LENGTH + SSE_SIMD_LENGTH);
-
-                    data_block = _mm256_castps128_ps256(lower_data_block);
-                    data_block = _mm256_insertf128_ps(
-                            data_block, upper_data_block, 1);
-
-                    prod = _mm256_mul_ps(kernel_reverse[k+l+m], data_block);
-
-                    acc1 = _mm256_add_ps(acc1, prod);
-
-                }
-            }
-        }
-        _mm256_storeu_ps(out+i, acc0);
-        _mm256_storeu_ps(out+i+AVX_SIMD_LENGTH, acc1);
-
-    }
-
-    // Need to do the last value as a special case
-    int i = length - KERNEL_LENGTH;
-    out[i] = 0.0;
-    for(int k=0; k<KERNEL_LENGTH; k++){
-        out[i] += in_aligned[0][i+k] * kernel[KERNEL_LENGTH - k - 1];
-    }
-
-    return 0;
+    return convolve_avx_strategy(in, out, length, kernel, KERNEL_LENGTH,
+            2, 1, SSE_SIMD_LENGTH, _STRATEGY_LOAD_HALVES, 0, 0);
 }
 
+/* Like avx_unrolled_vector but with 8 shifted copies, so every load is
+ * an aligned AVX load.
+ * */
 int convolve_avx_unrolled_vector_aligned(float* in, float* out, 
         int length, float* kernel, int kernel_length)
 {
-    float in_aligned[AVX_SIMD_LENGTH][length] __attribute__ (
-            (aligned (ALIGNMENT)));
-
-    __m256 kernel_reverse[KERNEL_LENGTH] __attribute__ (
-            (aligned (ALIGNMENT)));    
-    __m256 data_block __attribute__ ((aligned (ALIGNMENT)));
-
-    __m256 prod __attribute__ ((aligned (ALIGNMENT)));
-    __m256 acc0 __attribute__ ((aligned (ALIGNMENT)));
-    __m256 acc1 __attribute__ ((aligned (ALIGNMENT)));
-
-    // Repeat the kernel across the vector
-    for(int i=0; i<KERNEL_LENGTH; i++){
-        kernel_reverse[i] = _mm256_broadcast_ss(
-                &kernel[KERNEL_LENGTH - i - 1]);
-    }
-
-    /* Create a set of 8 aligned arrays
-     * Each array is offset by one sample from the one before
-     */
-    for(int i=0; i < AVX_SIMD_LENGTH; i++){
-        memcpy(in_aligned[i], (in+i), (length-i)*sizeof(float));
-    }
-
-    for(int i=0; i<length-KERNEL_LENGTH; i+=VECTOR_LENGTH){
-
-        acc0 = _mm256_setzero_ps();
-        acc1 = _mm256_setzero_ps();
-
-        for(int k=0; k<KERNEL_LENGTH; k+=VECTOR_LENGTH){
-
-            int data_offset = i + k;
-
-            for (int l = 0; l < AVX_SIMD_LENGTH; l++){
-
-                for (int m = 0; m < VECTOR_LENGTH; m+=AVX_SIMD_LENGTH) {
-
-                    data_block = _mm256_load_ps(
-                            in_aligned[l] + data_offset + m);
-                    prod = _mm256_mul_ps(kernel_reverse[k+l+m], data_block);
-
-                    acc0 = _mm256_add_ps(acc0, prod);
-
-                    data_block = _mm256_load_ps(in_aligned[l] + data_offset 
-                            + m + AVX_SIMD_LENGTH);
-                    prod = _mm256_mul_ps(kernel_reverse[k+l+m], data_block);
-
-                    acc1 = _mm256_add_ps(acc1, prod);
-
-                }
-            }
-        }
-        _mm256_storeu_ps(out+i, acc0);
-        _mm256_storeu_ps(out+i+AVX_SIMD_LENGTH, acc1);
-
-    }
-
-    // Need to do the last value as a special case
-    int i = length - KERNEL_LENGTH;
-    out[i] = 0.0;
-    for(int k=0; k<KERNEL_LENGTH; k++){
-        out[i] += in_aligned[0][i+k] * kernel[KERNEL_LENGTH - k - 1];
-    }
-
-    return 0;
+    return convolve_avx_strategy(in, out, length, kernel, KERNEL_LENGTH,
+            2, 1, AVX_SIMD_LENGTH, _STRATEGY_LOAD, 0, 0);
 }
 
+/* Like avx_unrolled_vector, but with aligned loads for the half of the
+ * offsets that are aligned in the 4 shifted copies.
+ * */
 int convolve_avx_unrolled_vector_partial_aligned(float* in, float* out, 
         int length, float* kernel, int kernel_length)
 {
-    float kernel_block[AVX_SIMD_LENGTH] __attribute__ (
-            (aligned (ALIGNMENT)));
-    float in_aligned[AVX_SIMD_LENGTH][length] __attribute__ (
-            (aligned (ALIGNMENT)));
-
-    __m256 kernel_reverse[KERNEL_LENGTH] __attribute__ (
-            (aligned (ALIGNMENT)));    
-    __m256 data_block __attribute__ ((aligned (ALIGNMENT)));
-
-    __m256 prod __attribute__ ((aligned (ALIGNMENT)));
-    __m256 acc0 __attribute__ ((aligned (ALIGNMENT)));
-    __m256 acc1 __attribute__ ((aligned (ALIGNMENT)));
-
-    // Repeat the kernel across the vector
-    for(int i=0; i<KERNEL_LENGTH; i++){
-        for(int j=0; j<AVX_SIMD_LENGTH; j++){
-            kernel_block[j] = kernel[KERNEL_LENGTH - i - 1];
-        }
-
-        kernel_reverse[i] = _mm256_load_ps(kernel_block);
-    }
-
-    /* Create a set of SSE_SIMD_LENGTH aligned arrays
-     * Each array is offset by one sample from the one before
-     */
-    for(int i=0; i < SSE_SIMD_LENGTH; i++){
-        memcpy(in_aligned[i], (in+i), (length-i)*sizeof(float));
-    }
-
-    for(int i=0; i<length-KERNEL_LENGTH; i+=VECTOR_LENGTH){
-
-        acc0 = _mm256_setzero_ps();
-        acc1 = _mm256_setzero_ps();
-
-        for(int k=0; k<KERNEL_LENGTH; k+=VECTOR_LENGTH){
-
-            int data_offset = i + k;
-
-            for (int l = 0; l < SSE_SIMD_LENGTH; l++){
-
-                for (int m = 0; m < VECTOR_LENGTH; m+=AVX_SIMD_LENGTH) {
-
-                    data_block = _mm256_load_ps(
-                            in_aligned[l] + data_offset + m);
-                    prod = _mm256_mul_ps(kernel_reverse[k+l+m], data_block);
-
-                    acc0 = _mm256_add_ps(acc0, prod);
-
-                    data_block = _mm256_load_ps(in_aligned[l] + data_offset 
-                            + m + AVX_SIMD_LENGTH);
-                    prod = _mm256_mul_ps(kernel_reverse[k+l+m], data_block);
-
-                    acc1 = _mm256_add_ps(acc1, prod);
-
-                    data_block = _mm256_loadu_ps(
-                            in_aligned[l] + data_offset + m + SSE_SIMD_LENGTH);
-                    prod = _mm256_mul_ps(
-                            kernel_reverse[k+l+m+SSE_SIMD_LENGTH], data_block);
-
-                    acc0 = _mm256_add_ps(acc0, prod);
-
-                    data_block = _mm256_loadu_ps(in_aligned[l] + data_offset 
-                            + m + SSE_SIMD_LENGTH + AVX_SIMD_LENGTH);
-                    prod = _mm256_mul_ps(
-                            kernel_reverse[k+l+m+SSE_SIMD_LENGTH], data_block);
-
-                    acc1 = _mm256_add_ps(acc1, prod);
-
-
-                }
-            }
-        }
-        _mm256_storeu_ps(out+i, acc0);
-        _mm256_storeu_ps(out+i+AVX_SIMD_LENGTH, acc1);
-
-    }
-
-    // Need to do the last value as a special case
-    int i = length - KERNEL_LENGTH;
-    out[i] = 0.0;
-    for(int k=0; k<KERNEL_LENGTH; k++){
-        out[i] += in_aligned[0][i+k] * kernel[KERNEL_LENGTH - k - 1];
-    }
-
-    return 0;
+    return convolve_avx_strategy(in, out, length, kernel, KERNEL_LENGTH,
+            2, 1, SSE_SIMD_LENGTH, _STRATEGY_LOAD_PARTIAL, 0, 0);
 }
 
-
-
 /* The following is exactly the same as convolve_avx_unrolled_vector
  * but the output is written to a local variable before copying with
  * a memcpy at the end.
@@ -956,77 +282,101 @@ int convolve_avx_unrolled_vector_partial_aligned(float* in, float* out,
 int convolve_avx_unrolled_vector_local_output(float* in, float* out, 
         int length, float* kernel, int kernel_length)
 {
-    float in_aligned[AVX_SIMD_LENGTH][length] __attribute__ (
-            (aligned (ALIGNMENT)));
-
-    float local_out[length-KERNEL_LENGTH + 1] __attribute__ (
-            (aligned (ALIGNMENT)));
+    return convolve_avx_strategy(in, out, length, kernel, KERNEL_LENGTH,
+            2, 1, SSE_SIMD_LENGTH, _STRATEGY_LOADU, 0, 1);
+}
 
-    __m256 kernel_reverse[KERNEL_LENGTH] __attribute__ (
-            (aligned (ALIGNMENT)));    
-    __m256 data_block __attribute__ ((aligned (ALIGNMENT)));
+#endif
 
-    __m256 prod __attribute__ ((aligned (ALIGNMENT)));
-    __m256 acc0 __attribute__ ((aligned (ALIGNMENT)));
-    __m256 acc1 __attribute__ ((aligned (ALIGNMENT)));
+#ifdef NEON
 
-    // Repeat the kernel across the vector
-    for(int i=0; i<KERNEL_LENGTH; i++){
-        kernel_reverse[i] = _mm256_broadcast_ss(
-                &kernel[KERNEL_LENGTH - i - 1]);
-    }
-
-    /* Create a set of 4 aligned arrays
-     * Each array is offset by one sample from the one before
-     */
-    for(int i=0; i < SSE_SIMD_LENGTH; i++){
-        memcpy(in_aligned[i], (in+i), (length-i)*sizeof(float));
-    }
+/* The NEON kernels mirror the SSE ones above. NEON vectors are 4 floats
+ * wide, like SSE, so the same blocking carries straight across.
+ *
+ * vld1q_f32 has no separate aligned and unaligned forms (an unaligned
+ * load costs the same as an aligned one on every AArch64 core we care
+ * about), so the in_aligned family, which exists only to turn
+ * _mm_loadu_ps into _mm_load_ps, has no NEON counterpart.
+ * */
 
-    for(int i=0; i<length-KERNEL_LENGTH; i+=VECTOR_LENGTH){
+/* NEON version of convolve_sse_simple.
+ */
+int convolve_neon_simple(float* in, float* out, int length,
+        float* kernel, int kernel_length)
+{
+    return convolve_neon_strategy(in, out, length, kernel, kernel_length,
+            1, 1, 0, _STRATEGY_LOADU, 0, 0);
+}
 
-        acc0 = _mm256_setzero_ps();
-        acc1 = _mm256_setzero_ps();
+/* NEON version of convolve_sse_partial_unroll.
+ *
+ * The kernel length must be a multiple of 4.
+ */
+int convolve_neon_partial_unroll(float* in, float* out, int length,
+        float* kernel, int kernel_length)
+{
+    return convolve_neon_strategy(in, out, length, kernel, kernel_length,
+            1, 4, 0, _STRATEGY_LOADU, 0, 0);
+}
 
-        for(int k=0; k<KERNEL_LENGTH; k+=VECTOR_LENGTH){
+/* NEON version of convolve_sse_unrolled_vector, working on the input
+ * directly rather than on aligned copies.
+ *
+ * As with the SSE version, the kernel is fixed at KERNEL_LENGTH and the
+ * output is computed in blocks of 16.
+ */
+int convolve_neon_unrolled_vector(float* in, float* out,
+        int length, float* kernel, int kernel_length)
+{
+    return convolve_neon_strategy(in, out, length, kernel, KERNEL_LENGTH,
+            4, 1, 0, _STRATEGY_LOADU, 0, 0);
+}
 
-            int data_offset = i + k;
+/* Like convolve_neon_unrolled_vector but using the fused multiply-add,
+ * the NEON equivalent of convolve_avx_unrolled_vector_unaligned_fma.
+ * */
+int convolve_neon_unrolled_vector_fma(float* in, float* out,
+        int length, float* kernel, int kernel_length)
+{
+    return convolve_neon_strategy(in, out, length, kernel, KERNEL_LENGTH,
+            4, 1, 0, _STRATEGY_LOADU, 1, 0);
+}
 
-            for (int l = 0; l < SSE_SIMD_LENGTH; l++){
+#endif
 
-                for (int m = 0; m < VECTOR_LENGTH; m+=SSE_SIMD_LENGTH) {
+#ifdef SVE
 
-                    data_block = _mm256_loadu_ps(
-                            in_aligned[l] + data_offset + m);
-                    prod = _mm256_mul_ps(kernel_reverse[k+l+m], data_block);
+/* SVE has no fixed vector length, so it has no simd.h wrappers and is
+ * not built from the strategy kernel (which bakes the vector width into
+ * the blocking). Instead this is the convolve_sse_simple strategy
+ * written vector-length agnostic.
+ *
+ * Each kernel value is broadcast and multiplied into svcntw() output
+ * samples at a time. The loop is predicated with svwhilelt, so the
+ * tail (including the last value that the fixed width kernels handle
+ * as a special case) needs no extra code, and neither the input nor
+ * the kernel length has any restriction.
+ */
+int convolve_sve_simple(float* in, float* out, int length,
+        float* kernel, int kernel_length)
+{
+    int out_length = length - kernel_length + 1;
 
-                    acc0 = _mm256_add_ps(acc0, prod);
+    for(int i=0; i<out_length; i+=svcntw()){
 
-                    data_block = _mm256_loadu_ps(in_aligned[l] + data_offset 
-                            + m + AVX_SIMD_LENGTH);
-                    prod = _mm256_mul_ps(kernel_reverse[k+l+m], data_block);
+        svbool_t pg = svwhilelt_b32(i, out_length);
+        svfloat32_t acc = svdup_f32(0.0f);
 
-                    acc1 = _mm256_add_ps(acc1, prod);
+        for(int k=0; k<kernel_length; k++){
 
-                }
-            }
+            svfloat32_t data_block = svld1_f32(pg, in + i + k);
+            acc = svmla_n_f32_x(pg, acc, data_block,
+                    kernel[kernel_length - k - 1]);
         }
-        _mm256_storeu_ps(local_out+i, acc0);
-        _mm256_storeu_ps(local_out+i+AVX_SIMD_LENGTH, acc1);
-
-    }
-
-    // Need to do the last value as a special case
-    int i = length - KERNEL_LENGTH;
-    local_out[i] = 0.0;
-    for(int k=0; k<KERNEL_LENGTH; k++){
-        local_out[i] += in_aligned[0][i+k] * kernel[KERNEL_LENGTH - k - 1];
+        svst1_f32(pg, out + i, acc);
     }
 
-    memcpy(out, local_out, (length-KERNEL_LENGTH + 1)*sizeof(float));
-
     return 0;
 }
 
 #endif
-
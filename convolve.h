@@ -28,10 +28,18 @@
 #ifndef _CONVOLVE_H
 #define _CONVOLVE_H
 
-#if defined SSE3 || defined AVX
+#if defined SSE3 || defined AVX || defined AVX512
 #include <immintrin.h>
 #endif
 
+#ifdef NEON
+#include <arm_neon.h>
+#endif
+
+#ifdef SVE
+#include <arm_sve.h>
+#endif
+
 
 /* A macro that outputs a wrapper for each of the convolution routines.
  * The macro passed a name conv_func will output a function called
@@ -117,4 +125,151 @@ MULTIPLE_CONVOLVE_PROTO(convolve_avx_unrolled_vector_local_output);
 
 #endif
 
+#ifdef NEON
+int convolve_neon_simple(float* in, float* out, int length,
+        float* kernel, int kernel_length);
+MULTIPLE_CONVOLVE_PROTO(convolve_neon_simple);
+
+int convolve_neon_partial_unroll(float* in, float* out, int length,
+        float* kernel, int kernel_length);
+MULTIPLE_CONVOLVE_PROTO(convolve_neon_partial_unroll);
+
+int convolve_neon_unrolled_vector(float* in, float* out, int length,
+        float* kernel, int kernel_length);
+MULTIPLE_CONVOLVE_PROTO(convolve_neon_unrolled_vector);
+
+int convolve_neon_unrolled_vector_fma(float* in, float* out, int length,
+        float* kernel, int kernel_length);
+MULTIPLE_CONVOLVE_PROTO(convolve_neon_unrolled_vector_fma);
+
+#endif
+
+#ifdef SVE
+int convolve_sve_simple(float* in, float* out, int length,
+        float* kernel, int kernel_length);
+MULTIPLE_CONVOLVE_PROTO(convolve_sve_simple);
+
+#endif
+
+/* The generic kernels, instantiated from convolve_template.h for each
+ * instruction set. These take any lengths and can run in place.
+ * */
+
+#ifdef SSE3
+int convolve_sse_generic(float* in, float* out, int length,
+        float* kernel, int kernel_length);
+MULTIPLE_CONVOLVE_PROTO(convolve_sse_generic);
+
+int convolve_sse_columns(float* in, int in_pitch, float* out, int width,
+        float* kernel, int kernel_length);
+
+int convolve_sse_decimate(float* in, float* out, int length,
+        float* kernel, int kernel_length, float* even, float* odd);
+
+int convolve_sse_dilated(float* in, float* out, int length,
+        float* kernel, int kernel_length, int dilation);
+
+int convolve_sse_generic_pair(float* in, float* out_a, float* out_b,
+        int length, float* kernel_a, float* kernel_b, int kernel_length);
+
+int convolve_sse_correlate_threshold(float* in, int length, float* pattern,
+        int pattern_length, float threshold, int* indices, float* values,
+        int max_matches);
+
+int convolve_sse_correlate_top_k(float* in, int length, float* pattern,
+        int pattern_length, int k, int* indices, float* values);
+
+int convolve_sse_generic_pool(float* in, float* out, int* argmax,
+        int length, float* kernel, int kernel_length, int pool, int mode);
+#endif
+
+#ifdef AVX
+int convolve_avx_generic(float* in, float* out, int length,
+        float* kernel, int kernel_length);
+MULTIPLE_CONVOLVE_PROTO(convolve_avx_generic);
+
+int convolve_avx_columns(float* in, int in_pitch, float* out, int width,
+        float* kernel, int kernel_length);
+
+int convolve_avx_decimate(float* in, float* out, int length,
+        float* kernel, int kernel_length, float* even, float* odd);
+
+int convolve_avx_dilated(float* in, float* out, int length,
+        float* kernel, int kernel_length, int dilation);
+
+int convolve_avx_generic_pair(float* in, float* out_a, float* out_b,
+        int length, float* kernel_a, float* kernel_b, int kernel_length);
+
+int convolve_avx_correlate_threshold(float* in, int length, float* pattern,
+        int pattern_length, float threshold, int* indices, float* values,
+        int max_matches);
+
+int convolve_avx_correlate_top_k(float* in, int length, float* pattern,
+        int pattern_length, int k, int* indices, float* values);
+
+int convolve_avx_generic_pool(float* in, float* out, int* argmax,
+        int length, float* kernel, int kernel_length, int pool, int mode);
+#endif
+
+#ifdef AVX512
+int convolve_avx512_generic(float* in, float* out, int length,
+        float* kernel, int kernel_length);
+MULTIPLE_CONVOLVE_PROTO(convolve_avx512_generic);
+
+int convolve_avx512_columns(float* in, int in_pitch, float* out, int width,
+        float* kernel, int kernel_length);
+
+int convolve_avx512_decimate(float* in, float* out, int length,
+        float* kernel, int kernel_length, float* even, float* odd);
+
+int convolve_avx512_dilated(float* in, float* out, int length,
+        float* kernel, int kernel_length, int dilation);
+
+int convolve_avx512_generic_pair(float* in, float* out_a, float* out_b,
+        int length, float* kernel_a, float* kernel_b, int kernel_length);
+
+int convolve_avx512_correlate_threshold(float* in, int length, float* pattern,
+        int pattern_length, float threshold, int* indices, float* values,
+        int max_matches);
+
+int convolve_avx512_correlate_top_k(float* in, int length, float* pattern,
+        int pattern_length, int k, int* indices, float* values);
+
+int convolve_avx512_generic_pool(float* in, float* out, int* argmax,
+        int length, float* kernel, int kernel_length, int pool, int mode);
+#endif
+
+#ifdef NEON
+int convolve_neon_generic(float* in, float* out, int length,
+        float* kernel, int kernel_length);
+MULTIPLE_CONVOLVE_PROTO(convolve_neon_generic);
+
+int convolve_neon_columns(float* in, int in_pitch, float* out, int width,
+        float* kernel, int kernel_length);
+
+int convolve_neon_decimate(float* in, float* out, int length,
+        float* kernel, int kernel_length, float* even, float* odd);
+
+int convolve_neon_dilated(float* in, float* out, int length,
+        float* kernel, int kernel_length, int dilation);
+
+int convolve_neon_generic_pair(float* in, float* out_a, float* out_b,
+        int length, float* kernel_a, float* kernel_b, int kernel_length);
+
+int convolve_neon_correlate_threshold(float* in, int length, float* pattern,
+        int pattern_length, float threshold, int* indices, float* values,
+        int max_matches);
+
+int convolve_neon_correlate_top_k(float* in, int length, float* pattern,
+        int pattern_length, int k, int* indices, float* values);
+
+int convolve_neon_generic_pool(float* in, float* out, int* argmax,
+        int length, float* kernel, int kernel_length, int pool, int mode);
+#endif
+
+/* The reductions for the pooled kernels (the generic_pool functions). */
+#define CONVOLVE_POOL_MAX 0
+#define CONVOLVE_POOL_MEAN 1
+#define CONVOLVE_POOL_ARGMAX 2
+
 #endif /*Header guard*/
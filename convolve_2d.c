@@ -26,126 +26,1251 @@
  */
 
 #include "convolve_2d.h"
+#include "convolve.h"
 #include <string.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
 
 #ifdef SSE3
-#define KERNEL_LENGTH 16
 
+/* The generic kernels used for the passes along rows and down columns.
+ * These are the widest that are built.
+ * */
+#ifdef AVX
+#define _convolve_row convolve_avx_generic
+#define _convolve_columns convolve_avx_columns
+#define _convolve_row_decimate convolve_avx_decimate
+#define _convolve_row_dilated convolve_avx_dilated
+#define _convolve_row_pair convolve_avx_generic_pair
+#else
+#define _convolve_row convolve_sse_generic
+#define _convolve_columns convolve_sse_columns
+#define _convolve_row_decimate convolve_sse_decimate
+#define _convolve_row_dilated convolve_sse_dilated
+#define _convolve_row_pair convolve_sse_generic_pair
+#endif
+
+/* Convolves each row of ``in'' (rows x cols) with ``kernel'' and writes
+ * the result transposed into ``out'', which is then
+ * (cols-kernel_length+1) x rows.
+ *
+ * Four rows at a time are convolved into a line buffer and then written
+ * out as 4x4 blocks transposed with _MM_TRANSPOSE4_PS, so that every
+ * store is still a 4-vector.
+ * */
 static inline
 int _convolve_along_rows_with_transpose(float* in, float* out, int cols,
-        int rows, float* kernel)
+        int rows, float* kernel, int kernel_length)
 {
-    float kernel_block[4] __attribute__ ((aligned (16)));
-    float in_aligned[4][cols] __attribute__ ((aligned (16)));
+    int out_cols = cols - kernel_length + 1;
 
-    __m128 kernel_reverse[KERNEL_LENGTH] __attribute__ ((aligned (16)));    
-    __m128 data_block __attribute__ ((aligned (16)));
+    float line[4][out_cols] __attribute__ ((aligned (16)));
+
+    __m128 out1, out2, out3, out4;
+
+    int row = 0;
+    for (; row<=rows-4; row+=4){
+        for (int sub_row=0; sub_row<4; sub_row++){
+            _convolve_row(in + (row+sub_row)*cols, line[sub_row], cols,
+                    kernel, kernel_length);
+        }
 
-    __m128 prod __attribute__ ((aligned (16)));
-    __m128 acc __attribute__ ((aligned (16)));
+        int i = 0;
+        for(; i<=out_cols-4; i+=4){
+            out1 = _mm_loadu_ps(line[0] + i);
+            out2 = _mm_loadu_ps(line[1] + i);
+            out3 = _mm_loadu_ps(line[2] + i);
+            out4 = _mm_loadu_ps(line[3] + i);
+            _MM_TRANSPOSE4_PS(out1, out2, out3, out4);
 
-    // Repeat the kernel across the vector
-    for(int i=0; i<KERNEL_LENGTH; i++){
-        kernel_block[0] = kernel[KERNEL_LENGTH - i - 1];
-        kernel_block[1] = kernel[KERNEL_LENGTH - i - 1];
-        kernel_block[2] = kernel[KERNEL_LENGTH - i - 1];
-        kernel_block[3] = kernel[KERNEL_LENGTH - i - 1];
+            _mm_storeu_ps(out + i*rows + row, out1);
+            _mm_storeu_ps(out + (i+1)*rows + row, out2);
+            _mm_storeu_ps(out + (i+2)*rows + row, out3);
+            _mm_storeu_ps(out + (i+3)*rows + row, out4);
+        }
 
-        kernel_reverse[i] = _mm_load_ps(kernel_block);
+        // The columns that don't fill a 4x4 block
+        for(; i<out_cols; i++){
+            for (int sub_row=0; sub_row<4; sub_row++){
+                out[i*rows + row + sub_row] = line[sub_row][i];
+            }
+        }
     }
 
-    for (int row=0; row<rows; row+=4){
-        for (int sub_row=0; sub_row<4; sub_row++){
+    // The rows that don't fill a 4x4 block
+    for (; row<rows; row++){
+        _convolve_row(in + row*cols, line[0], cols, kernel, kernel_length);
+
+        for(int i=0; i<out_cols; i++){
+            out[i*rows + row] = line[0][i];
+        }
+    }
+
+    return 0;
+}
+
+/* Two strategies for the separable 2D convolution, both of which fill
+ * ``out'' with the (rows-kernel_length+1) x (cols-kernel_length+1)
+ * valid part of ``in'' convolved with ``kernel'' along its rows and
+ * along its columns. ``workspace'' needs rows*(cols-kernel_length+1)
+ * floats.
+ *
+ * The transpose strategy convolves along the rows and writes the result
+ * transposed, twice over, so that both passes use the 1D row kernel.
+ * The cost is that the transposes scatter the stores down the columns
+ * of the output.
+ *
+ * The columns strategy convolves along the rows and then straight down
+ * the columns of the result with each lane a different column, so the
+ * image is never transposed. It needs a few vectors' worth of columns
+ * to keep the accumulators busy.
+ * */
+int convolve_sse_2d_separable_transpose(float* in, float* out,
+        float* workspace, int cols, int rows, float* kernel,
+        int kernel_length)
+{
+    int out_cols = cols - kernel_length + 1;
 
-            float* in_row = in + (row+sub_row)*cols;
-            float* out_row = out + (row+sub_row)*(cols-KERNEL_LENGTH+1);
-            
-            /* Create a set of 4 aligned arrays
-             * Each array is offset by one sample from the one before
-             */
-            for(int i=0; i<4; i++){
-                memcpy(in_aligned[i], (in_row+i), (cols-i)*sizeof(float));
+    _convolve_along_rows_with_transpose(in, workspace, cols, rows,
+            kernel, kernel_length);
+    _convolve_along_rows_with_transpose(workspace, out, rows, out_cols,
+            kernel, kernel_length);
+
+    return 0;
+}
+
+int convolve_sse_2d_separable_columns(float* in, float* out,
+        float* workspace, int cols, int rows, float* kernel,
+        int kernel_length)
+{
+    return convolve_sse_2d_separable_asymmetric(in, out, workspace,
+            cols, rows, kernel, kernel_length, kernel, kernel_length);
+}
+
+/* The columns strategy with different kernels along the rows and down
+ * the columns, of different lengths. ``out'' is then
+ * (rows-col_length+1) x (cols-row_length+1) and ``workspace'' needs
+ * rows*(cols-row_length+1) floats.
+ *
+ * Each pass goes through the generic kernels, which pick a version
+ * specialised for the length where there is one. A kernel of length 1
+ * is only a scale, so it is folded into the other kernel and its pass
+ * is skipped altogether (the workspace is then not used).
+ * */
+int convolve_sse_2d_separable_asymmetric(float* in, float* out,
+        float* workspace, int cols, int rows, float* row_kernel,
+        int row_length, float* col_kernel, int col_length)
+{
+    int out_cols = cols - row_length + 1;
+
+    return convolve_sse_2d_separable_strided(in, cols, out, out_cols,
+            workspace, out_cols, cols, rows, row_kernel, row_length,
+            col_kernel, col_length);
+}
+
+/* As convolve_sse_2d_separable_asymmetric, but with the rows of the
+ * input, output and workspace each ``pitch'' floats apart rather than
+ * packed, so that any of them can be a view into a larger image. The
+ * pitches must be at least cols, cols-row_length+1 and
+ * cols-row_length+1 respectively.
+ * */
+int convolve_sse_2d_separable_strided(float* in, int in_pitch,
+        float* out, int out_pitch, float* workspace, int workspace_pitch,
+        int cols, int rows, float* row_kernel, int row_length,
+        float* col_kernel, int col_length)
+{
+    int out_cols = cols - row_length + 1;
+    int out_rows = rows - col_length + 1;
+
+    if (row_length == 1 && col_length == 1){
+        float scale = row_kernel[0] * col_kernel[0];
+        for(int row=0; row<rows; row++){
+            for(int i=0; i<cols; i++){
+                out[row*out_pitch + i] = in[row*in_pitch + i] * scale;
             }
+        }
+        return 0;
+    }
 
-            for(int i=0; i<cols-KERNEL_LENGTH; i+=4){
+    if (row_length == 1){
+        float scaled_kernel[col_length];
+        for(int i=0; i<col_length; i++){
+            scaled_kernel[i] = col_kernel[i] * row_kernel[0];
+        }
 
-                acc = _mm_setzero_ps();
+        for(int row=0; row<out_rows; row++){
+            _convolve_columns(in + row*in_pitch, in_pitch,
+                    out + row*out_pitch, cols, scaled_kernel, col_length);
+        }
+        return 0;
+    }
 
-                for(int k=0; k<KERNEL_LENGTH; k+=4){
+    if (col_length == 1){
+        float scaled_kernel[row_length];
+        for(int i=0; i<row_length; i++){
+            scaled_kernel[i] = row_kernel[i] * col_kernel[0];
+        }
 
-                    int data_offset = i + k;
+        for(int row=0; row<rows; row++){
+            _convolve_row(in + row*in_pitch, out + row*out_pitch, cols,
+                    scaled_kernel, row_length);
+        }
+        return 0;
+    }
 
-                    for (int l = 0; l < 4; l++){
+    for(int row=0; row<rows; row++){
+        _convolve_row(in + row*in_pitch, workspace + row*workspace_pitch,
+                cols, row_kernel, row_length);
+    }
 
-                        data_block = _mm_load_ps(in_aligned[l] + data_offset);
-                        prod = _mm_mul_ps(kernel_reverse[k+l], data_block);
+    for(int row=0; row<out_rows; row++){
+        _convolve_columns(workspace + row*workspace_pitch, workspace_pitch,
+                out + row*out_pitch, out_cols, col_kernel, col_length);
+    }
 
-                        acc = _mm_add_ps(acc, prod);
-                    }
-                }
-                _mm_storeu_ps(out_row+i, acc);
-                
-                // Takes the transpose:
-                //out[row + sub_row + i*rows] = acc[0];
-                //out[row + sub_row + (i+1)*rows] = acc[1];
-                //out[row + sub_row + (i+2)*rows] = acc[2];
-                //out[row + sub_row + (i+3)*rows] = acc[3];
+    return 0;
+}
+
+/* Convolves the roi_cols x roi_rows region of interest at
+ * (roi_col, roi_row) in ``frame'' where it is, without copying it out.
+ * Only the pixels inside the region are read, so the output is the
+ * valid part of the region, as for any other image of that size.
+ * */
+int convolve_sse_2d_separable_roi(float* frame, int frame_pitch,
+        int roi_col, int roi_row, int roi_cols, int roi_rows,
+        float* out, int out_pitch, float* workspace, int workspace_pitch,
+        float* row_kernel, int row_length, float* col_kernel,
+        int col_length)
+{
+    return convolve_sse_2d_separable_strided(
+            frame + roi_row*frame_pitch + roi_col, frame_pitch,
+            out, out_pitch, workspace, workspace_pitch, roi_cols, roi_rows,
+            row_kernel, row_length, col_kernel, col_length);
+}
+
+/* Below this many output columns, the columns strategy cannot fill its
+ * accumulators and the transpose strategy wins, provided the image is
+ * tall enough for the transposed rows to be long. Found by timing the
+ * two in test_convolve; elsewhere the columns strategy is faster by up
+ * to 4x (1920x1080).
+ * */
+#define COLUMNS_MIN_OUT_COLS 32
+#define TRANSPOSE_MIN_ASPECT 4
+
+int convolve_sse_2d_separable(float* in, float* out, float* workspace, 
+        int cols, int rows, float* kernel, int kernel_length)
+{
+    int out_cols = cols - kernel_length + 1;
+    int out_rows = rows - kernel_length + 1;
+
+    if (out_cols < COLUMNS_MIN_OUT_COLS &&
+            out_rows > TRANSPOSE_MIN_ASPECT*out_cols){
+        return convolve_sse_2d_separable_transpose(in, out, workspace,
+                cols, rows, kernel, kernel_length);
+    }
+
+    return convolve_sse_2d_separable_columns(in, out, workspace,
+            cols, rows, kernel, kernel_length);
+}
+
+/* A separable 2D convolution done in place.
+ *
+ * ``data'' is a rows x cols image. On return, its first
+ * (rows-kernel_length+1) x (cols-kernel_length+1) floats hold the
+ * valid part of the image convolved with ``kernel'' along both the
+ * rows and the columns, packed with a row length of
+ * cols-kernel_length+1.
+ *
+ * Each row is first convolved in place. The columns are then convolved
+ * one output row at a time, which only depends on the rows at and below
+ * it, and the packed output row is never further into the image than
+ * the row it came from, so it only overwrites data that has been used.
+ * No buffer beyond the accumulators is needed in either pass.
+ * */
+int convolve_sse_2d_separable_in_place(float* data, int cols, int rows,
+        float* kernel, int kernel_length)
+{
+    int out_cols = cols - kernel_length + 1;
+    int out_rows = rows - kernel_length + 1;
+
+    for(int row=0; row<rows; row++){
+        _convolve_row(data + row*cols, data + row*cols, cols,
+                kernel, kernel_length);
+    }
+
+    for(int row=0; row<out_rows; row++){
+        _convolve_columns(data + row*cols, cols, data + row*out_cols,
+                out_cols, kernel, kernel_length);
+    }
+
+    return 0;
+}
+
+/* Streaming separable 2D convolution, for images that arrive a row at
+ * a time.
+ *
+ * Each row that is pushed is convolved along its length straight away
+ * and kept in a ring of kernel_length rows. Once the ring is full, every
+ * push also produces a row of output by convolving down the columns of
+ * the ring, so the output lags the input by kernel_length-1 rows and
+ * the memory used is O(kernel_length * cols).
+ *
+ * The ring is held twice over, with each row written to slot
+ * (n % kernel_length) and to the slot kernel_length after it. The
+ * kernel_length most recent rows are then always contiguous and in
+ * order somewhere in the buffer, which is what _convolve_columns wants.
+ * */
+int convolve_sse_2d_stream_workspace_length(int cols, int kernel_length)
+{
+    return 2 * kernel_length * (cols - kernel_length + 1);
+}
+
+int convolve_sse_2d_stream_init(convolve_sse_2d_stream* stream,
+        float* workspace, int cols, float* kernel, int kernel_length)
+{
+    stream->cols = cols;
+    stream->kernel = kernel;
+    stream->kernel_length = kernel_length;
+    stream->ring = workspace;
+    stream->rows_pushed = 0;
+
+    return 0;
+}
 
+int convolve_sse_2d_stream_push(convolve_sse_2d_stream* stream,
+        float* in_row, float* out_row)
+{
+    int kernel_length = stream->kernel_length;
+    int out_cols = stream->cols - kernel_length + 1;
+
+    int slot = stream->rows_pushed % kernel_length;
+    float* ring_row = stream->ring + slot*out_cols;
+
+    _convolve_row(in_row, ring_row, stream->cols,
+            stream->kernel, kernel_length);
+    memcpy(ring_row + kernel_length*out_cols, ring_row,
+            out_cols*sizeof(float));
+
+    stream->rows_pushed++;
+
+    if (stream->rows_pushed < kernel_length){
+        return 0;
+    }
+
+    // The oldest row in the ring is the one in the next slot along
+    int oldest = stream->rows_pushed % kernel_length;
+    _convolve_columns(stream->ring + oldest*out_cols, out_cols, out_row,
+            out_cols, stream->kernel, kernel_length);
+
+    return 1;
+}
+
+/* An incremental 2D convolution, for when only a small part of a large
+ * image changes between calls and the output of the last call is kept.
+ *
+ * Changed regions of the input are marked with
+ * convolve_sse_2d_incremental_mark_dirty, which grows a single dirty
+ * rectangle to cover them. convolve_sse_2d_incremental_update then only
+ * recomputes the outputs that read from that rectangle, that is the
+ * rectangle grown by the kernel lengths less one up and to the left and
+ * clipped to the output, and leaves the rest of ``out'' as it was. The
+ * sub-image is convolved where it is with the strided convolution.
+ * */
+int convolve_sse_2d_incremental_init(convolve_sse_2d_incremental* state,
+        float* workspace, int cols, int rows, float* row_kernel,
+        int row_length, float* col_kernel, int col_length)
+{
+    state->cols = cols;
+    state->rows = rows;
+    state->row_kernel = row_kernel;
+    state->row_length = row_length;
+    state->col_kernel = col_kernel;
+    state->col_length = col_length;
+    state->workspace = workspace;
+
+    state->x0 = 0;
+    state->y0 = 0;
+    state->x1 = cols;
+    state->y1 = rows;
+
+    return 0;
+}
+
+int convolve_sse_2d_incremental_mark_dirty(
+        convolve_sse_2d_incremental* state, int col, int row, int cols,
+        int rows)
+{
+    int x0 = col < 0 ? 0 : col;
+    int y0 = row < 0 ? 0 : row;
+    int x1 = col + cols > state->cols ? state->cols : col + cols;
+    int y1 = row + rows > state->rows ? state->rows : row + rows;
+
+    if (x0 >= x1 || y0 >= y1){
+        return 0;
+    }
+
+    if (state->x0 >= state->x1 || state->y0 >= state->y1){
+        state->x0 = x0;
+        state->y0 = y0;
+        state->x1 = x1;
+        state->y1 = y1;
+        return 0;
+    }
+
+    if (x0 < state->x0) state->x0 = x0;
+    if (y0 < state->y0) state->y0 = y0;
+    if (x1 > state->x1) state->x1 = x1;
+    if (y1 > state->y1) state->y1 = y1;
+
+    return 0;
+}
+
+int convolve_sse_2d_incremental_update(convolve_sse_2d_incremental* state,
+        float* in, float* out)
+{
+    int row_length = state->row_length;
+    int col_length = state->col_length;
+    int out_cols = state->cols - row_length + 1;
+    int out_rows = state->rows - col_length + 1;
+
+    // The outputs [ox0, ox1) x [oy0, oy1) read from the dirty rectangle
+    int ox0 = state->x0 - row_length + 1;
+    int oy0 = state->y0 - col_length + 1;
+    int ox1 = state->x1 < out_cols ? state->x1 : out_cols;
+    int oy1 = state->y1 < out_rows ? state->y1 : out_rows;
+    if (ox0 < 0) ox0 = 0;
+    if (oy0 < 0) oy0 = 0;
+
+    state->x0 = state->x1 = 0;
+    state->y0 = state->y1 = 0;
+
+    if (ox0 >= ox1 || oy0 >= oy1){
+        return 0;
+    }
+
+    int region_cols = ox1 - ox0 + row_length - 1;
+    int region_rows = oy1 - oy0 + col_length - 1;
+
+    return convolve_sse_2d_separable_strided(
+            in + oy0*state->cols + ox0, state->cols,
+            out + oy0*out_cols + ox0, out_cols,
+            state->workspace, ox1 - ox0, region_cols, region_rows,
+            state->row_kernel, row_length, state->col_kernel, col_length);
+}
+
+/* A separable 3D convolution of a slices x rows x cols volume, with
+ * ``kernel'' applied along all three axes. ``out'' is the valid part,
+ * (slices-kernel_length+1) x (rows-kernel_length+1) x
+ * (cols-kernel_length+1).
+ *
+ * The volume is cut into blocks of rows, and each block is streamed
+ * through the slices. For every slice, the x and y passes are done on
+ * just the block's rows (and the kernel_length-1 rows below it), and
+ * the result goes into a ring of kernel_length slices of the block,
+ * held twice over as in the streaming 2D convolution so that the
+ * newest kernel_length are contiguous. Once the ring is full, each new
+ * slice gives a slice of output by the z pass: a column pass with the
+ * block as the pitch, so each lane is a different x and nothing is
+ * transposed.
+ *
+ * The block is sized for the ring to stay in L2, so the volume is read
+ * once and the output written once, with no intermediate volume. The
+ * cost is that the row pass is repeated for the kernel_length-1 rows
+ * that neighbouring blocks share, so blocks are kept at least four
+ * times that tall.
+ *
+ * Blocks are split over threads with OpenMP when it is available.
+ * Returns -1 if the buffers for a thread cannot be allocated.
+ * */
+
+/* The number of floats the ring of a block aims for (1 MB), and the
+ * fewest rows a block has as a multiple of kernel_length-1, which
+ * bounds the repeated row passes to a quarter.
+ * */
+#define _3D_BLOCK_FLOATS 262144
+#define _3D_BLOCK_MIN_OVERLAPS 4
+
+int convolve_sse_3d_separable(float* in, float* out, int cols, int rows,
+        int slices, float* kernel, int kernel_length)
+{
+    int out_cols = cols - kernel_length + 1;
+    int out_rows = rows - kernel_length + 1;
+    int out_slices = slices - kernel_length + 1;
+
+    if (out_cols < 1 || out_rows < 1 || out_slices < 1){
+        return -1;
+    }
+
+    size_t in_plane = (size_t) rows * cols;
+    size_t out_plane = (size_t) out_rows * out_cols;
+
+    int block_rows = _3D_BLOCK_FLOATS / (2*kernel_length*out_cols);
+    if (block_rows < _3D_BLOCK_MIN_OVERLAPS*(kernel_length - 1)){
+        block_rows = _3D_BLOCK_MIN_OVERLAPS*(kernel_length - 1);
+    }
+    block_rows = block_rows < 1 ? 1 : block_rows;
+    block_rows = block_rows > out_rows ? out_rows : block_rows;
+
+    int n_blocks = (out_rows + block_rows - 1) / block_rows;
+    int failed = 0;
+
+    #pragma omp parallel
+    {
+        float* lines = malloc(sizeof(float) *
+                (block_rows + kernel_length - 1) * out_cols);
+        float* ring = malloc(sizeof(float) *
+                2 * kernel_length * block_rows * out_cols);
+
+        if (lines == NULL || ring == NULL){
+            #pragma omp atomic write
+            failed = 1;
+        }
+
+        #pragma omp for
+        for(int block=0; block<n_blocks; block++){
+            if (lines == NULL || ring == NULL){
+                continue;
             }
 
-            __m128 out1, out2, out3, out4;
-            if (sub_row == 4){
-                float* row1 = out_row - 3*(cols-KERNEL_LENGTH+1);
-                float* row2 = out_row - 2*(cols-KERNEL_LENGTH+1);
-                float* row3 = out_row - (cols-KERNEL_LENGTH+1);
-                float* row4 = out_row;
-
-                for(int i=0; i<cols-KERNEL_LENGTH; i+=4){
-                    out1 = _mm_load_ps(row1 + i);
-                    out2 = _mm_load_ps(row2 + i);
-                    out3 = _mm_load_ps(row3 + i);
-                    out4 = _mm_load_ps(row4 + i);
-                    _MM_TRANSPOSE4_PS(out1, out2, out3, out4);
-                
-                    _mm_store_ps(row1 + i, out1);
-                    _mm_store_ps(row2 + i, out2);
-                    _mm_store_ps(row3 + i, out3);
-                    _mm_store_ps(row4 + i, out4);
+            int first = block*block_rows;
+            int n_rows = out_rows - first < block_rows ?
+                out_rows - first : block_rows;
+            int block_length = n_rows*out_cols;
+
+            for(int slice=0; slice<slices; slice++){
+
+                float* in_row = in + slice*in_plane + (size_t) first*cols;
+                int slot = slice % kernel_length;
+                float* ring_block = ring + slot*block_length;
+
+                for(int row=0; row<n_rows+kernel_length-1; row++){
+                    _convolve_row(in_row + row*cols, lines + row*out_cols,
+                            cols, kernel, kernel_length);
                 }
+                _convolve_columns(lines, out_cols, ring_block, block_length,
+                        kernel, kernel_length);
+                memcpy(ring_block + kernel_length*block_length, ring_block,
+                        block_length*sizeof(float));
 
+                if (slice >= kernel_length - 1){
+                    int out_slice = slice - kernel_length + 1;
+                    int oldest = (slice + 1) % kernel_length;
+
+                    _convolve_columns(ring + oldest*block_length,
+                            block_length, out + out_slice*out_plane
+                            + (size_t) first*out_cols, block_length,
+                            kernel, kernel_length);
+                }
             }
+        }
+
+        free(lines);
+        free(ring);
+    }
+
+    return failed ? -1 : 0;
+}
+
+/* Gaussian pyramid construction with the blur and the 2x decimation
+ * fused, so that only the samples that are kept are ever computed.
+ *
+ * Each level is the valid part of the level before convolved with
+ * ``kernel'' along both axes and then decimated by 2 along both, so a
+ * level of c x r gives one of ((c-kernel_length)/2+1) x
+ * ((r-kernel_length)/2+1). Level 0 is ``in'' itself; levels 1 to
+ * ``levels'' are written one after another into ``arena'', which must
+ * hold convolve_sse_2d_pyramid_arena_length(cols, rows, levels,
+ * kernel_length) floats.
+ * convolve_sse_2d_pyramid_level finds level 1 or above in the arena.
+ *
+ * Every level must have at least one sample, so each level before the
+ * last must be at least kernel_length each way. If not, the arena
+ * length is -1, the level is NULL and the pyramid returns -1 without
+ * writing anything. The level is also NULL for a level below 1, and
+ * the pyramid returns -1 if its row buffers can't be allocated.
+ *
+ * Along the rows, the decimating kernel from convolve_template.h only
+ * computes the samples that are kept, while still using contiguous
+ * loads, so half the work of a full blur is skipped.
+ *
+ * Down the columns, only every other output row is computed, from a
+ * ring of decimated rows held as in the streaming convolution.
+ * */
+static inline
+void _pyramid_level_size(int cols, int rows, int kernel_length,
+        int* level_cols, int* level_rows)
+{
+    *level_cols = (cols - kernel_length)/2 + 1;
+    *level_rows = (rows - kernel_length)/2 + 1;
+}
+
+/* Whether every level up to ``levels'' has at least one sample; a level
+ * smaller than the kernel would leave the next one empty.
+ * */
+static inline
+int _pyramid_levels_exist(int cols, int rows, int levels, int kernel_length)
+{
+    for(int level=0; level<levels; level++){
+        if (cols < kernel_length || rows < kernel_length){
+            return 0;
+        }
+        _pyramid_level_size(cols, rows, kernel_length, &cols, &rows);
+    }
+
+    return 1;
+}
+
+int convolve_sse_2d_pyramid_arena_length(int cols, int rows, int levels,
+        int kernel_length)
+{
+    int length = 0;
+
+    if (!_pyramid_levels_exist(cols, rows, levels, kernel_length)){
+        return -1;
+    }
+
+    for(int level=0; level<levels; level++){
+        _pyramid_level_size(cols, rows, kernel_length, &cols, &rows);
+        length += cols * rows;
+    }
+
+    return length;
+}
+
+float* convolve_sse_2d_pyramid_level(float* arena, int cols, int rows,
+        int level, int kernel_length, int* level_cols, int* level_rows)
+{
+    float* level_data = arena;
+
+    // Level 0 is the input, which isn't in the arena
+    if (level < 1
+            || !_pyramid_levels_exist(cols, rows, level, kernel_length)){
+        return NULL;
+    }
+
+    for(int l=0; l<level; l++){
+        if (l > 0){
+            level_data += cols * rows;
+        }
+        _pyramid_level_size(cols, rows, kernel_length, &cols, &rows);
+    }
+
+    *level_cols = cols;
+    *level_rows = rows;
+
+    return level_data;
+}
+
+int convolve_sse_2d_pyramid(float* in, float* arena, int cols, int rows,
+        int levels, float* kernel, int kernel_length)
+{
+    float* level_in = in;
+    float* level_out = arena;
+
+    if (!_pyramid_levels_exist(cols, rows, levels, kernel_length)){
+        return -1;
+    }
+    if (levels < 1){
+        return 0;
+    }
+
+    // Sized for the first level, the widest
+    int first_cols = (cols - kernel_length)/2 + 1;
+    float* even = malloc(sizeof(float) *
+            (2*(cols/2 + 1) + 2*kernel_length*first_cols));
+    if (even == NULL){
+        return -1;
+    }
+    float* odd = even + cols/2 + 1;
+    float* ring = odd + cols/2 + 1;
+
+    for(int level=0; level<levels; level++){
 
-            // Need to do the last value as a special case
-            int i = cols - KERNEL_LENGTH;
-            
-            //float* final_out = out_row + i;
-            //float* final_out = out + row + i*rows; // takes the transpose
-            float* final_out = out + row + sub_row + i*rows; // takes the transpose
+        int out_cols, out_rows;
+        _pyramid_level_size(cols, rows, kernel_length, &out_cols, &out_rows);
 
-            *final_out = 0.0;
-            for(int k=0; k<KERNEL_LENGTH; k++){
-                *final_out += in_aligned[0][i+k] * kernel[KERNEL_LENGTH - k - 1];
+        int out_row = 0;
+        for(int row=0; row<rows && out_row<out_rows; row++){
+
+            float* ring_row = ring + (row % kernel_length)*out_cols;
+
+            _convolve_row_decimate(level_in + row*cols, ring_row, cols,
+                    kernel, kernel_length, even, odd);
+            memcpy(ring_row + kernel_length*out_cols, ring_row,
+                    out_cols*sizeof(float));
+
+            // Output row r needs the decimated rows 2r to 2r+kernel_length-1
+            if (row == 2*out_row + kernel_length - 1){
+                int oldest = (row + 1) % kernel_length;
+                _convolve_columns(ring + oldest*out_cols, out_cols,
+                        level_out + out_row*out_cols, out_cols,
+                        kernel, kernel_length);
+                out_row++;
             }
         }
+
+        level_in = level_out;
+        level_out += out_cols * out_rows;
+        cols = out_cols;
+        rows = out_rows;
     }
 
+    free(even);
+
     return 0;
 }
 
-int convolve_sse_2d_separable(float* in, float* out, float* workspace, 
+/* Multi-channel images, with the same kernel applied to every channel.
+ *
+ * Interleaved images (RGBRGB... or RGBARGBA...) are convolved along the
+ * rows with the taps ``channels'' floats apart, so each vector covers
+ * whichever pixels and channels are next to each other and all the
+ * channels are done together. Down the columns an interleaved image is
+ * no different from a single channel one that is cols*channels wide.
+ * ``workspace'' needs rows*(cols-kernel_length+1)*channels floats and
+ * ``out'' is interleaved in the same way as ``in''.
+ *
+ * Planar images are convolved a plane at a time into planar output,
+ * sharing the one workspace of rows*(cols-kernel_length+1) floats.
+ *
+ * The uint8 versions convert each row to float as it is used and round
+ * and saturate each output row back to uint8, so the float image is
+ * never held in full. Their workspace is as for the float versions.
+ * */
+int convolve_sse_2d_separable_interleaved(float* in, float* out,
+        float* workspace, int cols, int rows, int channels,
+        float* kernel, int kernel_length)
+{
+    int out_width = (cols - kernel_length + 1)*channels;
+    int out_rows = rows - kernel_length + 1;
+
+    for(int row=0; row<rows; row++){
+        _convolve_row_dilated(in + row*cols*channels,
+                workspace + row*out_width, cols*channels,
+                kernel, kernel_length, channels);
+    }
+
+    for(int row=0; row<out_rows; row++){
+        _convolve_columns(workspace + row*out_width, out_width,
+                out + row*out_width, out_width, kernel, kernel_length);
+    }
+
+    return 0;
+}
+
+int convolve_sse_2d_separable_planar(float* in, float* out,
+        float* workspace, int cols, int rows, int channels,
+        float* kernel, int kernel_length)
+{
+    int out_plane = (cols - kernel_length + 1)*(rows - kernel_length + 1);
+
+    for(int channel=0; channel<channels; channel++){
+        convolve_sse_2d_separable(in + channel*cols*rows,
+                out + channel*out_plane, workspace, cols, rows,
+                kernel, kernel_length);
+    }
+
+    return 0;
+}
+
+static inline
+void _u8_to_float(uint8_t* in, float* out, int length)
+{
+    __m128i zero = _mm_setzero_si128();
+
+    int i = 0;
+    for(; i<=length-16; i+=16){
+        __m128i bytes = _mm_loadu_si128((__m128i*)(in + i));
+        __m128i lower = _mm_unpacklo_epi8(bytes, zero);
+        __m128i upper = _mm_unpackhi_epi8(bytes, zero);
+
+        _mm_storeu_ps(out + i, _mm_cvtepi32_ps(
+                    _mm_unpacklo_epi16(lower, zero)));
+        _mm_storeu_ps(out + i + 4, _mm_cvtepi32_ps(
+                    _mm_unpackhi_epi16(lower, zero)));
+        _mm_storeu_ps(out + i + 8, _mm_cvtepi32_ps(
+                    _mm_unpacklo_epi16(upper, zero)));
+        _mm_storeu_ps(out + i + 12, _mm_cvtepi32_ps(
+                    _mm_unpackhi_epi16(upper, zero)));
+    }
+    for(; i<length; i++){
+        out[i] = in[i];
+    }
+}
+
+static inline
+void _float_to_u8(float* in, uint8_t* out, int length)
+{
+    int i = 0;
+    for(; i<=length-16; i+=16){
+        // Round to nearest, then saturate on the way down to 8 bits
+        __m128i out1 = _mm_cvtps_epi32(_mm_loadu_ps(in + i));
+        __m128i out2 = _mm_cvtps_epi32(_mm_loadu_ps(in + i + 4));
+        __m128i out3 = _mm_cvtps_epi32(_mm_loadu_ps(in + i + 8));
+        __m128i out4 = _mm_cvtps_epi32(_mm_loadu_ps(in + i + 12));
+
+        __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(out1, out2),
+                _mm_packs_epi32(out3, out4));
+        _mm_storeu_si128((__m128i*)(out + i), bytes);
+    }
+    for(; i<length; i++){
+        float value = nearbyintf(in[i]);
+        out[i] = value < 0 ? 0 : (value > 255 ? 255 : (uint8_t)value);
+    }
+}
+
+int convolve_sse_2d_separable_interleaved_u8(uint8_t* in, uint8_t* out,
+        float* workspace, int cols, int rows, int channels,
+        float* kernel, int kernel_length)
+{
+    int width = cols*channels;
+    int out_width = (cols - kernel_length + 1)*channels;
+    int out_rows = rows - kernel_length + 1;
+
+    float line[width];
+
+    for(int row=0; row<rows; row++){
+        _u8_to_float(in + row*width, line, width);
+        _convolve_row_dilated(line, workspace + row*out_width, width,
+                kernel, kernel_length, channels);
+    }
+
+    for(int row=0; row<out_rows; row++){
+        _convolve_columns(workspace + row*out_width, out_width,
+                line, out_width, kernel, kernel_length);
+        _float_to_u8(line, out + row*out_width, out_width);
+    }
+
+    return 0;
+}
+
+int convolve_sse_2d_separable_planar_u8(uint8_t* in, uint8_t* out,
+        float* workspace, int cols, int rows, int channels,
+        float* kernel, int kernel_length)
+{
+    int out_plane = (cols - kernel_length + 1)*(rows - kernel_length + 1);
+
+    for(int channel=0; channel<channels; channel++){
+        convolve_sse_2d_separable_interleaved_u8(in + channel*cols*rows,
+                out + channel*out_plane, workspace, cols, rows, 1,
+                kernel, kernel_length);
+    }
+
+    return 0;
+}
+
+/* Separable 2D convolution of a batch of ``n'' images of the same size,
+ * stored one after another (NHW), into a batch of outputs stored the
+ * same way.
+ *
+ * Each image is run through the streaming convolution, so the only
+ * workspace is one ring of kernel_length rows per thread, made once
+ * and reused for every image in the batch. It stays in L1, where a full
+ * size workspace per image would be pushed out to memory between the
+ * two passes, and the per-image overhead is just resetting the ring.
+ * The lanes run along the rows, which for the widths this is aimed at
+ * (128 and up) fills the vectors as well as one large image would.
+ *
+ * The images are split over threads with OpenMP when it is available.
+ * Returns -1 if a thread's ring can't be allocated.
+ * */
+int convolve_sse_2d_separable_batch(float* in, float* out, int n,
         int cols, int rows, float* kernel, int kernel_length)
 {
-    float id_kernel[16];
-    id_kernel[0] = 1.0;
-    for(int i=1; i<16; i++){
-        id_kernel[i] = 0;
+    int out_cols = cols - kernel_length + 1;
+    int out_rows = rows - kernel_length + 1;
+
+    // As size_t, so that a big batch cannot overflow the offsets
+    size_t in_image = (size_t) rows * cols;
+    size_t out_image = (size_t) out_rows * out_cols;
+    int failed = 0;
+
+    #pragma omp parallel
+    {
+        float* ring = malloc(sizeof(float) *
+                convolve_sse_2d_stream_workspace_length(cols, kernel_length));
+        convolve_sse_2d_stream stream;
+
+        if (ring == NULL){
+            #pragma omp atomic write
+            failed = 1;
+        }
+
+        #pragma omp for
+        for(int image=0; image<n; image++){
+            if (ring == NULL){
+                continue;
+            }
+
+            float* image_in = in + image*in_image;
+            float* out_row = out + image*out_image;
+
+            convolve_sse_2d_stream_init(&stream, ring, cols, kernel,
+                    kernel_length);
+
+            for(int row=0; row<rows; row++){
+                if (convolve_sse_2d_stream_push(&stream,
+                            image_in + row*cols, out_row)){
+                    out_row += out_cols;
+                }
+            }
+        }
+
+        free(ring);
+    }
+
+    return failed ? -1 : 0;
+}
+
+/* Image gradients, with the x and y derivatives (and optionally the
+ * gradient magnitude and orientation) computed together in one pass.
+ *
+ * The x derivative is the image convolved with ``derivative'' along the
+ * rows and with ``smooth'' down the columns; the y derivative is the
+ * other way round. Each input row is convolved with both kernels at
+ * once, sharing the loads, into two rings of kernel_length rows as in
+ * the streaming convolution. Every row of gx and gy then comes from the
+ * two column passes over the rings, and the magnitude and orientation
+ * are computed from those rows while they are still in L1.
+ *
+ * All the outputs are (rows-kernel_length+1) x (cols-kernel_length+1).
+ * Any of them can be NULL if it isn't wanted, and no intermediate image
+ * is ever written. The orientation is atan2(gy, gx) in radians.
+ * Returns -1 if the rings can't be allocated.
+ * */
+static inline
+void _gradient_magnitude(float* gx, float* gy, float* magnitude,
+        int length)
+{
+    __m128 x, y;
+
+    int i = 0;
+    for(; i<=length-4; i+=4){
+        x = _mm_loadu_ps(gx + i);
+        y = _mm_loadu_ps(gy + i);
+        _mm_storeu_ps(magnitude + i, _mm_sqrt_ps(
+                    _mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y))));
+    }
+    for(; i<length; i++){
+        magnitude[i] = sqrtf(gx[i]*gx[i] + gy[i]*gy[i]);
     }
+}
+
+int convolve_sse_2d_gradient(float* in, float* gx, float* gy,
+        float* magnitude, float* orientation, int cols, int rows,
+        float* smooth, float* derivative, int kernel_length)
+{
+    int out_cols = cols - kernel_length + 1;
+    int ring_length = convolve_sse_2d_stream_workspace_length(
+            cols, kernel_length);
+
+    float* smooth_ring = malloc(sizeof(float) *
+            (2*ring_length + 2*out_cols));
+    if (smooth_ring == NULL){
+        return -1;
+    }
+    float* derivative_ring = smooth_ring + ring_length;
+    float* gx_line = derivative_ring + ring_length;
+    float* gy_line = gx_line + out_cols;
+
+    for(int row=0; row<rows; row++){
+
+        int slot = row % kernel_length;
+        float* smooth_row = smooth_ring + slot*out_cols;
+        float* derivative_row = derivative_ring + slot*out_cols;
+
+        _convolve_row_pair(in + row*cols, smooth_row, derivative_row, cols,
+                smooth, derivative, kernel_length);
+        memcpy(smooth_row + kernel_length*out_cols, smooth_row,
+                out_cols*sizeof(float));
+        memcpy(derivative_row + kernel_length*out_cols, derivative_row,
+                out_cols*sizeof(float));
+
+        if (row < kernel_length - 1){
+            continue;
+        }
+
+        int out_row = row - kernel_length + 1;
+        int oldest = (row + 1) % kernel_length;
 
-    _convolve_along_rows_with_transpose(in, workspace, cols, rows, kernel);
-    _convolve_along_rows_with_transpose(workspace, out, rows, cols, id_kernel);
+        float* gx_row = gx ? gx + out_row*out_cols : gx_line;
+        float* gy_row = gy ? gy + out_row*out_cols : gy_line;
+
+        _convolve_columns(derivative_ring + oldest*out_cols, out_cols,
+                gx_row, out_cols, smooth, kernel_length);
+        _convolve_columns(smooth_ring + oldest*out_cols, out_cols,
+                gy_row, out_cols, derivative, kernel_length);
+
+        if (magnitude){
+            _gradient_magnitude(gx_row, gy_row,
+                    magnitude + out_row*out_cols, out_cols);
+        }
+
+        if (orientation){
+            float* orientation_row = orientation + out_row*out_cols;
+            for(int i=0; i<out_cols; i++){
+                orientation_row[i] = atan2f(gy_row[i], gx_row[i]);
+            }
+        }
+    }
+
+    free(smooth_ring);
+
+    return 0;
+}
+
+/* The 3x3 Sobel and Scharr operators. */
+int convolve_sse_2d_sobel(float* in, float* gx, float* gy,
+        float* magnitude, float* orientation, int cols, int rows)
+{
+    float smooth[3] = {1.0, 2.0, 1.0};
+    float derivative[3] = {1.0, 0.0, -1.0};
+
+    return convolve_sse_2d_gradient(in, gx, gy, magnitude, orientation,
+            cols, rows, smooth, derivative, 3);
+}
+
+int convolve_sse_2d_scharr(float* in, float* gx, float* gy,
+        float* magnitude, float* orientation, int cols, int rows)
+{
+    float smooth[3] = {3.0, 10.0, 3.0};
+    float derivative[3] = {1.0, 0.0, -1.0};
+
+    return convolve_sse_2d_gradient(in, gx, gy, magnitude, orientation,
+            cols, rows, smooth, derivative, 3);
+}
+
+/* Derivative of Gaussian, with the Gaussian and its derivative sampled
+ * at the kernel_length points about the centre. The Gaussian is scaled
+ * to sum to 1, and the derivative by the same amount, so that a ramp
+ * of slope 1 gives a gradient of (close to) 1.
+ * */
+int convolve_sse_2d_gaussian_gradient(float* in, float* gx, float* gy,
+        float* magnitude, float* orientation, int cols, int rows,
+        float sigma, int kernel_length)
+{
+    float smooth[kernel_length];
+    float derivative[kernel_length];
+
+    float centre = (kernel_length - 1) / 2.0;
+    float sum = 0.0;
+
+    for(int i=0; i<kernel_length; i++){
+        float x = i - centre;
+        smooth[i] = expf(-x*x / (2*sigma*sigma));
+        derivative[i] = -x / (sigma*sigma) * smooth[i];
+        sum += smooth[i];
+    }
+
+    for(int i=0; i<kernel_length; i++){
+        smooth[i] /= sum;
+        derivative[i] /= sum;
+    }
+
+    return convolve_sse_2d_gradient(in, gx, gy, magnitude, orientation,
+            cols, rows, smooth, derivative, kernel_length);
+}
+
+/* A direct 2D convolution with a kernel that is not separable, with
+ * ``kernel'' stored a row at a time. Each output row is the sum of the
+ * 1D convolutions of kernel_rows input rows with the kernel rows, last
+ * kernel row first, so ``out'' is
+ * (rows-kernel_rows+1) x (cols-kernel_cols+1) as for the separable case.
+ *
+ * The output rows are split over threads with OpenMP when it is
+ * available.
+ * */
+int convolve_sse_2d_direct(float* in, float* out, int cols, int rows,
+        float* kernel, int kernel_cols, int kernel_rows)
+{
+    int out_cols = cols - kernel_cols + 1;
+    int out_rows = rows - kernel_rows + 1;
+
+    #pragma omp parallel
+    {
+        float partial[out_cols];
+
+        #pragma omp for
+        for(int row=0; row<out_rows; row++){
+            float* out_row = out + row*out_cols;
+
+            _convolve_row(in + row*cols, out_row, cols,
+                    kernel + (kernel_rows - 1)*kernel_cols, kernel_cols);
+
+            for(int k=1; k<kernel_rows; k++){
+                _convolve_row(in + (row + k)*cols, partial, cols,
+                        kernel + (kernel_rows - 1 - k)*kernel_cols,
+                        kernel_cols);
+
+                for(int i=0; i<out_cols; i++){
+                    out_row[i] += partial[i];
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+/* The separable convolution followed by pooling over pool_cols x
+ * pool_rows windows, as convolve_sse_generic_pool does in 1D; ``mode''
+ * is one of the CONVOLVE_POOL_ reductions. ``out'' is
+ * ((rows-col_length+1)/pool_rows) x ((cols-row_length+1)/pool_cols),
+ * with partial windows at the right and bottom dropped. For
+ * CONVOLVE_POOL_ARGMAX, ``argmax'' gets the index of each maximum in the
+ * (unpooled) convolution output, row*(cols-row_length+1) + col.
+ *
+ * The row pass goes to ``workspace'' (rows x (cols-row_length+1)) as
+ * for convolve_sse_2d_separable_asymmetric. The column pass is then
+ * pooled a row at a time as it is made, so the convolution output is
+ * never written out: each thread keeps one convolved row and one
+ * vertically pooled row, and only the pooled output is stored. Unlike
+ * the 1D pooling, the reductions are not done in the accumulators; the
+ * rows are pooled from those line buffers, which stay in L1.
+ *
+ * Returns 0, or -1 if pool_cols or pool_rows is less than 1.
+ * */
+int convolve_sse_2d_separable_pool(float* in, float* out, int* argmax,
+        float* workspace, int cols, int rows, float* row_kernel,
+        int row_length, float* col_kernel, int col_length, int pool_cols,
+        int pool_rows, int mode)
+{
+    if (pool_cols < 1 || pool_rows < 1){
+        return -1;
+    }
+
+    int out_cols = cols - row_length + 1;
+    int out_rows = rows - col_length + 1;
+    int pooled_cols = out_cols / pool_cols;
+    int pooled_rows = out_rows / pool_rows;
+
+    // Rows below the last whole window are never needed
+    int used_rows = pooled_rows*pool_rows + col_length - 1;
+
+    for(int row=0; row<used_rows; row++){
+        _convolve_row(in + row*cols, workspace + row*out_cols, cols,
+                row_kernel, row_length);
+    }
+
+    #pragma omp parallel
+    {
+        float line[out_cols];
+        float pooled[out_cols];
+        int best_row[out_cols];
+
+        #pragma omp for
+        for(int pooled_row=0; pooled_row<pooled_rows; pooled_row++){
+
+            int row = pooled_row*pool_rows;
+
+            _convolve_columns(workspace + row*out_cols, out_cols, pooled,
+                    out_cols, col_kernel, col_length);
+            for(int i=0; i<out_cols; i++){
+                best_row[i] = row;
+            }
+
+            for(int sub_row=1; sub_row<pool_rows; sub_row++){
+                _convolve_columns(workspace + (row + sub_row)*out_cols,
+                        out_cols, line, out_cols, col_kernel, col_length);
+
+                if (mode == CONVOLVE_POOL_MEAN){
+                    for(int i=0; i<out_cols; i++){
+                        pooled[i] += line[i];
+                    }
+                } else if (mode == CONVOLVE_POOL_MAX){
+                    for(int i=0; i<out_cols; i++){
+                        pooled[i] = line[i] > pooled[i] ? line[i] : pooled[i];
+                    }
+                } else {
+                    for(int i=0; i<out_cols; i++){
+                        if (line[i] > pooled[i]){
+                            pooled[i] = line[i];
+                            best_row[i] = row + sub_row;
+                        }
+                    }
+                }
+            }
+
+            float* out_row = out + pooled_row*pooled_cols;
+            float scale = 1.0f / (pool_cols * pool_rows);
+
+            for(int c=0; c<pooled_cols; c++){
+                float* window = pooled + c*pool_cols;
+                float best = window[0];
+                float sum = window[0];
+                int best_col = 0;
+
+                for(int i=1; i<pool_cols; i++){
+                    sum += window[i];
+                    if (window[i] > best){
+                        best = window[i];
+                        best_col = i;
+                    }
+                }
+
+                out_row[c] = mode == CONVOLVE_POOL_MEAN ? sum * scale : best;
+                if (mode == CONVOLVE_POOL_ARGMAX){
+                    int col = c*pool_cols + best_col;
+                    argmax[pooled_row*pooled_cols + c] =
+                        best_row[col]*out_cols + col;
+                }
+            }
+        }
+    }
 
     return 0;
 }
 
+/* Checks whether ``kernel'' is the outer product of a column and a row,
+ * that is whether it has rank 1, to within a small tolerance. If it is,
+ * the row and column kernels are written out and 1 is returned, and the
+ * separable convolution with them gives the same result as the direct
+ * convolution. Otherwise 0 is returned.
+ *
+ * The factors are the row and column through the largest coefficient,
+ * which is all an SVD would find for a rank 1 kernel.
+ * */
+int convolve_sse_2d_kernel_separate(float* kernel, int kernel_cols,
+        int kernel_rows, float* row_kernel, float* col_kernel)
+{
+    int n = kernel_cols * kernel_rows;
+
+    int largest = 0;
+    for(int i=1; i<n; i++){
+        if (fabsf(kernel[i]) > fabsf(kernel[largest])){
+            largest = i;
+        }
+    }
+
+    float pivot = kernel[largest];
+    if (pivot == 0.0f){
+        return 0;
+    }
+
+    int pivot_row = largest / kernel_cols;
+    int pivot_col = largest % kernel_cols;
+
+    for(int i=0; i<kernel_rows; i++){
+        col_kernel[i] = kernel[i*kernel_cols + pivot_col];
+    }
+    for(int i=0; i<kernel_cols; i++){
+        row_kernel[i] = kernel[pivot_row*kernel_cols + i] / pivot;
+    }
+
+    float tolerance = 1e-6f * fabsf(pivot);
+    for(int i=0; i<kernel_rows; i++){
+        for(int j=0; j<kernel_cols; j++){
+            float error = kernel[i*kernel_cols + j]
+                - col_kernel[i]*row_kernel[j];
+            if (fabsf(error) > tolerance){
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
 #endif
@@ -28,41 +28,189 @@
 #ifndef _CONVOLVE_2D_H
 #define _CONVOLVE_2D_H
 
+#include <stdint.h>
+
 #ifdef SSE3
 #include <pmmintrin.h>
 #include <xmmintrin.h>
 #endif
 
-/* A macro that outputs a wrapper for each of the convolution routines.
- * The macro passed a name conv_func will output a function called
- * conv_func_multiple and it will have signature:
- * conv_func_multiple(float* in, float* out, int length,
- *                    float* kernel, int kernel_length, int N)
+/* A macro that outputs the prototype of the wrapper for each of the 2D
+ * convolution routines, which are defined in multiple_convolve.c.
+ * The macro passed a name conv_func declares a function called
+ * conv_func_multiple with signature:
+ * conv_func_multiple(float* in, float* out, float* workspace,
+ *                    int cols, int rows, float* kernel,
+ *                    int kernel_length, int N)
  * 
  * The additional N defines how many times to run the convolution function
- * conv_func(float* in, float* out, int length,
+ * conv_func(float* in, float* out, float* workspace, int cols, int rows,
  *                    float* kernel, int kernel_length)
  * */
 
 #ifndef MULTIPLE_CONVOLVE_2D
-#define MULTIPLE_CONVOLVE_2D(FUNCTION_NAME) \
+#define MULTIPLE_CONVOLVE_2D_PROTO(FUNCTION_NAME) \
 int FUNCTION_NAME ## _multiple(float* in, float* out, float* workspace, \
-        int cols, int rows, float* kernel, int kernel_length, int N) \
-{ \
-    for(int i=0; i<N; i++){ \
-        FUNCTION_NAME(in, out, workspace, cols, rows, kernel, \
-                kernel_length); \
-    } \
- \
-    return 0; \
-}
+        int cols, int rows, float* kernel, int kernel_length, int N);
 #endif
 
 #ifdef SSE3
 
 int convolve_sse_2d_separable(float* in, float* out, float* workspace,
         int cols, int rows, float* kernel, int kernel_length);
-MULTIPLE_CONVOLVE_2D(convolve_sse_2d_separable);
+MULTIPLE_CONVOLVE_2D_PROTO(convolve_sse_2d_separable);
+
+int convolve_sse_2d_separable_transpose(float* in, float* out,
+        float* workspace, int cols, int rows, float* kernel,
+        int kernel_length);
+MULTIPLE_CONVOLVE_2D_PROTO(convolve_sse_2d_separable_transpose);
+
+int convolve_sse_2d_separable_columns(float* in, float* out,
+        float* workspace, int cols, int rows, float* kernel,
+        int kernel_length);
+MULTIPLE_CONVOLVE_2D_PROTO(convolve_sse_2d_separable_columns);
+
+int convolve_sse_2d_separable_asymmetric(float* in, float* out,
+        float* workspace, int cols, int rows, float* row_kernel,
+        int row_length, float* col_kernel, int col_length);
+
+/* Views into larger images: each pitch is the distance between rows. */
+int convolve_sse_2d_separable_strided(float* in, int in_pitch,
+        float* out, int out_pitch, float* workspace, int workspace_pitch,
+        int cols, int rows, float* row_kernel, int row_length,
+        float* col_kernel, int col_length);
+
+int convolve_sse_2d_separable_roi(float* frame, int frame_pitch,
+        int roi_col, int roi_row, int roi_cols, int roi_rows,
+        float* out, int out_pitch, float* workspace, int workspace_pitch,
+        float* row_kernel, int row_length, float* col_kernel,
+        int col_length);
+
+int convolve_sse_2d_separable_in_place(float* data, int cols, int rows,
+        float* kernel, int kernel_length);
+
+/* The state of a streaming 2D convolution (see convolve_2d.c).
+ *
+ * The workspace passed to convolve_sse_2d_stream_init must be at least
+ * convolve_sse_2d_stream_workspace_length(cols, kernel_length) floats
+ * long, and it and the kernel must outlive the stream.
+ *
+ * Each call to convolve_sse_2d_stream_push takes the next input row and
+ * returns 1 if it wrote a row of output (cols-kernel_length+1 floats),
+ * or 0 if the stream is still filling.
+ * */
+typedef struct {
+    int cols;
+    float* kernel;
+    int kernel_length;
+    float* ring;
+    int rows_pushed;
+} convolve_sse_2d_stream;
+
+int convolve_sse_2d_stream_workspace_length(int cols, int kernel_length);
+
+int convolve_sse_2d_stream_init(convolve_sse_2d_stream* stream,
+        float* workspace, int cols, float* kernel, int kernel_length);
+
+int convolve_sse_2d_stream_push(convolve_sse_2d_stream* stream,
+        float* in_row, float* out_row);
+
+/* The state of an incremental 2D convolution (see convolve_2d.c).
+ *
+ * The workspace passed to convolve_sse_2d_incremental_init must hold
+ * rows*(cols-row_length+1) floats, and it and the kernels must outlive
+ * the state. The whole image starts out dirty, so the first update
+ * computes the full output.
+ * */
+typedef struct {
+    int cols;
+    int rows;
+    float* row_kernel;
+    int row_length;
+    float* col_kernel;
+    int col_length;
+    float* workspace;
+    // The dirty rectangle of the input is [x0, x1) x [y0, y1)
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+} convolve_sse_2d_incremental;
+
+int convolve_sse_2d_incremental_init(convolve_sse_2d_incremental* state,
+        float* workspace, int cols, int rows, float* row_kernel,
+        int row_length, float* col_kernel, int col_length);
+
+int convolve_sse_2d_incremental_mark_dirty(
+        convolve_sse_2d_incremental* state, int col, int row, int cols,
+        int rows);
+
+int convolve_sse_2d_incremental_update(convolve_sse_2d_incremental* state,
+        float* in, float* out);
+
+int convolve_sse_3d_separable(float* in, float* out, int cols, int rows,
+        int slices, float* kernel, int kernel_length);
+
+/* Gaussian pyramids (see convolve_2d.c). The arena holds levels 1 to
+ * ``levels''; level 0 is the input.
+ * */
+int convolve_sse_2d_pyramid_arena_length(int cols, int rows, int levels,
+        int kernel_length);
+
+float* convolve_sse_2d_pyramid_level(float* arena, int cols, int rows,
+        int level, int kernel_length, int* level_cols, int* level_rows);
+
+int convolve_sse_2d_pyramid(float* in, float* arena, int cols, int rows,
+        int levels, float* kernel, int kernel_length);
+
+/* Multi-channel images, interleaved or planar, in float or uint8. */
+int convolve_sse_2d_separable_interleaved(float* in, float* out,
+        float* workspace, int cols, int rows, int channels,
+        float* kernel, int kernel_length);
+
+int convolve_sse_2d_separable_planar(float* in, float* out,
+        float* workspace, int cols, int rows, int channels,
+        float* kernel, int kernel_length);
+
+int convolve_sse_2d_separable_interleaved_u8(uint8_t* in, uint8_t* out,
+        float* workspace, int cols, int rows, int channels,
+        float* kernel, int kernel_length);
+
+int convolve_sse_2d_separable_planar_u8(uint8_t* in, uint8_t* out,
+        float* workspace, int cols, int rows, int channels,
+        float* kernel, int kernel_length);
+
+/* Fused image gradients. Unwanted outputs can be passed as NULL. */
+int convolve_sse_2d_gradient(float* in, float* gx, float* gy,
+        float* magnitude, float* orientation, int cols, int rows,
+        float* smooth, float* derivative, int kernel_length);
+
+int convolve_sse_2d_sobel(float* in, float* gx, float* gy,
+        float* magnitude, float* orientation, int cols, int rows);
+
+int convolve_sse_2d_scharr(float* in, float* gx, float* gy,
+        float* magnitude, float* orientation, int cols, int rows);
+
+int convolve_sse_2d_gaussian_gradient(float* in, float* gx, float* gy,
+        float* magnitude, float* orientation, int cols, int rows,
+        float sigma, int kernel_length);
+
+/* A batch of n images, stored one after another. */
+int convolve_sse_2d_separable_batch(float* in, float* out, int n,
+        int cols, int rows, float* kernel, int kernel_length);
+
+/* Fused with max, mean or argmax pooling (CONVOLVE_POOL_ in convolve.h). */
+int convolve_sse_2d_separable_pool(float* in, float* out, int* argmax,
+        float* workspace, int cols, int rows, float* row_kernel,
+        int row_length, float* col_kernel, int col_length, int pool_cols,
+        int pool_rows, int mode);
+
+/* Non-separable kernels, which are kernel_rows x kernel_cols. */
+int convolve_sse_2d_direct(float* in, float* out, int cols, int rows,
+        float* kernel, int kernel_cols, int kernel_rows);
+
+int convolve_sse_2d_kernel_separate(float* kernel, int kernel_cols,
+        int kernel_rows, float* row_kernel, float* col_kernel);
 
 #endif
 
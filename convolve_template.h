@@ -0,0 +1,1021 @@
+/* Copyright (C) 2013 Henry Gomersall <heng@cantab.net> 
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the organization nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY  THE AUTHOR ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+/* The generic convolution kernels, written once against the simd.h
+ * wrappers.
+ *
+ * This file has no include guard: it is included once per instruction
+ * set with SIMD_ISA defined to the simd.h prefix, and each inclusion
+ * emits the functions for that instruction set (so with SIMD_ISA set to
+ * avx, SIMD_FUNC(generic) below becomes convolve_avx_generic).
+ *
+ * Apart from the strategy kernel (which the hand tuned kernels in
+ * convolve.c are built from), these place no restriction on the input
+ * or kernel lengths and never write past the end of ``out''.
+ *
+ * They can also all be run in place (with ``out'' the same as ``in''):
+ * output i depends only on inputs i and above, and every block of output
+ * is held in the accumulators until all the input it needs has been
+ * read, so the forward sweep only ever overwrites input that has been
+ * finished with.
+ * */
+
+#ifndef SIMD_ISA
+#error "SIMD_ISA must be defined before including convolve_template.h"
+#endif
+
+/* The unrolled vector strategy of convolve_sse_unrolled_vector and
+ * convolve_avx_unrolled_vector_unaligned_fma: four accumulators, each
+ * SIMD_WIDTH output samples wide, are updated from unaligned loads for
+ * every (reversed, broadcast) kernel value.
+ *
+ * Whatever does not fill the four accumulators is done a vector at a
+ * time, and whatever does not fill a vector is done with scalars.
+ * */
+static inline __attribute__ ((always_inline))
+int SIMD_FUNC(generic_body)(float* in, float* out, int length,
+        float* kernel, int kernel_length)
+{
+    SIMD_T kernel_reverse[kernel_length];
+    SIMD_T acc0, acc1, acc2, acc3;
+
+    int out_length = length - kernel_length + 1;
+
+    // Reverse the kernel and repeat each value across a vector
+    for(int i=0; i<kernel_length; i++){
+        kernel_reverse[i] = SIMD_OP(set1)(kernel[kernel_length - i - 1]);
+    }
+
+    int i = 0;
+    for(; i<=out_length - 4*SIMD_WIDTH; i+=4*SIMD_WIDTH){
+
+        acc0 = SIMD_OP(zero)();
+        acc1 = SIMD_OP(zero)();
+        acc2 = SIMD_OP(zero)();
+        acc3 = SIMD_OP(zero)();
+
+        for(int k=0; k<kernel_length; k++){
+
+            float* data = in + i + k;
+
+            acc0 = SIMD_OP(fmadd)(kernel_reverse[k],
+                    SIMD_OP(loadu)(data), acc0);
+            acc1 = SIMD_OP(fmadd)(kernel_reverse[k],
+                    SIMD_OP(loadu)(data + SIMD_WIDTH), acc1);
+            acc2 = SIMD_OP(fmadd)(kernel_reverse[k],
+                    SIMD_OP(loadu)(data + 2*SIMD_WIDTH), acc2);
+            acc3 = SIMD_OP(fmadd)(kernel_reverse[k],
+                    SIMD_OP(loadu)(data + 3*SIMD_WIDTH), acc3);
+        }
+        SIMD_OP(storeu)(out + i, acc0);
+        SIMD_OP(storeu)(out + i + SIMD_WIDTH, acc1);
+        SIMD_OP(storeu)(out + i + 2*SIMD_WIDTH, acc2);
+        SIMD_OP(storeu)(out + i + 3*SIMD_WIDTH, acc3);
+    }
+
+    for(; i<=out_length - SIMD_WIDTH; i+=SIMD_WIDTH){
+
+        acc0 = SIMD_OP(zero)();
+
+        for(int k=0; k<kernel_length; k++){
+            acc0 = SIMD_OP(fmadd)(kernel_reverse[k],
+                    SIMD_OP(loadu)(in + i + k), acc0);
+        }
+        SIMD_OP(storeu)(out + i, acc0);
+    }
+
+    for(; i<out_length; i++){
+
+        float sum = 0.0;
+        for(int k=0; k<kernel_length; k++){
+            sum += in[i+k] * kernel[kernel_length - k - 1];
+        }
+        out[i] = sum;
+    }
+
+    return 0;
+}
+
+/* The generic kernel specialised for the common short kernel lengths
+ * (and for KERNEL_LENGTH, which the hand tuned kernels are fixed to).
+ * With the length a constant, the compiler fully unrolls the kernel
+ * loop and keeps the reversed kernel in registers.
+ * */
+#define _SIMD_SPECIALISE(BODY, LENGTH, ...) \
+    case LENGTH: return BODY(__VA_ARGS__, LENGTH);
+
+#define _SIMD_SPECIALISE_LENGTHS(BODY, kernel_length, ...) \
+    switch(kernel_length){ \
+        _SIMD_SPECIALISE(BODY, 3, __VA_ARGS__) \
+        _SIMD_SPECIALISE(BODY, 5, __VA_ARGS__) \
+        _SIMD_SPECIALISE(BODY, 7, __VA_ARGS__) \
+        _SIMD_SPECIALISE(BODY, 9, __VA_ARGS__) \
+        _SIMD_SPECIALISE(BODY, 16, __VA_ARGS__) \
+        default: return BODY(__VA_ARGS__, kernel_length); \
+    }
+
+int SIMD_FUNC(generic)(float* in, float* out, int length,
+        float* kernel, int kernel_length)
+{
+    _SIMD_SPECIALISE_LENGTHS(SIMD_FUNC(generic_body), kernel_length,
+            in, out, length, kernel)
+}
+
+/* The ways the strategy kernels below can load their data. */
+#ifndef _CONVOLVE_TEMPLATE_STRATEGY_LOADS
+#define _CONVOLVE_TEMPLATE_STRATEGY_LOADS
+
+#define _STRATEGY_LOADU 0 // unaligned loads throughout
+#define _STRATEGY_LOAD 1 // aligned loads throughout
+#define _STRATEGY_LOAD_PARTIAL 2 // aligned where the offset allows it
+#define _STRATEGY_LOAD_HALVES 3 // two aligned loads of half a vector
+
+#endif
+
+static inline __attribute__ ((always_inline))
+SIMD_T SIMD_FUNC(strategy_load)(float* data, int offset, int load)
+{
+    switch (load){
+        case _STRATEGY_LOAD:
+            return SIMD_OP(load)(data);
+        case _STRATEGY_LOAD_PARTIAL:
+            return (offset % SIMD_WIDTH) ? 
+                SIMD_OP(loadu)(data) : SIMD_OP(load)(data);
+        case _STRATEGY_LOAD_HALVES:
+            return SIMD_OP(load_halves)(data);
+        default:
+            return SIMD_OP(loadu)(data);
+    }
+}
+
+/* The tuning steps of the hand tuned kernels in convolve.c, written
+ * once. Each of those is a one line wrapper that picks its steps with
+ * constant arguments, so the compiler builds a separate copy of this
+ * for each one with the choices folded away:
+ *
+ * n_acc       the number of accumulators (up to 4), each SIMD_WIDTH
+ *             output samples wide
+ * tap_unroll  how far the loop over the kernel is unrolled
+ * copies      0 to load from ``in'' itself, otherwise the number of
+ *             copies of ``in'' to make, each shifted one sample from the
+ *             one before, so that tap k loads from copy k % copies at an
+ *             offset that is a multiple of copies (this replaces
+ *             tap_unroll)
+ * load        how each load is made, one of the _STRATEGY_LOAD defines
+ * fused       1 to accumulate with fmadd, 0 with a multiply and an add
+ * local       1 to write the output to a local array and copy it out
+ *
+ * Unlike the generic kernels, these keep the restrictions of the
+ * kernels they were written as: the output is computed n_acc*SIMD_WIDTH
+ * samples at a time up to length-kernel_length, whose output is done
+ * as a special case, so length-kernel_length must be a multiple of
+ * n_acc*SIMD_WIDTH and kernel_length a multiple of the unroll (or
+ * copies). Aligned loads from the copies also need length to be a
+ * multiple of SIMD_WIDTH.
+ * */
+static inline __attribute__ ((always_inline))
+int SIMD_FUNC(strategy)(float* in, float* out, int length,
+        float* kernel, int kernel_length, int n_acc, int tap_unroll,
+        int copies, int load, int fused, int local)
+{
+    float shifted[copies ? copies : 1][copies ? length : 1]
+        __attribute__ ((aligned (sizeof(SIMD_T))));
+    float local_out[local ? length - kernel_length + 1 : 1]
+        __attribute__ ((aligned (sizeof(SIMD_T))));
+
+    SIMD_T kernel_reverse[kernel_length];
+    SIMD_T data_block;
+    SIMD_T acc[4];
+
+    float* target = local ? local_out : out;
+    int step = copies ? copies : tap_unroll;
+
+    // Reverse the kernel and repeat each value across a vector
+    for(int i=0; i<kernel_length; i++){
+        kernel_reverse[i] = SIMD_OP(set1)(kernel[kernel_length - i - 1]);
+    }
+
+    /* Create the shifted copies
+     * Each one is offset by one sample from the one before
+     */
+    for(int l=0; l<copies; l++){
+        memcpy(shifted[l], in + l, (length - l)*sizeof(float));
+    }
+
+    for(int i=0; i<length-kernel_length; i+=n_acc*SIMD_WIDTH){
+
+        for(int a=0; a<n_acc; a++){
+            acc[a] = SIMD_OP(zero)();
+        }
+
+        for(int k=0; k<kernel_length; k+=step){
+
+            for(int l=0; l<step; l++){
+
+                float* data = copies ? shifted[l] + i + k : in + i + k + l;
+
+                for(int a=0; a<n_acc; a++){
+
+                    data_block = SIMD_FUNC(strategy_load)(
+                            data + a*SIMD_WIDTH, k + a*SIMD_WIDTH, load);
+
+                    if (fused){
+                        acc[a] = SIMD_OP(fmadd)(kernel_reverse[k+l],
+                                data_block, acc[a]);
+                    } else {
+                        acc[a] = SIMD_OP(add)(acc[a], SIMD_OP(mul)(
+                                    kernel_reverse[k+l], data_block));
+                    }
+                }
+            }
+        }
+
+        for(int a=0; a<n_acc; a++){
+            SIMD_OP(storeu)(target + i + a*SIMD_WIDTH, acc[a]);
+        }
+    }
+
+    // Need to do the last value as a special case
+    int i = length - kernel_length;
+    target[i] = 0.0;
+    for(int k=0; k<kernel_length; k++){
+        target[i] += in[i+k] * kernel[kernel_length - k - 1];
+    }
+
+    if (local){
+        memcpy(out, local_out, (length - kernel_length + 1)*sizeof(float));
+    }
+
+    return 0;
+}
+
+/* The same convolution, but down the columns of a 2D array rather than
+ * along a 1D one.
+ *
+ * One row of output, ``width'' samples long, is computed from the
+ * kernel_length rows starting at ``in'', which are ``in_pitch'' floats
+ * apart:
+ *     out[c] = sum_k in[k*in_pitch + c] * kernel[kernel_length - k - 1]
+ *
+ * Each lane of the accumulators is a different column, so the kernel
+ * is broadcast and the loads are contiguous along the row; no transpose
+ * is needed. As with the generic kernel, ``out'' can be the first input
+ * row (or anywhere before it) and the result is still correct.
+ * */
+static inline __attribute__ ((always_inline))
+int SIMD_FUNC(columns_body)(float* in, int in_pitch, float* out,
+        int width, float* kernel, int kernel_length)
+{
+    SIMD_T kernel_reverse[kernel_length];
+    SIMD_T acc0, acc1, acc2, acc3;
+
+    for(int i=0; i<kernel_length; i++){
+        kernel_reverse[i] = SIMD_OP(set1)(kernel[kernel_length - i - 1]);
+    }
+
+    int c = 0;
+    for(; c<=width - 4*SIMD_WIDTH; c+=4*SIMD_WIDTH){
+
+        acc0 = SIMD_OP(zero)();
+        acc1 = SIMD_OP(zero)();
+        acc2 = SIMD_OP(zero)();
+        acc3 = SIMD_OP(zero)();
+
+        for(int k=0; k<kernel_length; k++){
+
+            float* data = in + k*in_pitch + c;
+
+            acc0 = SIMD_OP(fmadd)(kernel_reverse[k],
+                    SIMD_OP(loadu)(data), acc0);
+            acc1 = SIMD_OP(fmadd)(kernel_reverse[k],
+                    SIMD_OP(loadu)(data + SIMD_WIDTH), acc1);
+            acc2 = SIMD_OP(fmadd)(kernel_reverse[k],
+                    SIMD_OP(loadu)(data + 2*SIMD_WIDTH), acc2);
+            acc3 = SIMD_OP(fmadd)(kernel_reverse[k],
+                    SIMD_OP(loadu)(data + 3*SIMD_WIDTH), acc3);
+        }
+        SIMD_OP(storeu)(out + c, acc0);
+        SIMD_OP(storeu)(out + c + SIMD_WIDTH, acc1);
+        SIMD_OP(storeu)(out + c + 2*SIMD_WIDTH, acc2);
+        SIMD_OP(storeu)(out + c + 3*SIMD_WIDTH, acc3);
+    }
+
+    for(; c<=width - SIMD_WIDTH; c+=SIMD_WIDTH){
+
+        acc0 = SIMD_OP(zero)();
+
+        for(int k=0; k<kernel_length; k++){
+            acc0 = SIMD_OP(fmadd)(kernel_reverse[k],
+                    SIMD_OP(loadu)(in + k*in_pitch + c), acc0);
+        }
+        SIMD_OP(storeu)(out + c, acc0);
+    }
+
+    for(; c<width; c++){
+
+        float sum = 0.0;
+        for(int k=0; k<kernel_length; k++){
+            sum += in[k*in_pitch + c] * kernel[kernel_length - k - 1];
+        }
+        out[c] = sum;
+    }
+
+    return 0;
+}
+
+int SIMD_FUNC(columns)(float* in, int in_pitch, float* out, int width,
+        float* kernel, int kernel_length)
+{
+    _SIMD_SPECIALISE_LENGTHS(SIMD_FUNC(columns_body), kernel_length,
+            in, in_pitch, out, width, kernel)
+}
+
+/* The generic kernel decimated by 2: only every other output sample is
+ * computed, so
+ *     out[c] = sum_k in[2c+k] * kernel[kernel_length - k - 1]
+ * for the (length-kernel_length)/2+1 values of c.
+ *
+ * ``in'' is first split into its even and odd samples (in ``even'' and
+ * ``odd'', each length/2+1 floats). in[2c+k] is then even[c+k/2] for
+ * even k and odd[c+k/2] for odd k, so every tap is a contiguous load
+ * from one or the other.
+ * */
+int SIMD_FUNC(decimate)(float* in, float* out, int length,
+        float* kernel, int kernel_length, float* even, float* odd)
+{
+    SIMD_T kernel_reverse[kernel_length];
+    SIMD_T acc0, acc1, acc2, acc3;
+
+    int out_length = (length - kernel_length)/2 + 1;
+
+    for(int i=0; i<kernel_length; i++){
+        kernel_reverse[i] = SIMD_OP(set1)(kernel[kernel_length - i - 1]);
+    }
+
+    for(int i=0; i<length/2; i++){
+        even[i] = in[2*i];
+        odd[i] = in[2*i + 1];
+    }
+    if (length % 2){
+        even[length/2] = in[length - 1];
+    }
+
+    int c = 0;
+    for(; c<=out_length - 4*SIMD_WIDTH; c+=4*SIMD_WIDTH){
+
+        acc0 = SIMD_OP(zero)();
+        acc1 = SIMD_OP(zero)();
+        acc2 = SIMD_OP(zero)();
+        acc3 = SIMD_OP(zero)();
+
+        for(int k=0; k<kernel_length; k++){
+
+            float* data = ((k % 2) ? odd : even) + c + k/2;
+
+            acc0 = SIMD_OP(fmadd)(kernel_reverse[k],
+                    SIMD_OP(loadu)(data), acc0);
+            acc1 = SIMD_OP(fmadd)(kernel_reverse[k],
+                    SIMD_OP(loadu)(data + SIMD_WIDTH), acc1);
+            acc2 = SIMD_OP(fmadd)(kernel_reverse[k],
+                    SIMD_OP(loadu)(data + 2*SIMD_WIDTH), acc2);
+            acc3 = SIMD_OP(fmadd)(kernel_reverse[k],
+                    SIMD_OP(loadu)(data + 3*SIMD_WIDTH), acc3);
+        }
+        SIMD_OP(storeu)(out + c, acc0);
+        SIMD_OP(storeu)(out + c + SIMD_WIDTH, acc1);
+        SIMD_OP(storeu)(out + c + 2*SIMD_WIDTH, acc2);
+        SIMD_OP(storeu)(out + c + 3*SIMD_WIDTH, acc3);
+    }
+
+    for(; c<=out_length - SIMD_WIDTH; c+=SIMD_WIDTH){
+
+        acc0 = SIMD_OP(zero)();
+
+        for(int k=0; k<kernel_length; k++){
+            float* data = ((k % 2) ? odd : even) + c + k/2;
+            acc0 = SIMD_OP(fmadd)(kernel_reverse[k],
+                    SIMD_OP(loadu)(data), acc0);
+        }
+        SIMD_OP(storeu)(out + c, acc0);
+    }
+
+    for(; c<out_length; c++){
+
+        float sum = 0.0;
+        for(int k=0; k<kernel_length; k++){
+            sum += in[2*c + k] * kernel[kernel_length - k - 1];
+        }
+        out[c] = sum;
+    }
+
+    return 0;
+}
+
+/* The generic kernel with the taps spread ``dilation'' samples apart:
+ *     out[i] = sum_k in[i + k*dilation] * kernel[kernel_length - k - 1]
+ * for the length-(kernel_length-1)*dilation values of i.
+ *
+ * With ``in'' an interleaved multi-channel row and the dilation the
+ * number of channels, this convolves every channel at once, with
+ * the lanes spread over both pixels and channels.
+ * */
+int SIMD_FUNC(dilated)(float* in, float* out, int length,
+        float* kernel, int kernel_length, int dilation)
+{
+    SIMD_T kernel_reverse[kernel_length];
+    SIMD_T acc0, acc1, acc2, acc3;
+
+    int out_length = length - (kernel_length - 1)*dilation;
+
+    for(int i=0; i<kernel_length; i++){
+        kernel_reverse[i] = SIMD_OP(set1)(kernel[kernel_length - i - 1]);
+    }
+
+    int i = 0;
+    for(; i<=out_length - 4*SIMD_WIDTH; i+=4*SIMD_WIDTH){
+
+        acc0 = SIMD_OP(zero)();
+        acc1 = SIMD_OP(zero)();
+        acc2 = SIMD_OP(zero)();
+        acc3 = SIMD_OP(zero)();
+
+        for(int k=0; k<kernel_length; k++){
+
+            float* data = in + i + k*dilation;
+
+            acc0 = SIMD_OP(fmadd)(kernel_reverse[k],
+                    SIMD_OP(loadu)(data), acc0);
+            acc1 = SIMD_OP(fmadd)(kernel_reverse[k],
+                    SIMD_OP(loadu)(data + SIMD_WIDTH), acc1);
+            acc2 = SIMD_OP(fmadd)(kernel_reverse[k],
+                    SIMD_OP(loadu)(data + 2*SIMD_WIDTH), acc2);
+            acc3 = SIMD_OP(fmadd)(kernel_reverse[k],
+                    SIMD_OP(loadu)(data + 3*SIMD_WIDTH), acc3);
+        }
+        SIMD_OP(storeu)(out + i, acc0);
+        SIMD_OP(storeu)(out + i + SIMD_WIDTH, acc1);
+        SIMD_OP(storeu)(out + i + 2*SIMD_WIDTH, acc2);
+        SIMD_OP(storeu)(out + i + 3*SIMD_WIDTH, acc3);
+    }
+
+    for(; i<=out_length - SIMD_WIDTH; i+=SIMD_WIDTH){
+
+        acc0 = SIMD_OP(zero)();
+
+        for(int k=0; k<kernel_length; k++){
+            acc0 = SIMD_OP(fmadd)(kernel_reverse[k],
+                    SIMD_OP(loadu)(in + i + k*dilation), acc0);
+        }
+        SIMD_OP(storeu)(out + i, acc0);
+    }
+
+    for(; i<out_length; i++){
+
+        float sum = 0.0;
+        for(int k=0; k<kernel_length; k++){
+            sum += in[i + k*dilation] * kernel[kernel_length - k - 1];
+        }
+        out[i] = sum;
+    }
+
+    return 0;
+}
+
+/* Two convolutions of the same input, with ``kernel_a'' into ``out_a''
+ * and with ``kernel_b'' into ``out_b'', for the price of one set of
+ * loads. Both kernels are kernel_length long.
+ * */
+int SIMD_FUNC(generic_pair)(float* in, float* out_a, float* out_b,
+        int length, float* kernel_a, float* kernel_b, int kernel_length)
+{
+    SIMD_T kernel_a_reverse[kernel_length];
+    SIMD_T kernel_b_reverse[kernel_length];
+    SIMD_T data_block0, data_block1;
+    SIMD_T acc_a0, acc_a1, acc_b0, acc_b1;
+
+    int out_length = length - kernel_length + 1;
+
+    for(int i=0; i<kernel_length; i++){
+        kernel_a_reverse[i] = SIMD_OP(set1)(kernel_a[kernel_length - i - 1]);
+        kernel_b_reverse[i] = SIMD_OP(set1)(kernel_b[kernel_length - i - 1]);
+    }
+
+    int i = 0;
+    for(; i<=out_length - 2*SIMD_WIDTH; i+=2*SIMD_WIDTH){
+
+        acc_a0 = SIMD_OP(zero)();
+        acc_a1 = SIMD_OP(zero)();
+        acc_b0 = SIMD_OP(zero)();
+        acc_b1 = SIMD_OP(zero)();
+
+        for(int k=0; k<kernel_length; k++){
+
+            data_block0 = SIMD_OP(loadu)(in + i + k);
+            data_block1 = SIMD_OP(loadu)(in + i + k + SIMD_WIDTH);
+
+            acc_a0 = SIMD_OP(fmadd)(kernel_a_reverse[k], data_block0, acc_a0);
+            acc_a1 = SIMD_OP(fmadd)(kernel_a_reverse[k], data_block1, acc_a1);
+            acc_b0 = SIMD_OP(fmadd)(kernel_b_reverse[k], data_block0, acc_b0);
+            acc_b1 = SIMD_OP(fmadd)(kernel_b_reverse[k], data_block1, acc_b1);
+        }
+        SIMD_OP(storeu)(out_a + i, acc_a0);
+        SIMD_OP(storeu)(out_a + i + SIMD_WIDTH, acc_a1);
+        SIMD_OP(storeu)(out_b + i, acc_b0);
+        SIMD_OP(storeu)(out_b + i + SIMD_WIDTH, acc_b1);
+    }
+
+    for(; i<out_length; i++){
+
+        float sum_a = 0.0;
+        float sum_b = 0.0;
+        for(int k=0; k<kernel_length; k++){
+            sum_a += in[i+k] * kernel_a[kernel_length - k - 1];
+            sum_b += in[i+k] * kernel_b[kernel_length - k - 1];
+        }
+        out_a[i] = sum_a;
+        out_b[i] = sum_b;
+    }
+
+    return 0;
+}
+
+/* Helpers for the correlation searches below, which do not depend on
+ * the instruction set and so are only defined once.
+ * */
+#ifndef _CONVOLVE_TEMPLATE_SEARCH_HELPERS
+#define _CONVOLVE_TEMPLATE_SEARCH_HELPERS
+
+/* Records the lanes set in ``mask'' of the correlations in ``lanes'',
+ * which start at index ``base''.
+ * */
+static inline void _threshold_emit(int mask, float* lanes, int base,
+        int* indices, float* values, int max_matches, int* n_matches)
+{
+    while (mask){
+        int lane = __builtin_ctz(mask);
+        mask &= mask - 1;
+
+        if (*n_matches < max_matches){
+            indices[*n_matches] = base + lane;
+            if (values != NULL){
+                values[*n_matches] = lanes[lane];
+            }
+        }
+        (*n_matches)++;
+    }
+}
+
+/* The top k are kept as a min-heap in ``values'', with the matching
+ * ``indices'' moved alongside, so the smallest kept value is values[0].
+ * */
+static inline void _top_k_sift_down(int* indices, float* values, int n,
+        int i)
+{
+    while (1){
+        int smallest = i;
+        int left = 2*i + 1;
+        int right = left + 1;
+
+        if (left < n && values[left] < values[smallest]) smallest = left;
+        if (right < n && values[right] < values[smallest]) smallest = right;
+        if (smallest == i){
+            return;
+        }
+
+        float value = values[i]; values[i] = values[smallest];
+        values[smallest] = value;
+        int index = indices[i]; indices[i] = indices[smallest];
+        indices[smallest] = index;
+
+        i = smallest;
+    }
+}
+
+static inline void _top_k_offer(int* indices, float* values, int k,
+        int* n_kept, int index, float value)
+{
+    if (*n_kept < k){
+        int i = (*n_kept)++;
+        // Sift up
+        while (i > 0 && values[(i - 1)/2] > value){
+            values[i] = values[(i - 1)/2];
+            indices[i] = indices[(i - 1)/2];
+            i = (i - 1)/2;
+        }
+        values[i] = value;
+        indices[i] = index;
+    } else if (value > values[0]){
+        values[0] = value;
+        indices[0] = index;
+        _top_k_sift_down(indices, values, k, 0);
+    }
+}
+
+static inline void _top_k_emit(int mask, float* lanes, int base,
+        int* indices, float* values, int k, int* n_kept)
+{
+    while (mask){
+        int lane = __builtin_ctz(mask);
+        mask &= mask - 1;
+        _top_k_offer(indices, values, k, n_kept, base + lane, lanes[lane]);
+    }
+}
+
+/* Keeps the first largest of the lanes set in ``mask'', for argmax
+ * pooling.
+ * */
+static inline void _argmax_emit(int mask, float* lanes, int base,
+        float* best, int* best_index)
+{
+    while (mask){
+        int lane = __builtin_ctz(mask);
+        mask &= mask - 1;
+
+        if (lanes[lane] > *best){
+            *best = lanes[lane];
+            *best_index = base + lane;
+        }
+    }
+}
+
+/* Pools narrower than a vector are reduced from a tile of this many
+ * convolution outputs, which stays in L1.
+ * */
+#define _POOL_TILE_LENGTH 256
+
+#endif
+
+/* A sliding correlation of ``pattern'' along ``in'',
+ *     c[i] = sum_k in[i+k] * pattern[k]
+ * for the length-pattern_length+1 values of i (the convolution with the
+ * reversed pattern), that only reports where c[i] > threshold. The
+ * correlations are never stored: each vector of accumulators is compared
+ * with the threshold and the comparison packed to a bitmask, and only
+ * the set bits are unpacked, lowest first, into ``indices'' and, if it
+ * is not NULL, ``values''.
+ *
+ * At most max_matches are written, in order of index. The number of
+ * matches is returned, and may be more than max_matches.
+ * */
+int SIMD_FUNC(correlate_threshold)(float* in, int length, float* pattern,
+        int pattern_length, float threshold, int* indices, float* values,
+        int max_matches)
+{
+    SIMD_T pattern_v[pattern_length];
+    SIMD_T acc0, acc1, acc2, acc3;
+    SIMD_T threshold_v = SIMD_OP(set1)(threshold);
+    float lanes[SIMD_WIDTH];
+
+    int out_length = length - pattern_length + 1;
+    int n_matches = 0;
+
+    for(int i=0; i<pattern_length; i++){
+        pattern_v[i] = SIMD_OP(set1)(pattern[i]);
+    }
+
+    int i = 0;
+    for(; i<=out_length - 4*SIMD_WIDTH; i+=4*SIMD_WIDTH){
+
+        acc0 = SIMD_OP(zero)();
+        acc1 = SIMD_OP(zero)();
+        acc2 = SIMD_OP(zero)();
+        acc3 = SIMD_OP(zero)();
+
+        for(int k=0; k<pattern_length; k++){
+
+            float* data = in + i + k;
+
+            acc0 = SIMD_OP(fmadd)(pattern_v[k],
+                    SIMD_OP(loadu)(data), acc0);
+            acc1 = SIMD_OP(fmadd)(pattern_v[k],
+                    SIMD_OP(loadu)(data + SIMD_WIDTH), acc1);
+            acc2 = SIMD_OP(fmadd)(pattern_v[k],
+                    SIMD_OP(loadu)(data + 2*SIMD_WIDTH), acc2);
+            acc3 = SIMD_OP(fmadd)(pattern_v[k],
+                    SIMD_OP(loadu)(data + 3*SIMD_WIDTH), acc3);
+        }
+
+        int mask0 = SIMD_OP(gt_mask)(acc0, threshold_v);
+        int mask1 = SIMD_OP(gt_mask)(acc1, threshold_v);
+        int mask2 = SIMD_OP(gt_mask)(acc2, threshold_v);
+        int mask3 = SIMD_OP(gt_mask)(acc3, threshold_v);
+
+        // Matches are rare, so this is almost always skipped
+        if (mask0 | mask1 | mask2 | mask3){
+            SIMD_OP(storeu)(lanes, acc0);
+            _threshold_emit(mask0, lanes, i, indices, values,
+                    max_matches, &n_matches);
+            SIMD_OP(storeu)(lanes, acc1);
+            _threshold_emit(mask1, lanes, i + SIMD_WIDTH, indices, values,
+                    max_matches, &n_matches);
+            SIMD_OP(storeu)(lanes, acc2);
+            _threshold_emit(mask2, lanes, i + 2*SIMD_WIDTH, indices,
+                    values, max_matches, &n_matches);
+            SIMD_OP(storeu)(lanes, acc3);
+            _threshold_emit(mask3, lanes, i + 3*SIMD_WIDTH, indices,
+                    values, max_matches, &n_matches);
+        }
+    }
+
+    for(; i<out_length; i++){
+
+        float sum = 0.0;
+        for(int k=0; k<pattern_length; k++){
+            sum += in[i+k] * pattern[k];
+        }
+        if (sum > threshold){
+            _threshold_emit(1, &sum, i, indices, values, max_matches,
+                    &n_matches);
+        }
+    }
+
+    return n_matches;
+}
+
+/* The same sliding correlation, keeping the k largest values rather than
+ * those over a threshold. The accumulators are compared against the
+ * smallest value kept so far, so once the heap has filled only the few
+ * correlations that would enter it are unpacked.
+ *
+ * The number kept, which is k unless there are fewer correlations, is
+ * returned, and ``indices'' and ``values'' hold them largest first.
+ * */
+int SIMD_FUNC(correlate_top_k)(float* in, int length, float* pattern,
+        int pattern_length, int k, int* indices, float* values)
+{
+    SIMD_T pattern_v[pattern_length];
+    SIMD_T acc[4];
+    float lanes[SIMD_WIDTH];
+
+    int out_length = length - pattern_length + 1;
+    int n_kept = 0;
+    int all_lanes = (1 << SIMD_WIDTH) - 1;
+
+    if (k <= 0){
+        return 0;
+    }
+
+    for(int i=0; i<pattern_length; i++){
+        pattern_v[i] = SIMD_OP(set1)(pattern[i]);
+    }
+
+    int i = 0;
+    for(; i<=out_length - 4*SIMD_WIDTH; i+=4*SIMD_WIDTH){
+
+        for(int a=0; a<4; a++){
+            acc[a] = SIMD_OP(zero)();
+        }
+
+        for(int j=0; j<pattern_length; j++){
+
+            float* data = in + i + j;
+
+            for(int a=0; a<4; a++){
+                acc[a] = SIMD_OP(fmadd)(pattern_v[j],
+                        SIMD_OP(loadu)(data + a*SIMD_WIDTH), acc[a]);
+            }
+        }
+
+        for(int a=0; a<4; a++){
+            // Until the heap is full, everything goes in
+            int mask = n_kept < k ? all_lanes :
+                SIMD_OP(gt_mask)(acc[a], SIMD_OP(set1)(values[0]));
+
+            if (mask){
+                SIMD_OP(storeu)(lanes, acc[a]);
+                _top_k_emit(mask, lanes, i + a*SIMD_WIDTH, indices, values,
+                        k, &n_kept);
+            }
+        }
+    }
+
+    for(; i<out_length; i++){
+
+        float sum = 0.0;
+        for(int j=0; j<pattern_length; j++){
+            sum += in[i+j] * pattern[j];
+        }
+        _top_k_offer(indices, values, k, &n_kept, i, sum);
+    }
+
+    // Heap sort, which leaves a min-heap largest first
+    for(int n=n_kept-1; n>0; n--){
+        float value = values[0]; values[0] = values[n]; values[n] = value;
+        int index = indices[0]; indices[0] = indices[n]; indices[n] = index;
+        _top_k_sift_down(indices, values, n, 0);
+    }
+
+    return n_kept;
+}
+
+/* One vector of the convolution, at the SIMD_WIDTH outputs whose inputs
+ * start at ``data''.
+ * */
+static inline __attribute__ ((always_inline))
+SIMD_T SIMD_FUNC(pool_vector)(float* data, SIMD_T* kernel_reverse,
+        int kernel_length)
+{
+    SIMD_T acc = SIMD_OP(zero)();
+    for(int k=0; k<kernel_length; k++){
+        acc = SIMD_OP(fmadd)(kernel_reverse[k], SIMD_OP(loadu)(data + k),
+                acc);
+    }
+    return acc;
+}
+
+/* The generic convolution followed by pooling over windows of ``pool''
+ * outputs, without storing the convolution:
+ *     out[w] = reduce(conv[w*pool], ..., conv[w*pool + pool - 1])
+ * for the (length-kernel_length+1)/pool whole windows; a partial window
+ * at the end is dropped. ``mode'' is one of
+ *     CONVOLVE_POOL_MAX     the largest output of each window,
+ *     CONVOLVE_POOL_MEAN    the mean of each window,
+ *     CONVOLVE_POOL_ARGMAX  the largest, as for max, with the index of
+ *                           the first output to reach it (counted from
+ *                           the start of the convolution) in ``argmax''.
+ * ``argmax'' is only written for CONVOLVE_POOL_ARGMAX, and may be NULL
+ * otherwise.
+ *
+ * Windows at least a vector wide are reduced in the accumulators, with
+ * max or add for the value and the gt_mask of each accumulator against
+ * the best so far for the index, so only one float per window is ever
+ * stored. Narrower windows would waste most of each vector, so those
+ * are convolved a tile at a time into L1 and reduced from there.
+ *
+ * Returns 0, or -1 if ``pool'' is less than 1.
+ * */
+int SIMD_FUNC(generic_pool)(float* in, float* out, int* argmax, int length,
+        float* kernel, int kernel_length, int pool, int mode)
+{
+    SIMD_T kernel_reverse[kernel_length];
+    SIMD_T acc[4];
+    float lanes[SIMD_WIDTH];
+
+    if (pool < 1){
+        return -1;
+    }
+
+    int out_length = length - kernel_length + 1;
+    int n_windows = out_length / pool;
+
+    if (pool < SIMD_WIDTH){
+        float tile[_POOL_TILE_LENGTH];
+        int tile_windows = _POOL_TILE_LENGTH / pool;
+
+        for(int w=0; w<n_windows; w+=tile_windows){
+            int n = n_windows - w < tile_windows ? n_windows - w :
+                tile_windows;
+
+            SIMD_FUNC(generic_body)(in + w*pool, tile,
+                    n*pool + kernel_length - 1, kernel, kernel_length);
+
+            for(int j=0; j<n; j++){
+                float* window = tile + j*pool;
+                float best = window[0];
+                float sum = window[0];
+                int best_index = 0;
+
+                for(int i=1; i<pool; i++){
+                    sum += window[i];
+                    if (window[i] > best){
+                        best = window[i];
+                        best_index = i;
+                    }
+                }
+
+                out[w + j] = mode == CONVOLVE_POOL_MEAN ? sum / pool : best;
+                if (mode == CONVOLVE_POOL_ARGMAX){
+                    argmax[w + j] = (w + j)*pool + best_index;
+                }
+            }
+        }
+        return 0;
+    }
+
+    for(int i=0; i<kernel_length; i++){
+        kernel_reverse[i] = SIMD_OP(set1)(kernel[kernel_length - i - 1]);
+    }
+
+    for(int w=0; w<n_windows; w++){
+
+        float* window = in + w*pool;
+        int start = w*pool;
+
+        SIMD_T pooled = SIMD_OP(set1)(
+                mode == CONVOLVE_POOL_MEAN ? 0.0f : -INFINITY);
+        float best = -INFINITY;
+        int best_index = start;
+
+        int i = 0;
+        for(; i<=pool - 4*SIMD_WIDTH; i+=4*SIMD_WIDTH){
+
+            for(int a=0; a<4; a++){
+                acc[a] = SIMD_OP(zero)();
+            }
+
+            for(int k=0; k<kernel_length; k++){
+
+                float* data = window + i + k;
+
+                for(int a=0; a<4; a++){
+                    acc[a] = SIMD_OP(fmadd)(kernel_reverse[k],
+                            SIMD_OP(loadu)(data + a*SIMD_WIDTH), acc[a]);
+                }
+            }
+
+            if (mode == CONVOLVE_POOL_MEAN){
+                pooled = SIMD_OP(add)(pooled, SIMD_OP(add)(
+                        SIMD_OP(add)(acc[0], acc[1]),
+                        SIMD_OP(add)(acc[2], acc[3])));
+            } else if (mode == CONVOLVE_POOL_MAX){
+                pooled = SIMD_OP(max)(pooled, SIMD_OP(max)(
+                        SIMD_OP(max)(acc[0], acc[1]),
+                        SIMD_OP(max)(acc[2], acc[3])));
+            } else {
+                for(int a=0; a<4; a++){
+                    int mask = SIMD_OP(gt_mask)(acc[a],
+                            SIMD_OP(set1)(best));
+                    if (mask){
+                        SIMD_OP(storeu)(lanes, acc[a]);
+                        _argmax_emit(mask, lanes, start + i + a*SIMD_WIDTH,
+                                &best, &best_index);
+                    }
+                }
+            }
+        }
+
+        for(; i<=pool - SIMD_WIDTH; i+=SIMD_WIDTH){
+
+            acc[0] = SIMD_FUNC(pool_vector)(window + i, kernel_reverse,
+                    kernel_length);
+
+            if (mode == CONVOLVE_POOL_MEAN){
+                pooled = SIMD_OP(add)(pooled, acc[0]);
+            } else if (mode == CONVOLVE_POOL_MAX){
+                pooled = SIMD_OP(max)(pooled, acc[0]);
+            } else {
+                int mask = SIMD_OP(gt_mask)(acc[0], SIMD_OP(set1)(best));
+                if (mask){
+                    SIMD_OP(storeu)(lanes, acc[0]);
+                    _argmax_emit(mask, lanes, start + i, &best,
+                            &best_index);
+                }
+            }
+        }
+
+        float sum = 0.0;
+        if (mode == CONVOLVE_POOL_MEAN){
+            sum = SIMD_OP(hsum)(pooled);
+        } else if (mode == CONVOLVE_POOL_MAX){
+            best = SIMD_OP(hmax)(pooled);
+        }
+
+        for(; i<pool; i++){
+
+            float value = 0.0;
+            for(int k=0; k<kernel_length; k++){
+                value += window[i+k] * kernel[kernel_length - k - 1];
+            }
+
+            sum += value;
+            if (value > best){
+                best = value;
+                best_index = start + i;
+            }
+        }
+
+        out[w] = mode == CONVOLVE_POOL_MEAN ? sum / pool : best;
+        if (mode == CONVOLVE_POOL_ARGMAX){
+            argmax[w] = best_index;
+        }
+    }
+
+    return 0;
+}
+
+#undef _SIMD_SPECIALISE
+#undef _SIMD_SPECIALISE_LENGTHS
@@ -0,0 +1,373 @@
+/* Copyright (C) 2013 Henry Gomersall <heng@cantab.net> 
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the organization nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY  THE AUTHOR ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+/* posix_memalign */
+#define _POSIX_C_SOURCE 200112L
+
+#include "fft.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef AVX
+#include <immintrin.h>
+#endif
+
+#define FFT_ALIGNMENT 64
+
+#define FFT_PI 3.14159265358979323846
+
+/* An in-tree FFT, so that the FFT convolutions need no other library.
+ *
+ * The complex transform is an iterative decimation in time FFT on
+ * interleaved data: a bit reversal permutation (which is also the copy
+ * for the out of place transform), then the first two radix-2 stages
+ * fused as radix-4 butterflies, whose twiddles are only 1 and -i, then
+ * the remaining radix-2 stages. Those run four complex points at a time
+ * with AVX, and the complex multiply is a moveldup/movehdup and a single
+ * fmaddsub.
+ *
+ * Each plan precomputes its bit reversal table and a contiguous table of
+ * twiddles per stage: the stage of half length m reads its m twiddles
+ * from offset m, so the inner loop only walks forwards through memory.
+ * There are separate forward and inverse tables.
+ *
+ * Lengths are powers of two. Neither transform is normalised, so an
+ * inverse after a forward scales the data by the length, as with FFTW.
+ * Every transform can be done in place by passing the same buffer as
+ * ``in'' and ``out''.
+ * */
+
+static void* _aligned_malloc(size_t bytes)
+{
+    void* memory;
+    if (posix_memalign(&memory, FFT_ALIGNMENT, bytes) != 0){
+        return NULL;
+    }
+    return memory;
+}
+
+int fft_plan_init(fft_plan* plan, int length)
+{
+    if (length < 1 || (length & (length - 1)) != 0){
+        return -1;
+    }
+
+    plan->length = length;
+    plan->bit_reverse = malloc(length*sizeof(int));
+    plan->forward_twiddles = _aligned_malloc(2*length*sizeof(float));
+    plan->inverse_twiddles = _aligned_malloc(2*length*sizeof(float));
+
+    if (plan->bit_reverse == NULL || plan->forward_twiddles == NULL
+            || plan->inverse_twiddles == NULL){
+        fft_plan_destroy(plan);
+        return -1;
+    }
+
+    int bits = 0;
+    while ((1 << bits) < length){
+        bits++;
+    }
+
+    for(int i=0; i<length; i++){
+        int reversed = 0;
+        for(int b=0; b<bits; b++){
+            reversed |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        plan->bit_reverse[i] = reversed;
+    }
+
+    for(int m=1; m<length; m*=2){
+        for(int j=0; j<m; j++){
+            double angle = -FFT_PI * j / m;
+            plan->forward_twiddles[2*(m + j)] = cos(angle);
+            plan->forward_twiddles[2*(m + j) + 1] = sin(angle);
+            plan->inverse_twiddles[2*(m + j)] = cos(angle);
+            plan->inverse_twiddles[2*(m + j) + 1] = -sin(angle);
+        }
+    }
+
+    return 0;
+}
+
+int fft_plan_destroy(fft_plan* plan)
+{
+    free(plan->bit_reverse);
+    free(plan->forward_twiddles);
+    free(plan->inverse_twiddles);
+
+    plan->bit_reverse = NULL;
+    plan->forward_twiddles = NULL;
+    plan->inverse_twiddles = NULL;
+
+    return 0;
+}
+
+static void _bit_reverse(fft_plan* plan, float* in, float* out)
+{
+    int* bit_reverse = plan->bit_reverse;
+
+    if (in != out){
+        for(int i=0; i<plan->length; i++){
+            int r = bit_reverse[i];
+            out[2*r] = in[2*i];
+            out[2*r + 1] = in[2*i + 1];
+        }
+        return;
+    }
+
+    for(int i=0; i<plan->length; i++){
+        int r = bit_reverse[i];
+        if (i < r){
+            float re = out[2*i];
+            float im = out[2*i + 1];
+            out[2*i] = out[2*r];
+            out[2*i + 1] = out[2*r + 1];
+            out[2*r] = re;
+            out[2*r + 1] = im;
+        }
+    }
+}
+
+/* The first two stages on groups of four points. ``sign'' is -1 for the
+ * forward transform, where the odd twiddle is -i, and 1 for the inverse.
+ * */
+static void _radix4_stage(float* data, int length, float sign)
+{
+    for(int g=0; g<length; g+=4){
+        float* x = data + 2*g;
+
+        float a0r = x[0] + x[2], a0i = x[1] + x[3];
+        float a1r = x[0] - x[2], a1i = x[1] - x[3];
+        float a2r = x[4] + x[6], a2i = x[5] + x[7];
+        float a3r = x[4] - x[6], a3i = x[5] - x[7];
+
+        // a3 * (sign * i)
+        float tr = -sign * a3i, ti = sign * a3r;
+
+        x[0] = a0r + a2r;
+        x[1] = a0i + a2i;
+        x[4] = a0r - a2r;
+        x[5] = a0i - a2i;
+        x[2] = a1r + tr;
+        x[3] = a1i + ti;
+        x[6] = a1r - tr;
+        x[7] = a1i - ti;
+    }
+}
+
+static void _radix2_stage(float* data, int length, int m,
+        float* twiddles)
+{
+    float* w = twiddles + 2*m;
+
+    for(int g=0; g<length; g+=2*m){
+        float* x0 = data + 2*g;
+        float* x1 = x0 + 2*m;
+
+        int j = 0;
+#ifdef AVX
+        for(; j+4<=m; j+=4){
+            __m256 a = _mm256_loadu_ps(x0 + 2*j);
+            __m256 b = _mm256_loadu_ps(x1 + 2*j);
+            __m256 tw = _mm256_load_ps(w + 2*j);
+
+            __m256 tw_re = _mm256_moveldup_ps(tw);
+            __m256 tw_im = _mm256_movehdup_ps(tw);
+            __m256 b_swapped = _mm256_permute_ps(b, 0xB1);
+#ifdef __FMA__
+            __m256 t = _mm256_fmaddsub_ps(b, tw_re,
+                    _mm256_mul_ps(b_swapped, tw_im));
+#else
+            __m256 t = _mm256_addsub_ps(_mm256_mul_ps(b, tw_re),
+                    _mm256_mul_ps(b_swapped, tw_im));
+#endif
+
+            _mm256_storeu_ps(x1 + 2*j, _mm256_sub_ps(a, t));
+            _mm256_storeu_ps(x0 + 2*j, _mm256_add_ps(a, t));
+        }
+#endif
+        for(; j<m; j++){
+            float br = x1[2*j], bi = x1[2*j + 1];
+            float wr = w[2*j], wi = w[2*j + 1];
+
+            float tr = br*wr - bi*wi;
+            float ti = br*wi + bi*wr;
+
+            x1[2*j] = x0[2*j] - tr;
+            x1[2*j + 1] = x0[2*j + 1] - ti;
+            x0[2*j] += tr;
+            x0[2*j + 1] += ti;
+        }
+    }
+}
+
+static int _transform(fft_plan* plan, float* in, float* out,
+        float* twiddles, float sign)
+{
+    int length = plan->length;
+
+    _bit_reverse(plan, in, out);
+
+    int m = 1;
+    if (length >= 4){
+        _radix4_stage(out, length, sign);
+        m = 4;
+    }
+
+    for(; m<length; m*=2){
+        _radix2_stage(out, length, m, twiddles);
+    }
+
+    return 0;
+}
+
+int fft_forward(fft_plan* plan, float* in, float* out)
+{
+    return _transform(plan, in, out, plan->forward_twiddles, -1.0f);
+}
+
+int fft_inverse(fft_plan* plan, float* in, float* out)
+{
+    return _transform(plan, in, out, plan->inverse_twiddles, 1.0f);
+}
+
+/* The real transform of length n packs the even and odd samples as the
+ * real and imaginary parts of n/2 complex points, does a complex FFT of
+ * those, and then separates the two spectra with the twiddles
+ * W^k = exp(-2 pi i k / n) for k up to n/4.
+ * */
+int fft_real_plan_init(fft_real_plan* plan, int length)
+{
+    if (length < 2 || (length & (length - 1)) != 0){
+        return -1;
+    }
+
+    plan->length = length;
+    plan->twiddles = malloc(2*(length/4 + 1)*sizeof(float));
+
+    if (plan->twiddles == NULL){
+        return -1;
+    }
+
+    if (fft_plan_init(&plan->half, length/2) != 0){
+        free(plan->twiddles);
+        return -1;
+    }
+
+    for(int k=0; k<=length/4; k++){
+        double angle = -2.0 * FFT_PI * k / length;
+        plan->twiddles[2*k] = cos(angle);
+        plan->twiddles[2*k + 1] = sin(angle);
+    }
+
+    return 0;
+}
+
+int fft_real_plan_destroy(fft_real_plan* plan)
+{
+    fft_plan_destroy(&plan->half);
+    free(plan->twiddles);
+    plan->twiddles = NULL;
+
+    return 0;
+}
+
+/* ``in'' is length floats and ``out'' length+2 floats. */
+int fft_real_forward(fft_real_plan* plan, float* in, float* out)
+{
+    int half = plan->length / 2;
+    float* w = plan->twiddles;
+
+    fft_forward(&plan->half, in, out);
+
+    // Z[0] holds the sums of the even and odd samples
+    float z0r = out[0], z0i = out[1];
+    out[0] = z0r + z0i;
+    out[1] = 0.0f;
+    out[2*half] = z0r - z0i;
+    out[2*half + 1] = 0.0f;
+
+    /* X[k] = E + W^k O, and X[half-k] = conj(E) - W^-k conj(O) with
+     * E = (Z[k] + conj(Z[half-k]))/2 and O = -i(Z[k] - conj(Z[half-k]))/2
+     * */
+    for(int k=1; k<=half/2; k++){
+        float ar = out[2*k], ai = out[2*k + 1];
+        float br = out[2*(half - k)], bi = out[2*(half - k) + 1];
+
+        float er = 0.5f * (ar + br), ei = 0.5f * (ai - bi);
+        float or_ = 0.5f * (ai + bi), oi = -0.5f * (ar - br);
+
+        float wr = w[2*k], wi = w[2*k + 1];
+        float tr = or_*wr - oi*wi;
+        float ti = or_*wi + oi*wr;
+
+        out[2*k] = er + tr;
+        out[2*k + 1] = ei + ti;
+        out[2*(half - k)] = er - tr;
+        out[2*(half - k) + 1] = -(ei - ti);
+    }
+
+    return 0;
+}
+
+/* ``in'' is length+2 floats and ``out'' length floats. */
+int fft_real_inverse(fft_real_plan* plan, float* in, float* out)
+{
+    int half = plan->length / 2;
+    float* w = plan->twiddles;
+
+    float x0 = in[0], xh = in[2*half];
+    out[0] = x0 + xh;
+    out[1] = x0 - xh;
+
+    /* Undoes the forward separation, without the halving so that the
+     * result is scaled by length like the complex inverse:
+     * E = X[k] + conj(X[half-k]), O = W^-k (X[k] - conj(X[half-k])) and
+     * Z[k] = E + iO.
+     * */
+    for(int k=1; k<=half/2; k++){
+        float ar = in[2*k], ai = in[2*k + 1];
+        float br = in[2*(half - k)], bi = in[2*(half - k) + 1];
+
+        float er = ar + br, ei = ai - bi;
+        float dr = ar - br, di = ai + bi;
+
+        float wr = w[2*k], wi = -w[2*k + 1];
+        float or_ = dr*wr - di*wi;
+        float oi = dr*wi + di*wr;
+
+        out[2*k] = er - oi;
+        out[2*k + 1] = ei + or_;
+        // Z[half-k] = conj(E) + i conj(O)
+        out[2*(half - k)] = er + oi;
+        out[2*(half - k) + 1] = -ei + or_;
+    }
+
+    return fft_inverse(&plan->half, out, out);
+}
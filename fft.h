@@ -0,0 +1,63 @@
+/* Copyright (C) 2013 Henry Gomersall <heng@cantab.net> 
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the organization nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY  THE AUTHOR ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+#ifndef _FFT_H
+#define _FFT_H
+
+/* A complex FFT plan (see fft.c). Complex data is interleaved, so a
+ * transform of ``length'' points is 2*length floats.
+ * */
+typedef struct {
+    int length;
+    int* bit_reverse;
+    float* forward_twiddles;
+    float* inverse_twiddles;
+} fft_plan;
+
+/* A real FFT plan, built on a complex plan of half the length. The
+ * spectrum of ``length'' real points is the length/2+1 complex points
+ * from DC to Nyquist, so it is length+2 floats.
+ * */
+typedef struct {
+    int length;
+    fft_plan half;
+    float* twiddles;
+} fft_real_plan;
+
+int fft_plan_init(fft_plan* plan, int length);
+int fft_plan_destroy(fft_plan* plan);
+
+int fft_forward(fft_plan* plan, float* in, float* out);
+int fft_inverse(fft_plan* plan, float* in, float* out);
+
+int fft_real_plan_init(fft_real_plan* plan, int length);
+int fft_real_plan_destroy(fft_real_plan* plan);
+
+int fft_real_forward(fft_real_plan* plan, float* in, float* out);
+int fft_real_inverse(fft_real_plan* plan, float* in, float* out);
+
+#endif /* Header guard */
@@ -0,0 +1,380 @@
+/* Copyright (C) 2013 Henry Gomersall <heng@cantab.net> 
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the organization nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY  THE AUTHOR ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+#include "fft_convolve.h"
+#include "fft.h"
+#include "convolve_2d.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* The largest tile the overlap-save convolution will use. */
+#define FFT_CONVOLVE_MAX_TILE 1024
+
+/* Estimated costs, in the same arbitrary units, of a multiply-add in the
+ * direct convolution and of one point of one radix-2 pass of the FFT,
+ * measured with AVX on a 1024 x 768 image. The FFT overtakes the direct
+ * convolution at a kernel of about 20 x 20.
+ * */
+#define DIRECT_COST_PER_TAP 1.0
+#define FFT_COST_PER_POINT 10.0
+
+/* A 2D FFT convolution by overlap-save.
+ *
+ * The input is cut into overlapping T x T tiles, with T a power of two.
+ * Each tile is transformed with a real FFT along each row, the half
+ * spectra are transposed so that the columns are contiguous, and each
+ * column gets a complex FFT. That is multiplied point by point with the
+ * spectrum of the kernel, zero padded to T x T and transformed the same
+ * way, and the inverse runs the same steps backwards. The circular
+ * convolution is correct except in the first kernel_rows-1 rows and
+ * kernel_cols-1 columns of the tile, so each tile gives
+ * (T-kernel_rows+1) x (T-kernel_cols+1) outputs, and the tiles step by
+ * that much. Only the rows that are kept are inverse transformed.
+ *
+ * The kernel spectrum comes from ``cache'' when one is passed, so that
+ * repeated calls with the same kernel skip its transform. The kernel is
+ * cached with its width in front, so that kernels with the same number
+ * of coefficients but a different shape are different entries.
+ *
+ * The tiles are split over threads with OpenMP when it is available.
+ * Each thread has its own tile buffers; the plans and the kernel spectrum
+ * are only read, so they are shared.
+ * */
+
+typedef struct {
+    int tile_size;
+    fft_real_plan* row_plan;
+    fft_plan* column_plan;
+} _spectrum_context;
+
+/* The number of floats in a tile spectrum, which is held as T/2+1
+ * columns of T complex points.
+ * */
+static int _spectrum_length(int tile_size)
+{
+    return 2 * tile_size * (tile_size/2 + 1);
+}
+
+/* Transforms the first n_rows rows of ``tile'', which is T rows of T+2
+ * floats with the data in the first T of each, into ``spectrum''. Rows
+ * from n_rows on are taken to be zero.
+ * */
+static void _forward_2d(_spectrum_context* context, float* tile,
+        int n_rows, float* spectrum)
+{
+    int tile_size = context->tile_size;
+    int pitch = tile_size + 2;
+    int n_columns = tile_size/2 + 1;
+
+    for(int row=0; row<n_rows; row++){
+        fft_real_forward(context->row_plan, tile + row*pitch,
+                tile + row*pitch);
+    }
+
+    for(int column=0; column<n_columns; column++){
+        float* out_column = spectrum + 2*column*tile_size;
+
+        for(int row=0; row<n_rows; row++){
+            out_column[2*row] = tile[row*pitch + 2*column];
+            out_column[2*row + 1] = tile[row*pitch + 2*column + 1];
+        }
+        memset(out_column + 2*n_rows, 0,
+                2*(tile_size - n_rows)*sizeof(float));
+
+        fft_forward(context->column_plan, out_column, out_column);
+    }
+}
+
+/* The spectrum_cache_transform for a kernel with its width in front. */
+static int _kernel_transform(float* key, int key_length,
+        int transform_length, float* spectrum, void* context)
+{
+    // The transform length is the tile size the context was made for
+    int pitch = transform_length + 2;
+
+    int kernel_cols = (int) key[0];
+    int kernel_rows = (key_length - 1) / kernel_cols;
+    float* kernel = key + 1;
+
+    float* tile = calloc(kernel_rows * pitch, sizeof(float));
+    if (tile == NULL){
+        return -1;
+    }
+
+    for(int row=0; row<kernel_rows; row++){
+        memcpy(tile + row*pitch, kernel + row*kernel_cols,
+                kernel_cols*sizeof(float));
+    }
+
+    _forward_2d(context, tile, kernel_rows, spectrum);
+
+    free(tile);
+
+    return 0;
+}
+
+/* Picks the tile size that needs the least work per output, from the
+ * FFT work of a tile against the number of outputs it gives.
+ * */
+int fft_convolve_2d_tile_size(int cols, int rows, int kernel_cols,
+        int kernel_rows)
+{
+    int kernel_size = kernel_cols > kernel_rows ? kernel_cols : kernel_rows;
+    int image_size = cols > rows ? cols : rows;
+
+    int best = 0;
+    double best_cost = 0.0;
+
+    for(int tile_size=2; tile_size<=FFT_CONVOLVE_MAX_TILE; tile_size*=2){
+        if (tile_size <= kernel_size){
+            continue;
+        }
+
+        int log2_size = 0;
+        while ((1 << log2_size) < tile_size){
+            log2_size++;
+        }
+
+        double outputs = (double) (tile_size - kernel_cols + 1) *
+            (tile_size - kernel_rows + 1);
+        double cost = (double) tile_size * tile_size * log2_size / outputs;
+
+        if (best == 0 || cost < best_cost){
+            best = tile_size;
+            best_cost = cost;
+        }
+
+        // Tiles much bigger than the image are mostly padding
+        if (tile_size >= image_size){
+            break;
+        }
+    }
+
+    return best;
+}
+
+/* Returns 0, or -1 if the tile is too big or memory runs out. */
+int fft_convolve_2d(float* in, float* out, int cols, int rows,
+        float* kernel, int kernel_cols, int kernel_rows,
+        spectrum_cache* cache)
+{
+    int out_cols = cols - kernel_cols + 1;
+    int out_rows = rows - kernel_rows + 1;
+
+    int tile_size = fft_convolve_2d_tile_size(cols, rows, kernel_cols,
+            kernel_rows);
+    if (tile_size == 0){
+        return -1;
+    }
+
+    int pitch = tile_size + 2;
+    int n_columns = tile_size/2 + 1;
+    int step_cols = tile_size - kernel_cols + 1;
+    int step_rows = tile_size - kernel_rows + 1;
+    int spectrum_length = _spectrum_length(tile_size);
+
+    fft_real_plan row_plan;
+    fft_plan column_plan;
+    if (fft_real_plan_init(&row_plan, tile_size) != 0){
+        return -1;
+    }
+    if (fft_plan_init(&column_plan, tile_size) != 0){
+        fft_real_plan_destroy(&row_plan);
+        return -1;
+    }
+
+    _spectrum_context context = {tile_size, &row_plan, &column_plan};
+
+    int key_length = kernel_cols*kernel_rows + 1;
+    float* key = malloc(key_length*sizeof(float));
+    if (key == NULL){
+        fft_real_plan_destroy(&row_plan);
+        fft_plan_destroy(&column_plan);
+        return -1;
+    }
+    key[0] = kernel_cols;
+    memcpy(key + 1, kernel, kernel_cols*kernel_rows*sizeof(float));
+
+    float* kernel_spectrum;
+    float* own_spectrum = NULL;
+    if (cache != NULL){
+        kernel_spectrum = spectrum_cache_get(cache, key, key_length,
+                tile_size, spectrum_length, _kernel_transform, &context);
+    } else {
+        own_spectrum = malloc(spectrum_length*sizeof(float));
+        if (own_spectrum != NULL && _kernel_transform(key, key_length,
+                    tile_size, own_spectrum, &context) != 0){
+            free(own_spectrum);
+            own_spectrum = NULL;
+        }
+        kernel_spectrum = own_spectrum;
+    }
+    free(key);
+
+    if (kernel_spectrum == NULL){
+        fft_real_plan_destroy(&row_plan);
+        fft_plan_destroy(&column_plan);
+        return -1;
+    }
+
+    int failed = 0;
+
+    int tiles_across = (out_cols + step_cols - 1) / step_cols;
+    int tiles_down = (out_rows + step_rows - 1) / step_rows;
+    float scale = 1.0f / ((float) tile_size * tile_size);
+
+    #pragma omp parallel
+    {
+        float* tile = malloc(tile_size*pitch*sizeof(float));
+        float* spectrum = malloc(spectrum_length*sizeof(float));
+
+        if (tile == NULL || spectrum == NULL){
+            #pragma omp atomic write
+            failed = 1;
+        }
+
+        #pragma omp for
+        for(int t=0; t<tiles_across*tiles_down; t++){
+            if (tile == NULL || spectrum == NULL){
+                continue;
+            }
+
+            int tile_row = (t / tiles_across) * step_rows;
+            int tile_col = (t % tiles_across) * step_cols;
+
+            int n_rows = rows - tile_row < tile_size ?
+                rows - tile_row : tile_size;
+            int n_cols = cols - tile_col < tile_size ?
+                cols - tile_col : tile_size;
+
+            for(int row=0; row<n_rows; row++){
+                float* tile_row_data = tile + row*pitch;
+                memcpy(tile_row_data, in + (tile_row + row)*cols + tile_col,
+                        n_cols*sizeof(float));
+                memset(tile_row_data + n_cols, 0,
+                        (tile_size - n_cols)*sizeof(float));
+            }
+
+            _forward_2d(&context, tile, n_rows, spectrum);
+
+            for(int column=0; column<n_columns; column++){
+                float* a = spectrum + 2*column*tile_size;
+                float* b = kernel_spectrum + 2*column*tile_size;
+
+                for(int i=0; i<tile_size; i++){
+                    float re = a[2*i]*b[2*i] - a[2*i + 1]*b[2*i + 1];
+                    float im = a[2*i]*b[2*i + 1] + a[2*i + 1]*b[2*i];
+                    a[2*i] = re;
+                    a[2*i + 1] = im;
+                }
+
+                fft_inverse(&column_plan, a, a);
+
+                for(int row=kernel_rows-1; row<tile_size; row++){
+                    tile[row*pitch + 2*column] = a[2*row];
+                    tile[row*pitch + 2*column + 1] = a[2*row + 1];
+                }
+            }
+
+            int valid_rows = out_rows - tile_row < step_rows ?
+                out_rows - tile_row : step_rows;
+            int valid_cols = out_cols - tile_col < step_cols ?
+                out_cols - tile_col : step_cols;
+
+            for(int row=0; row<valid_rows; row++){
+                float* tile_row_data = tile + (row + kernel_rows - 1)*pitch;
+                float* out_row = out + (tile_row + row)*out_cols + tile_col;
+
+                fft_real_inverse(&row_plan, tile_row_data, tile_row_data);
+
+                for(int i=0; i<valid_cols; i++){
+                    out_row[i] = tile_row_data[i + kernel_cols - 1] * scale;
+                }
+            }
+        }
+
+        free(tile);
+        free(spectrum);
+    }
+
+    free(own_spectrum);
+    fft_real_plan_destroy(&row_plan);
+    fft_plan_destroy(&column_plan);
+
+    return failed ? -1 : 0;
+}
+
+#ifdef SSE3
+/* Picks the cheapest way to convolve with a non-separable kernel. A
+ * kernel of rank 1 is split and goes through the separable convolution,
+ * which needs ``workspace'' of rows*(cols-kernel_cols+1) floats (it is
+ * not used otherwise). Other kernels go direct or by FFT, whichever the
+ * estimated work per output favours: kernel_rows*kernel_cols
+ * multiply-adds direct, against log2(T) passes over the T x T tile for
+ * each of the four transforms (forward and inverse, rows and columns)
+ * for the FFT.
+ * */
+int fft_convolve_2d_planned(float* in, float* out, float* workspace,
+        int cols, int rows, float* kernel, int kernel_cols,
+        int kernel_rows, spectrum_cache* cache)
+{
+    float row_kernel[kernel_cols];
+    float col_kernel[kernel_rows];
+
+    if (convolve_sse_2d_kernel_separate(kernel, kernel_cols, kernel_rows,
+                row_kernel, col_kernel)){
+        return convolve_sse_2d_separable_asymmetric(in, out, workspace,
+                cols, rows, row_kernel, kernel_cols, col_kernel,
+                kernel_rows);
+    }
+
+    int tile_size = fft_convolve_2d_tile_size(cols, rows, kernel_cols,
+            kernel_rows);
+
+    if (tile_size > 0){
+        int log2_size = 0;
+        while ((1 << log2_size) < tile_size){
+            log2_size++;
+        }
+
+        double outputs = (double) (tile_size - kernel_cols + 1) *
+            (tile_size - kernel_rows + 1);
+        double fft_cost = FFT_COST_PER_POINT * 4.0 * log2_size *
+            tile_size * tile_size / outputs;
+        double direct_cost = DIRECT_COST_PER_TAP * kernel_cols * kernel_rows;
+
+        if (fft_cost < direct_cost){
+            return fft_convolve_2d(in, out, cols, rows, kernel, kernel_cols,
+                    kernel_rows, cache);
+        }
+    }
+
+    return convolve_sse_2d_direct(in, out, cols, rows, kernel, kernel_cols,
+            kernel_rows);
+}
+#endif
@@ -0,0 +1,51 @@
+/* Copyright (C) 2013 Henry Gomersall <heng@cantab.net> 
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the organization nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY  THE AUTHOR ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+#ifndef _FFT_CONVOLVE_H
+#define _FFT_CONVOLVE_H
+
+#include "spectrum_cache.h"
+
+/* 2D convolutions by FFT, for large kernels that are not separable
+ * (see fft_convolve.c). ``kernel'' is kernel_rows x kernel_cols, stored a
+ * row at a time, and the output is the valid part, as for the direct
+ * convolution in convolve_2d.h.
+ * */
+int fft_convolve_2d_tile_size(int cols, int rows, int kernel_cols,
+        int kernel_rows);
+
+int fft_convolve_2d(float* in, float* out, int cols, int rows,
+        float* kernel, int kernel_cols, int kernel_rows,
+        spectrum_cache* cache);
+
+#ifdef SSE3
+int fft_convolve_2d_planned(float* in, float* out, float* workspace,
+        int cols, int rows, float* kernel, int kernel_cols,
+        int kernel_rows, spectrum_cache* cache);
+#endif
+
+#endif /* Header guard */
@@ -0,0 +1,387 @@
+/* Copyright (C) 2013 Henry Gomersall <heng@cantab.net> 
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the organization nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY  THE AUTHOR ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+/* Box filters by running sums, and the guided filter built from them
+ * (He, Sun and Tang, "Guided Image Filtering", 2010):
+ *     a = cov(guide, in) / (var(guide) + epsilon)
+ *     b = mean(in) - a mean(guide)
+ *     out = mean(a) guide + mean(b)
+ * where each mean, variance and covariance is over the same box.
+ *
+ * A box is a pass along each row and a running sum down the columns: as
+ * each row arrives its row sums are added to the column sums and those
+ * of the row leaving the box, kept in a ring, are subtracted, so each
+ * output costs the same whatever the box. The row sums are the generic
+ * convolution with a kernel of ones for narrow boxes, and a running sum
+ * for wide ones.
+ *
+ * The guided filter streams everything a row at a time. Each input row
+ * goes through the four boxes (of the guide, the input, the guide squared
+ * and the guide times the input), and each row they complete becomes a
+ * row of a and b, which goes through two more boxes and gives a row of
+ * the output. So the image is read once and the output written once,
+ * and the rings of rows in between stay in cache, rather than each of
+ * the six boxes and the arithmetic between them being a pass over whole
+ * images.
+ *
+ * The image is cut into strips of rows, each started afresh, which are
+ * split over threads with OpenMP when it is available. This also stops
+ * the rounding in the running sums building up down the image.
+ * */
+
+#include "guided.h"
+#include "convolve.h"
+#include "simd.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef SSE3
+
+/* The widest instruction set that is built. */
+#if defined(AVX512)
+#define SIMD_ISA avx512
+#elif defined(AVX)
+#define SIMD_ISA avx
+#else
+#define SIMD_ISA sse
+#endif
+
+/* Up to this width, the row sums are cheaper as a convolution than as a
+ * (scalar) running sum.
+ * */
+#define ROW_CONVOLVE_MAX_WIDTH 32
+
+/* Each strip is this many boxes tall. */
+#define STRIP_BOXES 16
+
+/* out[i] = sum of in[i] to in[i+width-1], for length-width+1 outputs. */
+static void _row_sums(float* in, float* out, int length, int width,
+        float* ones)
+{
+    if (width <= ROW_CONVOLVE_MAX_WIDTH){
+        SIMD_FUNC(generic)(in, out, length, ones, width);
+        return;
+    }
+
+    float sum = 0.0f;
+    for(int i=0; i<width; i++){
+        sum += in[i];
+    }
+    out[0] = sum;
+
+    for(int i=1; i<=length-width; i++){
+        sum += in[i + width - 1] - in[i - 1];
+        out[i] = sum;
+    }
+}
+
+/* Adds ``entering'' to the column sums and takes off ``leaving'', which
+ * it then replaces in the ring.
+ * */
+static inline void _column_sums_update(float* sums, float* entering,
+        float* leaving, int length)
+{
+    int i = 0;
+    for(; i<=length - SIMD_WIDTH; i+=SIMD_WIDTH){
+        SIMD_T update = SIMD_OP(sub)(SIMD_OP(loadu)(entering + i),
+                SIMD_OP(loadu)(leaving + i));
+        SIMD_OP(storeu)(sums + i,
+                SIMD_OP(add)(SIMD_OP(loadu)(sums + i), update));
+        SIMD_OP(storeu)(leaving + i, SIMD_OP(loadu)(entering + i));
+    }
+    for(; i<length; i++){
+        sums[i] += entering[i] - leaving[i];
+        leaving[i] = entering[i];
+    }
+}
+
+int convolve_sse_2d_box(float* in, float* out, int cols, int rows,
+        int box_cols, int box_rows)
+{
+    int out_cols = cols - box_cols + 1;
+    int out_rows = rows - box_rows + 1;
+
+    if (box_cols < 1 || box_rows < 1){
+        return -1;
+    }
+    if (out_cols <= 0 || out_rows <= 0){
+        return 0;
+    }
+
+    int strip_rows = STRIP_BOXES*box_rows;
+    int n_strips = (out_rows + strip_rows - 1) / strip_rows;
+    float scale = 1.0f / (box_cols*box_rows);
+    int failed = 0;
+
+    // The kernel of the convolved row sums, so no wider than they go
+    float ones[ROW_CONVOLVE_MAX_WIDTH];
+    for(int i=0; i<ROW_CONVOLVE_MAX_WIDTH; i++){
+        ones[i] = 1.0f;
+    }
+
+    #pragma omp parallel
+    {
+        float* ring = malloc((box_rows + 2)*out_cols*sizeof(float));
+        float* sums = ring + box_rows*out_cols;
+        float* row_sums = sums + out_cols;
+
+        if (ring == NULL){
+            #pragma omp atomic write
+            failed = 1;
+        }
+
+        #pragma omp for
+        for(int strip=0; strip<n_strips; strip++){
+            if (ring == NULL){
+                continue;
+            }
+
+            int first = strip*strip_rows;
+            int last = first + strip_rows < out_rows ?
+                first + strip_rows : out_rows;
+
+            memset(ring, 0, (box_rows + 1)*out_cols*sizeof(float));
+
+            for(int row=first; row<last+box_rows-1; row++){
+                int n = row - first;
+
+                _row_sums(in + row*cols, row_sums, cols, box_cols, ones);
+                _column_sums_update(sums, row_sums,
+                        ring + (n % box_rows)*out_cols, out_cols);
+
+                if (n >= box_rows - 1){
+                    float* out_row = out + (row - box_rows + 1)*out_cols;
+                    SIMD_T scale_v = SIMD_OP(set1)(scale);
+
+                    int i = 0;
+                    for(; i<=out_cols - SIMD_WIDTH; i+=SIMD_WIDTH){
+                        SIMD_OP(storeu)(out_row + i, SIMD_OP(mul)(
+                                    SIMD_OP(loadu)(sums + i), scale_v));
+                    }
+                    for(; i<out_cols; i++){
+                        out_row[i] = sums[i] * scale;
+                    }
+                }
+            }
+        }
+
+        free(ring);
+    }
+
+    return failed ? -1 : 0;
+}
+
+/* The coefficients a and b of a row, from the box sums of the guide,
+ * the input, the guide squared and the guide times the input.
+ * */
+static inline void _coefficients(float* guide_sums, float* in_sums,
+        float* square_sums, float* product_sums, float* a, float* b,
+        int length, float scale, float epsilon)
+{
+    SIMD_T scale_v = SIMD_OP(set1)(scale);
+    SIMD_T epsilon_v = SIMD_OP(set1)(epsilon);
+
+    int i = 0;
+    for(; i<=length - SIMD_WIDTH; i+=SIMD_WIDTH){
+        SIMD_T mean_guide = SIMD_OP(mul)(SIMD_OP(loadu)(guide_sums + i),
+                scale_v);
+        SIMD_T mean_in = SIMD_OP(mul)(SIMD_OP(loadu)(in_sums + i), scale_v);
+        SIMD_T variance = SIMD_OP(sub)(
+                SIMD_OP(mul)(SIMD_OP(loadu)(square_sums + i), scale_v),
+                SIMD_OP(mul)(mean_guide, mean_guide));
+        SIMD_T covariance = SIMD_OP(sub)(
+                SIMD_OP(mul)(SIMD_OP(loadu)(product_sums + i), scale_v),
+                SIMD_OP(mul)(mean_guide, mean_in));
+
+        SIMD_T a_v = SIMD_OP(div)(covariance,
+                SIMD_OP(add)(variance, epsilon_v));
+        SIMD_OP(storeu)(a + i, a_v);
+        SIMD_OP(storeu)(b + i, SIMD_OP(sub)(mean_in,
+                    SIMD_OP(mul)(a_v, mean_guide)));
+    }
+
+    for(; i<length; i++){
+        float mean_guide = guide_sums[i] * scale;
+        float mean_in = in_sums[i] * scale;
+        float variance = square_sums[i]*scale - mean_guide*mean_guide;
+        float covariance = product_sums[i]*scale - mean_guide*mean_in;
+
+        a[i] = covariance / (variance + epsilon);
+        b[i] = mean_in - a[i]*mean_guide;
+    }
+}
+
+/* A row of the output from the box sums of a and b. */
+static inline void _output_row(float* a_sums, float* b_sums, float* guide,
+        float* out, int length, float scale)
+{
+    SIMD_T scale_v = SIMD_OP(set1)(scale);
+
+    int i = 0;
+    for(; i<=length - SIMD_WIDTH; i+=SIMD_WIDTH){
+        SIMD_T value = SIMD_OP(fmadd)(SIMD_OP(loadu)(a_sums + i),
+                SIMD_OP(loadu)(guide + i), SIMD_OP(loadu)(b_sums + i));
+        SIMD_OP(storeu)(out + i, SIMD_OP(mul)(value, scale_v));
+    }
+    for(; i<length; i++){
+        out[i] = (a_sums[i]*guide[i] + b_sums[i]) * scale;
+    }
+}
+
+int convolve_sse_2d_guided(float* guide, float* in, float* out, int cols,
+        int rows, int radius, float epsilon)
+{
+    if (radius < 0){
+        return -1;
+    }
+    // As a long, so that a huge radius cannot overflow
+    if (4L*radius >= cols || 4L*radius >= rows){
+        return 0;
+    }
+
+    int box = 2*radius + 1;
+    int mid_cols = cols - 2*radius;
+    int out_cols = cols - 4*radius;
+    int out_rows = rows - 4*radius;
+
+    int strip_rows = STRIP_BOXES*box;
+    int n_strips = (out_rows + strip_rows - 1) / strip_rows;
+    float scale = 1.0f / (box*box);
+    int failed = 0;
+
+    float ones[ROW_CONVOLVE_MAX_WIDTH];
+    for(int i=0; i<ROW_CONVOLVE_MAX_WIDTH; i++){
+        ones[i] = 1.0f;
+    }
+
+    // The rings and sums of the first boxes, then of the second
+    int first_length = 4*(box + 1)*mid_cols;
+    int second_length = 2*(box + 1)*out_cols;
+    int row_length = 2*cols + 6*mid_cols;
+
+    #pragma omp parallel
+    {
+        float* buffer = malloc((first_length + second_length + row_length)
+                *sizeof(float));
+
+        if (buffer == NULL){
+            #pragma omp atomic write
+            failed = 1;
+        }
+
+        #pragma omp for
+        for(int strip=0; strip<n_strips; strip++){
+            if (buffer == NULL){
+                continue;
+            }
+
+            float* first_rings[4];
+            float* first_sums[4];
+            float* second_rings[2];
+            float* second_sums[2];
+
+            for(int q=0; q<4; q++){
+                first_rings[q] = buffer + q*(box + 1)*mid_cols;
+                first_sums[q] = first_rings[q] + box*mid_cols;
+            }
+            for(int q=0; q<2; q++){
+                second_rings[q] = buffer + first_length
+                    + q*(box + 1)*out_cols;
+                second_sums[q] = second_rings[q] + box*out_cols;
+            }
+
+            float* squares = buffer + first_length + second_length;
+            float* products = squares + cols;
+            float* row_sums = products + cols;
+            float* a = row_sums + 4*mid_cols;
+            float* b = a + mid_cols;
+
+            int first = strip*strip_rows;
+            int last = first + strip_rows < out_rows ?
+                first + strip_rows : out_rows;
+
+            memset(buffer, 0, (first_length + second_length)*sizeof(float));
+
+            for(int row=first; row<last+4*radius; row++){
+                int n = row - first;
+                float* guide_row = guide + row*cols;
+                float* in_row = in + row*cols;
+
+                for(int i=0; i<cols; i++){
+                    squares[i] = guide_row[i] * guide_row[i];
+                    products[i] = guide_row[i] * in_row[i];
+                }
+
+                float* rows_in[4] = {guide_row, in_row, squares, products};
+                for(int q=0; q<4; q++){
+                    _row_sums(rows_in[q], row_sums + q*mid_cols, cols, box,
+                            ones);
+                    _column_sums_update(first_sums[q],
+                            row_sums + q*mid_cols,
+                            first_rings[q] + (n % box)*mid_cols, mid_cols);
+                }
+
+                if (n < box - 1){
+                    continue;
+                }
+
+                // A row of a and b is complete
+                int mid_n = n - (box - 1);
+
+                _coefficients(first_sums[0], first_sums[1], first_sums[2],
+                        first_sums[3], a, b, mid_cols, scale, epsilon);
+
+                float* rows_mid[2] = {a, b};
+                for(int q=0; q<2; q++){
+                    _row_sums(rows_mid[q], row_sums + q*mid_cols, mid_cols,
+                            box, ones);
+                    _column_sums_update(second_sums[q],
+                            row_sums + q*mid_cols,
+                            second_rings[q] + (mid_n % box)*out_cols,
+                            out_cols);
+                }
+
+                if (mid_n < box - 1){
+                    continue;
+                }
+
+                // And so is a row of the output
+                int out_row = row - 4*radius;
+                _output_row(second_sums[0], second_sums[1],
+                        guide + (out_row + 2*radius)*cols + 2*radius,
+                        out + out_row*out_cols, out_cols, scale);
+            }
+        }
+
+        free(buffer);
+    }
+
+    return failed ? -1 : 0;
+}
+
+#endif
@@ -0,0 +1,49 @@
+/* Copyright (C) 2013 Henry Gomersall <heng@cantab.net> 
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the organization nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY  THE AUTHOR ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+#ifndef _GUIDED_H
+#define _GUIDED_H
+
+/* Box and guided filters (see guided.c). As for the convolutions, only
+ * the valid part is computed: the box filter's output is
+ * (cols-box_cols+1) x (rows-box_rows+1), and the guided filter, which is
+ * two (2*radius+1) square boxes in a row, gives
+ * (cols-4*radius) x (rows-4*radius).
+ *
+ * Nothing is written if the image is smaller than the box (or two
+ * boxes). Both return -1 for a box under 1 x 1 or a negative radius, or
+ * if their row buffers cannot be allocated.
+ * */
+#ifdef SSE3
+int convolve_sse_2d_box(float* in, float* out, int cols, int rows,
+        int box_cols, int box_rows);
+
+int convolve_sse_2d_guided(float* guide, float* in, float* out, int cols,
+        int rows, int radius, float epsilon);
+#endif
+
+#endif /* Header guard */
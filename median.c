@@ -0,0 +1,570 @@
+/* Copyright (C) 2013 Henry Gomersall <heng@cantab.net> 
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the organization nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY  THE AUTHOR ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+/* Median and rank filters.
+ *
+ * The float filters run a selection network, a fixed sequence of
+ * compare-exchanges (a min and a max) that leaves the median of its
+ * inputs in the middle, on whole vectors: each lane is a different
+ * output, so a vector of medians costs the same as one. Windows of 3, 5,
+ * 7 and 3x3 have hand-picked networks (from N. Devillard, "Fast median
+ * search: an ANSI C implementation", 1998). Other windows use Batcher's
+ * odd-even merge sort on the next power of two, padded with +inf, with
+ * the exchanges against the padding and those that cannot reach the
+ * middle pruned away.
+ *
+ * The 8-bit filters keep a histogram of the window, as in Perreault and
+ * Hebert, "Median Filtering in Constant Time" (2007). A histogram is kept
+ * for each column, covering the rows of the window, and the window's
+ * histogram slides along a row by adding the column entering it and
+ * subtracting the one leaving, so the cost per pixel does not depend on
+ * the radius. A 16 bin coarse histogram alongside the 256 bin one means
+ * finding a rank scans at most 32 bins.
+ * */
+
+#include "median.h"
+#include "simd.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* The widest instruction set that is built. */
+#if defined(AVX512)
+#define SIMD_ISA avx512
+#elif defined(AVX)
+#define SIMD_ISA avx
+#elif defined(SSE3)
+#define SIMD_ISA sse
+#elif defined(NEON)
+#define SIMD_ISA neon
+#endif
+
+#ifdef SIMD_ISA
+
+#define MAX_WINDOW 64
+
+/* The most exchanges in an odd-even merge sort of MAX_WINDOW inputs. */
+#define MAX_EXCHANGES 543
+
+/* Selection networks. SORT(a, b) leaves the smaller of p[a] and p[b] in
+ * p[a] and the larger in p[b]; after each, the median is in the middle.
+ * */
+#define _MEDIAN_3(SORT) \
+    SORT(0, 1) SORT(1, 2) SORT(0, 1)
+
+#define _MEDIAN_5(SORT) \
+    SORT(0, 1) SORT(3, 4) SORT(0, 3) SORT(1, 4) SORT(1, 2) SORT(2, 3) \
+    SORT(1, 2)
+
+#define _MEDIAN_7(SORT) \
+    SORT(0, 5) SORT(0, 3) SORT(1, 6) SORT(2, 4) SORT(0, 1) SORT(3, 5) \
+    SORT(2, 6) SORT(2, 3) SORT(3, 6) SORT(4, 5) SORT(1, 4) SORT(1, 3) \
+    SORT(3, 4)
+
+#define _MEDIAN_9(SORT) \
+    SORT(1, 2) SORT(4, 5) SORT(7, 8) SORT(0, 1) SORT(3, 4) SORT(6, 7) \
+    SORT(1, 2) SORT(4, 5) SORT(7, 8) SORT(0, 3) SORT(5, 8) SORT(4, 7) \
+    SORT(3, 6) SORT(1, 4) SORT(2, 5) SORT(4, 7) SORT(4, 2) SORT(6, 4) \
+    SORT(4, 2)
+
+#define _SORT_VECTOR(a, b) { \
+    SIMD_T smaller = SIMD_OP(min)(p[a], p[b]); \
+    p[b] = SIMD_OP(max)(p[a], p[b]); \
+    p[a] = smaller; }
+
+#define _SORT_SCALAR(a, b) { \
+    float smaller = p[a] < p[b] ? p[a] : p[b]; \
+    p[b] = p[a] < p[b] ? p[b] : p[a]; \
+    p[a] = smaller; }
+
+/* ``n'' is always a constant, so only one network is kept, and the
+ * indices being constants keeps ``p'' in registers.
+ * */
+static inline __attribute__ ((always_inline))
+void _select(SIMD_T* p, int n)
+{
+    switch(n){
+        case 3: _MEDIAN_3(_SORT_VECTOR) break;
+        case 5: _MEDIAN_5(_SORT_VECTOR) break;
+        case 7: _MEDIAN_7(_SORT_VECTOR) break;
+        case 9: _MEDIAN_9(_SORT_VECTOR) break;
+    }
+}
+
+static inline __attribute__ ((always_inline))
+float _select_scalar(float* p, int n)
+{
+    switch(n){
+        case 3: _MEDIAN_3(_SORT_SCALAR) break;
+        case 5: _MEDIAN_5(_SORT_SCALAR) break;
+        case 7: _MEDIAN_7(_SORT_SCALAR) break;
+        case 9: _MEDIAN_9(_SORT_SCALAR) break;
+    }
+    return p[n/2];
+}
+
+/* A compare-exchange of a generated network. ``keep'' has bit 0 set if
+ * the min is used later and bit 1 if the max is.
+ * */
+typedef struct {
+    unsigned char a;
+    unsigned char b;
+    unsigned char keep;
+} _exchange;
+
+/* Builds the pruned network for the median of n inputs, and returns the
+ * number of exchanges in it.
+ * */
+static int _median_network(int n, _exchange* network)
+{
+    _exchange all[MAX_EXCHANGES];
+    int count = 0;
+
+    int size = 1;
+    while (size < n){
+        size *= 2;
+    }
+
+    // The input each wire holds, or -1 where it holds +inf padding
+    int slot[size];
+    for(int i=0; i<size; i++){
+        slot[i] = i < n ? i : -1;
+    }
+
+    for(int p=1; p<size; p*=2){
+        for(int k=p; k>=1; k/=2){
+            for(int j=k%p; j+k<size; j+=2*k){
+                for(int i=0; i<k && i<size-j-k; i++){
+                    if ((i + j)/(2*p) != (i + j + k)/(2*p)){
+                        continue;
+                    }
+
+                    int lower = i + j;
+                    int upper = i + j + k;
+
+                    if (slot[upper] == -1){
+                        // +inf is already the larger
+                        continue;
+                    }
+                    if (slot[lower] == -1){
+                        // The exchange is just a swap
+                        slot[lower] = slot[upper];
+                        slot[upper] = -1;
+                        continue;
+                    }
+
+                    all[count].a = slot[lower];
+                    all[count].b = slot[upper];
+                    count++;
+                }
+            }
+        }
+    }
+
+    // Backwards from the median, keeping only what reaches it
+    int needed[n];
+    memset(needed, 0, n*sizeof(int));
+    needed[slot[(n - 1)/2]] = 1;
+
+    int kept = 0;
+    for(int e=count-1; e>=0; e--){
+        int keep = needed[all[e].a] | (needed[all[e].b] << 1);
+        all[e].keep = keep;
+        if (keep){
+            needed[all[e].a] = 1;
+            needed[all[e].b] = 1;
+            kept++;
+        }
+    }
+
+    int i = 0;
+    for(int e=0; e<count; e++){
+        if (all[e].keep){
+            network[i++] = all[e];
+        }
+    }
+
+    return kept;
+}
+
+static inline __attribute__ ((always_inline))
+void _run_network(SIMD_T* p, _exchange* network, int n_exchanges)
+{
+    for(int e=0; e<n_exchanges; e++){
+        SIMD_T a = p[network[e].a];
+        SIMD_T b = p[network[e].b];
+
+        if (network[e].keep & 1){
+            p[network[e].a] = SIMD_OP(min)(a, b);
+        }
+        if (network[e].keep & 2){
+            p[network[e].b] = SIMD_OP(max)(a, b);
+        }
+    }
+}
+
+static float _run_network_scalar(float* p, _exchange* network,
+        int n_exchanges, int n)
+{
+    for(int e=0; e<n_exchanges; e++){
+        float a = p[network[e].a];
+        float b = p[network[e].b];
+
+        if (network[e].keep & 1){
+            p[network[e].a] = a < b ? a : b;
+        }
+        if (network[e].keep & 2){
+            p[network[e].b] = a < b ? b : a;
+        }
+    }
+    return p[(n - 1)/2];
+}
+
+static inline __attribute__ ((always_inline))
+void _median_1d_fixed(float* in, float* out, int length, int window)
+{
+    SIMD_T p[9];
+    float scalar_p[9];
+
+    int out_length = length - window + 1;
+
+    int i = 0;
+    for(; i<=out_length - SIMD_WIDTH; i+=SIMD_WIDTH){
+        for(int k=0; k<window; k++){
+            p[k] = SIMD_OP(loadu)(in + i + k);
+        }
+        _select(p, window);
+        SIMD_OP(storeu)(out + i, p[window/2]);
+    }
+
+    for(; i<out_length; i++){
+        for(int k=0; k<window; k++){
+            scalar_p[k] = in[i + k];
+        }
+        out[i] = _select_scalar(scalar_p, window);
+    }
+}
+
+int median_1d(float* in, float* out, int length, int window)
+{
+    if (window < 1 || window % 2 == 0 || window >= MAX_WINDOW){
+        return -1;
+    }
+
+    switch(window){
+        case 1:
+            memmove(out, in, length*sizeof(float));
+            return 0;
+        case 3: _median_1d_fixed(in, out, length, 3); return 0;
+        case 5: _median_1d_fixed(in, out, length, 5); return 0;
+        case 7: _median_1d_fixed(in, out, length, 7); return 0;
+        case 9: _median_1d_fixed(in, out, length, 9); return 0;
+    }
+
+    _exchange network[MAX_EXCHANGES];
+    int n_exchanges = _median_network(window, network);
+
+    SIMD_T p[window];
+    float scalar_p[window];
+
+    int out_length = length - window + 1;
+
+    int i = 0;
+    for(; i<=out_length - SIMD_WIDTH; i+=SIMD_WIDTH){
+        for(int k=0; k<window; k++){
+            p[k] = SIMD_OP(loadu)(in + i + k);
+        }
+        _run_network(p, network, n_exchanges);
+        SIMD_OP(storeu)(out + i, p[(window - 1)/2]);
+    }
+
+    for(; i<out_length; i++){
+        memcpy(scalar_p, in + i, window*sizeof(float));
+        out[i] = _run_network_scalar(scalar_p, network, n_exchanges, window);
+    }
+
+    return 0;
+}
+
+/* The window x window neighbourhood of each output, a row at a time, is
+ * the input to the network. The output rows are split over threads with
+ * OpenMP when it is available.
+ * */
+int median_2d(float* in, float* out, int cols, int rows, int window)
+{
+    int n = window*window;
+
+    if (window < 1 || window % 2 == 0 || n >= MAX_WINDOW){
+        return -1;
+    }
+
+    int out_cols = cols - window + 1;
+    int out_rows = rows - window + 1;
+
+    _exchange network[MAX_EXCHANGES];
+    int n_exchanges = n > 9 ? _median_network(n, network) : 0;
+
+    #pragma omp parallel for
+    for(int row=0; row<out_rows; row++){
+
+        SIMD_T p[n];
+        float scalar_p[n];
+
+        float* in_row = in + row*cols;
+        float* out_row = out + row*out_cols;
+
+        int c = 0;
+        for(; c<=out_cols - SIMD_WIDTH; c+=SIMD_WIDTH){
+            for(int a=0; a<window; a++){
+                for(int b=0; b<window; b++){
+                    p[a*window + b] = SIMD_OP(loadu)(
+                            in_row + a*cols + c + b);
+                }
+            }
+
+            if (n == 1){
+                SIMD_OP(storeu)(out_row + c, p[0]);
+            } else if (n == 9){
+                _select(p, 9);
+                SIMD_OP(storeu)(out_row + c, p[4]);
+            } else {
+                _run_network(p, network, n_exchanges);
+                SIMD_OP(storeu)(out_row + c, p[(n - 1)/2]);
+            }
+        }
+
+        for(; c<out_cols; c++){
+            for(int a=0; a<window; a++){
+                for(int b=0; b<window; b++){
+                    scalar_p[a*window + b] = in_row[a*cols + c + b];
+                }
+            }
+
+            if (n == 1){
+                out_row[c] = scalar_p[0];
+            } else if (n == 9){
+                out_row[c] = _select_scalar(scalar_p, 9);
+            } else {
+                out_row[c] = _run_network_scalar(scalar_p, network,
+                        n_exchanges, n);
+            }
+        }
+    }
+
+    return 0;
+}
+
+#endif
+
+/* Each thread works down a strip of this many windows' worth of output
+ * rows, so filling the column histograms at the top of each strip is at
+ * most an eighth of the work.
+ * */
+#define STRIP_WINDOWS 8
+
+#define COARSE_SHIFT 4
+#define N_COARSE (256 >> COARSE_SHIFT)
+#define FINE_PER_COARSE (1 << COARSE_SHIFT)
+
+/* The window's histogram as it slides along a row. The coarse histogram
+ * is kept up to date at every step, but each 16 bin segment of the fine
+ * one is only brought up to date when a rank falls in it, from the
+ * window it was last valid for, ``updated''. Usually only a few segments
+ * are ever looked at, so this is most of the saving.
+ * */
+typedef struct {
+    uint16_t fine[256];
+    uint16_t coarse[N_COARSE];
+    int updated[N_COARSE];
+} _histogram;
+
+static inline void _segment_update(_histogram* histogram, int segment,
+        uint16_t* column_fine, int cols, int col, int window)
+{
+    uint16_t* fine = histogram->fine + segment*FINE_PER_COARSE;
+    uint16_t* columns = column_fine + segment*cols*FINE_PER_COARSE;
+    int updated = histogram->updated[segment];
+
+    if (updated < 0 || col - updated >= window){
+        // Nothing is shared with the old window, so start again
+        memset(fine, 0, FINE_PER_COARSE*sizeof(uint16_t));
+        for(int c=col; c<col+window; c++){
+            uint16_t* column = columns + c*FINE_PER_COARSE;
+            for(int i=0; i<FINE_PER_COARSE; i++){
+                fine[i] += column[i];
+            }
+        }
+    } else {
+        for(int c=updated; c<col; c++){
+            uint16_t* leaving = columns + c*FINE_PER_COARSE;
+            uint16_t* entering = columns + (c + window)*FINE_PER_COARSE;
+            for(int i=0; i<FINE_PER_COARSE; i++){
+                fine[i] += entering[i] - leaving[i];
+            }
+        }
+    }
+
+    histogram->updated[segment] = col;
+}
+
+/* The column histograms are stored a segment at a time, so that along a
+ * row the segment being searched is contiguous from column to column.
+ * */
+static inline int _fine_index(int cols, int col, uint8_t value)
+{
+    return ((value >> COARSE_SHIFT)*cols + col)*FINE_PER_COARSE
+        + (value & (FINE_PER_COARSE - 1));
+}
+
+/* The value of the given rank in the window starting at ``col'', finding
+ * its coarse bin first.
+ * */
+static inline uint8_t _histogram_rank(_histogram* histogram,
+        uint16_t* column_fine, int cols, int col, int window, int rank)
+{
+    int count = 0;
+    int segment = 0;
+    while (count + histogram->coarse[segment] <= rank){
+        count += histogram->coarse[segment++];
+    }
+
+    _segment_update(histogram, segment, column_fine, cols, col, window);
+
+    int bin = segment*FINE_PER_COARSE;
+    while (count + histogram->fine[bin] <= rank){
+        count += histogram->fine[bin++];
+    }
+    return bin;
+}
+
+int median_rank_2d_u8(uint8_t* in, uint8_t* out, int cols, int rows,
+        int radius, int rank)
+{
+    int window = 2*radius + 1;
+    int out_cols = cols - window + 1;
+    int out_rows = rows - window + 1;
+
+    if (radius < 0 || radius > 127 || rank < 0 || rank >= window*window){
+        return -1;
+    }
+    if (out_cols <= 0 || out_rows <= 0){
+        return 0;
+    }
+
+    int strip_rows = STRIP_WINDOWS*window;
+    int n_strips = (out_rows + strip_rows - 1) / strip_rows;
+    int failed = 0;
+
+    #pragma omp parallel
+    {
+        uint16_t* column_fine = malloc(cols*256*sizeof(uint16_t));
+        uint16_t* column_coarse = malloc(cols*N_COARSE*sizeof(uint16_t));
+        _histogram histogram;
+
+        if (column_fine == NULL || column_coarse == NULL){
+            #pragma omp atomic write
+            failed = 1;
+        }
+
+        #pragma omp for
+        for(int strip=0; strip<n_strips; strip++){
+            if (column_fine == NULL || column_coarse == NULL){
+                continue;
+            }
+
+            int first = strip*strip_rows;
+            int last = first + strip_rows < out_rows ?
+                first + strip_rows : out_rows;
+
+            memset(column_fine, 0, cols*256*sizeof(uint16_t));
+            memset(column_coarse, 0, cols*N_COARSE*sizeof(uint16_t));
+
+            for(int row=first; row<first+window-1; row++){
+                for(int c=0; c<cols; c++){
+                    uint8_t value = in[row*cols + c];
+                    column_fine[_fine_index(cols, c, value)]++;
+                    column_coarse[c*N_COARSE + (value >> COARSE_SHIFT)]++;
+                }
+            }
+
+            for(int row=first; row<last; row++){
+
+                // Slide the columns down to cover this row's windows
+                for(int c=0; c<cols; c++){
+                    uint8_t value = in[(row + window - 1)*cols + c];
+                    column_fine[_fine_index(cols, c, value)]++;
+                    column_coarse[c*N_COARSE + (value >> COARSE_SHIFT)]++;
+
+                    if (row > first){
+                        value = in[(row - 1)*cols + c];
+                        column_fine[_fine_index(cols, c, value)]--;
+                        column_coarse[c*N_COARSE
+                            + (value >> COARSE_SHIFT)]--;
+                    }
+                }
+
+                memset(histogram.coarse, 0, sizeof(histogram.coarse));
+                for(int i=0; i<N_COARSE; i++){
+                    histogram.updated[i] = -window;
+                }
+                for(int c=0; c<window; c++){
+                    for(int i=0; i<N_COARSE; i++){
+                        histogram.coarse[i] += column_coarse[c*N_COARSE + i];
+                    }
+                }
+
+                uint8_t* out_row = out + row*out_cols;
+                out_row[0] = _histogram_rank(&histogram, column_fine, cols,
+                        0, window, rank);
+
+                for(int c=1; c<out_cols; c++){
+                    uint16_t* entering = column_coarse
+                        + (c + window - 1)*N_COARSE;
+                    uint16_t* leaving = column_coarse + (c - 1)*N_COARSE;
+                    for(int i=0; i<N_COARSE; i++){
+                        histogram.coarse[i] += entering[i] - leaving[i];
+                    }
+
+                    out_row[c] = _histogram_rank(&histogram, column_fine,
+                            cols, c, window, rank);
+                }
+            }
+        }
+
+        free(column_fine);
+        free(column_coarse);
+    }
+
+    return failed ? -1 : 0;
+}
+
+int median_2d_u8(uint8_t* in, uint8_t* out, int cols, int rows,
+        int radius)
+{
+    return median_rank_2d_u8(in, out, cols, rows, radius,
+            2*radius*(radius + 1));
+}
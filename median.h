@@ -0,0 +1,57 @@
+/* Copyright (C) 2013 Henry Gomersall <heng@cantab.net> 
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the organization nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY  THE AUTHOR ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+#ifndef _MEDIAN_H
+#define _MEDIAN_H
+
+#include <stdint.h>
+
+/* Median and rank filters (see median.c). As for the convolutions, only
+ * the valid part is computed: a ``window'' wide 1D median of ``length''
+ * samples gives length-window+1 outputs, and a window x window 2D one
+ * of a cols x rows image gives (cols-window+1) x (rows-window+1).
+ *
+ * The float filters take odd windows of up to 63 samples (7x7 in 2D) and
+ * return -1 for any other. The 1D one can run in place.
+ * */
+#if defined(SSE3) || defined(NEON)
+int median_1d(float* in, float* out, int length, int window);
+
+int median_2d(float* in, float* out, int cols, int rows, int window);
+#endif
+
+/* 8-bit images, with a (2*radius+1) square window of any size up to a
+ * radius of 127. ``rank'' counts from 0, so the median is rank
+ * 2*radius*(radius+1).
+ * */
+int median_2d_u8(uint8_t* in, uint8_t* out, int cols, int rows,
+        int radius);
+
+int median_rank_2d_u8(uint8_t* in, uint8_t* out, int cols, int rows,
+        int radius, int rank);
+
+#endif /* Header guard */
@@ -0,0 +1,414 @@
+/* Copyright (C) 2013 Henry Gomersall <heng@cantab.net> 
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the organization nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY  THE AUTHOR ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+/* Grayscale morphology: dilation, the running maximum, and erosion, the
+ * running minimum, of a signal under a structuring element.
+ *
+ * For a flat element (a window of element_length, all weights zero)
+ *     dilate: out[i] = max_k in[i+k]
+ *     erode:  out[i] = min_k in[i+k]
+ * for 0 <= k < element_length. Short windows are done directly, a vector
+ * of outputs at a time. Long ones use the van Herk/Gil-Werman algorithm:
+ * the input is cut into blocks of element_length, and each window is
+ * the union of the tail of one block and the head of the next, so with
+ * the running maximum (or minimum) forward and backward through each
+ * block, every output is a single max (or min) of the two, whatever the
+ * window length.
+ *
+ * For a weighted element, the max-plus and min-plus analogues of the
+ * convolution,
+ *     dilate: out[i] = max_k in[i+k] + element[element_length - k - 1]
+ *     erode:  out[i] = min_k in[i+k] - element[k]
+ * are done directly. As for the convolutions, dilation reflects the
+ * element.
+ * */
+
+#include "morphology.h"
+#include "simd.h"
+
+#include <math.h>
+
+/* The widest instruction set that is built. */
+#if defined(AVX512)
+#define SIMD_ISA avx512
+#elif defined(AVX)
+#define SIMD_ISA avx
+#elif defined(SSE3)
+#define SIMD_ISA sse
+#elif defined(NEON)
+#define SIMD_ISA neon
+#endif
+
+#ifdef SIMD_ISA
+
+/* Up to these lengths, taking the max of every tap directly beats the
+ * three passes of van Herk/Gil-Werman. Along rows its scans are scalar,
+ * so the direct method goes further there than down columns, where the
+ * scans are vectors across the columns. Found by timing 1920x1080 and
+ * 2^20 sample inputs with AVX-512.
+ * */
+#define ROW_DIRECT_MAX_LENGTH 64
+#define COLUMN_DIRECT_MAX_LENGTH 12
+
+/* ``erode'' is always a constant, so these are specialised away. */
+static inline __attribute__ ((always_inline))
+SIMD_T _extreme(SIMD_T a, SIMD_T b, int erode)
+{
+    return erode ? SIMD_OP(min)(a, b) : SIMD_OP(max)(a, b);
+}
+
+static inline __attribute__ ((always_inline))
+float _extreme_scalar(float a, float b, int erode)
+{
+    if (erode){
+        return b < a ? b : a;
+    }
+    return b > a ? b : a;
+}
+
+/* out[i] = extreme(a[i], b[i]) for ``length'' samples. */
+static inline __attribute__ ((always_inline))
+void _extreme_rows(float* a, float* b, float* out, int length, int erode)
+{
+    int i = 0;
+    for(; i<=length - SIMD_WIDTH; i+=SIMD_WIDTH){
+        SIMD_OP(storeu)(out + i, _extreme(SIMD_OP(loadu)(a + i),
+                    SIMD_OP(loadu)(b + i), erode));
+    }
+    for(; i<length; i++){
+        out[i] = _extreme_scalar(a[i], b[i], erode);
+    }
+}
+
+/* A flat element directly, with the same four accumulators as the
+ * generic convolution.
+ * */
+static inline __attribute__ ((always_inline))
+void _flat_direct(float* in, float* out, int length, int element_length,
+        int erode)
+{
+    SIMD_T acc0, acc1, acc2, acc3;
+
+    int out_length = length - element_length + 1;
+
+    int i = 0;
+    for(; i<=out_length - 4*SIMD_WIDTH; i+=4*SIMD_WIDTH){
+
+        acc0 = SIMD_OP(loadu)(in + i);
+        acc1 = SIMD_OP(loadu)(in + i + SIMD_WIDTH);
+        acc2 = SIMD_OP(loadu)(in + i + 2*SIMD_WIDTH);
+        acc3 = SIMD_OP(loadu)(in + i + 3*SIMD_WIDTH);
+
+        for(int k=1; k<element_length; k++){
+
+            float* data = in + i + k;
+
+            acc0 = _extreme(acc0, SIMD_OP(loadu)(data), erode);
+            acc1 = _extreme(acc1, SIMD_OP(loadu)(data + SIMD_WIDTH), erode);
+            acc2 = _extreme(acc2,
+                    SIMD_OP(loadu)(data + 2*SIMD_WIDTH), erode);
+            acc3 = _extreme(acc3,
+                    SIMD_OP(loadu)(data + 3*SIMD_WIDTH), erode);
+        }
+        SIMD_OP(storeu)(out + i, acc0);
+        SIMD_OP(storeu)(out + i + SIMD_WIDTH, acc1);
+        SIMD_OP(storeu)(out + i + 2*SIMD_WIDTH, acc2);
+        SIMD_OP(storeu)(out + i + 3*SIMD_WIDTH, acc3);
+    }
+
+    for(; i<=out_length - SIMD_WIDTH; i+=SIMD_WIDTH){
+
+        acc0 = SIMD_OP(loadu)(in + i);
+        for(int k=1; k<element_length; k++){
+            acc0 = _extreme(acc0, SIMD_OP(loadu)(in + i + k), erode);
+        }
+        SIMD_OP(storeu)(out + i, acc0);
+    }
+
+    for(; i<out_length; i++){
+
+        float value = in[i];
+        for(int k=1; k<element_length; k++){
+            value = _extreme_scalar(value, in[i+k], erode);
+        }
+        out[i] = value;
+    }
+}
+
+/* A flat element by van Herk/Gil-Werman. The running extreme backward
+ * through each block goes to ``out'' and the one forward to
+ * ``workspace'', and then
+ *     out[i] = extreme(backward[i], forward[i + element_length - 1])
+ * The forward pass is done first, so ``out'' can be ``in''.
+ * */
+static inline __attribute__ ((always_inline))
+void _flat_van_herk(float* in, float* out, int length, int element_length,
+        float* workspace, int erode)
+{
+    int out_length = length - element_length + 1;
+
+    for(int block=0; block<length; block+=element_length){
+        int end = block + element_length < length ?
+            block + element_length : length;
+
+        float running = in[block];
+        workspace[block] = running;
+        for(int i=block+1; i<end; i++){
+            running = _extreme_scalar(running, in[i], erode);
+            workspace[i] = running;
+        }
+    }
+
+    for(int block=0; block<out_length; block+=element_length){
+        int end = block + element_length < length ?
+            block + element_length : length;
+
+        float running = in[end - 1];
+        for(int i=end-1; i>=block; i--){
+            running = _extreme_scalar(running, in[i], erode);
+            if (i < out_length){
+                out[i] = running;
+            }
+        }
+    }
+
+    _extreme_rows(out, workspace + element_length - 1, out, out_length,
+            erode);
+}
+
+static inline __attribute__ ((always_inline))
+int _flat(float* in, float* out, int length, int element_length,
+        float* workspace, int erode)
+{
+    if (element_length <= ROW_DIRECT_MAX_LENGTH){
+        _flat_direct(in, out, length, element_length, erode);
+    } else {
+        _flat_van_herk(in, out, length, element_length, workspace, erode);
+    }
+    return 0;
+}
+
+int morphology_dilate(float* in, float* out, int length,
+        int element_length, float* workspace)
+{
+    return _flat(in, out, length, element_length, workspace, 0);
+}
+
+int morphology_erode(float* in, float* out, int length,
+        int element_length, float* workspace)
+{
+    return _flat(in, out, length, element_length, workspace, 1);
+}
+
+/* The weighted elements, as the generic convolution with max (or min)
+ * for the sum and add (or subtract) for the product. The weights are
+ * reflected and negated as needed up front, so both are a max-plus or
+ * min-plus with ``weights''.
+ * */
+static inline __attribute__ ((always_inline))
+int _weighted(float* in, float* out, int length, float* element,
+        int element_length, int erode)
+{
+    SIMD_T weights[element_length];
+    float scalar_weights[element_length];
+    SIMD_T acc0, acc1, acc2, acc3;
+
+    int out_length = length - element_length + 1;
+
+    for(int k=0; k<element_length; k++){
+        scalar_weights[k] = erode ? -element[k] :
+            element[element_length - k - 1];
+        weights[k] = SIMD_OP(set1)(scalar_weights[k]);
+    }
+
+    int i = 0;
+    for(; i<=out_length - 4*SIMD_WIDTH; i+=4*SIMD_WIDTH){
+
+        acc0 = SIMD_OP(set1)(erode ? INFINITY : -INFINITY);
+        acc1 = acc0;
+        acc2 = acc0;
+        acc3 = acc0;
+
+        for(int k=0; k<element_length; k++){
+
+            float* data = in + i + k;
+
+            acc0 = _extreme(acc0, SIMD_OP(add)(weights[k],
+                        SIMD_OP(loadu)(data)), erode);
+            acc1 = _extreme(acc1, SIMD_OP(add)(weights[k],
+                        SIMD_OP(loadu)(data + SIMD_WIDTH)), erode);
+            acc2 = _extreme(acc2, SIMD_OP(add)(weights[k],
+                        SIMD_OP(loadu)(data + 2*SIMD_WIDTH)), erode);
+            acc3 = _extreme(acc3, SIMD_OP(add)(weights[k],
+                        SIMD_OP(loadu)(data + 3*SIMD_WIDTH)), erode);
+        }
+        SIMD_OP(storeu)(out + i, acc0);
+        SIMD_OP(storeu)(out + i + SIMD_WIDTH, acc1);
+        SIMD_OP(storeu)(out + i + 2*SIMD_WIDTH, acc2);
+        SIMD_OP(storeu)(out + i + 3*SIMD_WIDTH, acc3);
+    }
+
+    for(; i<=out_length - SIMD_WIDTH; i+=SIMD_WIDTH){
+
+        acc0 = SIMD_OP(set1)(erode ? INFINITY : -INFINITY);
+        for(int k=0; k<element_length; k++){
+            acc0 = _extreme(acc0, SIMD_OP(add)(weights[k],
+                        SIMD_OP(loadu)(in + i + k)), erode);
+        }
+        SIMD_OP(storeu)(out + i, acc0);
+    }
+
+    for(; i<out_length; i++){
+
+        float value = erode ? INFINITY : -INFINITY;
+        for(int k=0; k<element_length; k++){
+            value = _extreme_scalar(value, in[i+k] + scalar_weights[k],
+                    erode);
+        }
+        out[i] = value;
+    }
+
+    return 0;
+}
+
+int morphology_dilate_weighted(float* in, float* out, int length,
+        float* element, int element_length)
+{
+    return _weighted(in, out, length, element, element_length, 0);
+}
+
+int morphology_erode_weighted(float* in, float* out, int length,
+        float* element, int element_length)
+{
+    return _weighted(in, out, length, element, element_length, 1);
+}
+
+/* A rectangle is a window along the rows and then one down the columns.
+ * The row pass goes to ``workspace'', rows x out_cols. Down the columns,
+ * each vector holds a run of columns, so both the direct method and the
+ * van Herk/Gil-Werman scans are whole rows of vectors. The backward scan
+ * keeps its running row in ``running'', since the rows of the last block
+ * below the output still feed it, and then the forward scan is done in
+ * place in the workspace.
+ * */
+static inline __attribute__ ((always_inline))
+int _rectangle(float* in, float* out, float* workspace, int cols,
+        int rows, int element_cols, int element_rows, int erode)
+{
+    int out_cols = cols - element_cols + 1;
+    int out_rows = rows - element_rows + 1;
+    int n_blocks = (out_rows + element_rows - 1) / element_rows;
+
+    #pragma omp parallel
+    {
+        float row_workspace[cols];
+        float running[out_cols];
+
+        #pragma omp for
+        for(int row=0; row<rows; row++){
+            _flat(in + row*cols, workspace + row*out_cols, cols,
+                    element_cols, row_workspace, erode);
+        }
+
+        if (element_rows <= COLUMN_DIRECT_MAX_LENGTH){
+
+            #pragma omp for
+            for(int row=0; row<out_rows; row++){
+                float* out_row = out + row*out_cols;
+
+                for(int i=0; i<out_cols; i++){
+                    out_row[i] = workspace[row*out_cols + i];
+                }
+                for(int k=1; k<element_rows; k++){
+                    _extreme_rows(out_row, workspace + (row + k)*out_cols,
+                            out_row, out_cols, erode);
+                }
+            }
+
+        } else {
+
+            #pragma omp for
+            for(int block=0; block<n_blocks; block++){
+                int first = block*element_rows;
+                int end = first + element_rows < rows ?
+                    first + element_rows : rows;
+
+                for(int i=0; i<out_cols; i++){
+                    running[i] = workspace[(end - 1)*out_cols + i];
+                }
+                for(int row=end-1; row>=first; row--){
+                    _extreme_rows(running, workspace + row*out_cols,
+                            running, out_cols, erode);
+                    if (row < out_rows){
+                        for(int i=0; i<out_cols; i++){
+                            out[row*out_cols + i] = running[i];
+                        }
+                    }
+                }
+            }
+
+            // Every block the outputs reach, including any after n_blocks
+            #pragma omp for
+            for(int block=0; block<n_blocks + 1; block++){
+                int first = block*element_rows;
+                int end = first + element_rows < rows ?
+                    first + element_rows : rows;
+
+                for(int row=first+1; row<end; row++){
+                    _extreme_rows(workspace + (row - 1)*out_cols,
+                            workspace + row*out_cols,
+                            workspace + row*out_cols, out_cols, erode);
+                }
+            }
+
+            #pragma omp for
+            for(int row=0; row<out_rows; row++){
+                _extreme_rows(out + row*out_cols,
+                        workspace + (row + element_rows - 1)*out_cols,
+                        out + row*out_cols, out_cols, erode);
+            }
+        }
+    }
+
+    return 0;
+}
+
+int morphology_2d_dilate(float* in, float* out, float* workspace,
+        int cols, int rows, int element_cols, int element_rows)
+{
+    return _rectangle(in, out, workspace, cols, rows, element_cols,
+            element_rows, 0);
+}
+
+int morphology_2d_erode(float* in, float* out, float* workspace,
+        int cols, int rows, int element_cols, int element_rows)
+{
+    return _rectangle(in, out, workspace, cols, rows, element_cols,
+            element_rows, 1);
+}
+
+#endif
@@ -0,0 +1,67 @@
+/* Copyright (C) 2013 Henry Gomersall <heng@cantab.net> 
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the organization nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY  THE AUTHOR ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+#ifndef _MORPHOLOGY_H
+#define _MORPHOLOGY_H
+
+/* Grayscale dilation and erosion, the max and min analogues of the
+ * convolutions (see morphology.c). As for the convolutions, only the
+ * valid part is computed, so a length ``length'' input gives
+ * length-element_length+1 outputs, and the output can be the input.
+ *
+ * The flat (unweighted) functions take a workspace of ``length'' floats,
+ * or rows x (cols-element_cols+1) floats in 2D.
+ *
+ * A weighted element is applied reversed for dilation, as the
+ * convolutions apply their kernels, and the right way round for erosion:
+ *     dilate: out[i] = max_k in[i+k] + element[element_length - k - 1]
+ *     erode:  out[i] = min_k in[i+k] - element[k]
+ * which is the usual pairing of the two for an element that is not
+ * symmetric.
+ * */
+#if defined(SSE3) || defined(NEON)
+int morphology_dilate(float* in, float* out, int length,
+        int element_length, float* workspace);
+
+int morphology_erode(float* in, float* out, int length,
+        int element_length, float* workspace);
+
+int morphology_dilate_weighted(float* in, float* out, int length,
+        float* element, int element_length);
+
+int morphology_erode_weighted(float* in, float* out, int length,
+        float* element, int element_length);
+
+/* Separable element_cols x element_rows rectangles. */
+int morphology_2d_dilate(float* in, float* out, float* workspace,
+        int cols, int rows, int element_cols, int element_rows);
+
+int morphology_2d_erode(float* in, float* out, float* workspace,
+        int cols, int rows, int element_cols, int element_rows);
+#endif
+
+#endif /* Header guard */
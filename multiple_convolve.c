@@ -37,6 +37,7 @@
  * */
 
 #include "convolve.h"
+#include "convolve_2d.h"
 
 #ifndef MULTIPLE_CONVOLVE
 #define MULTIPLE_CONVOLVE(FUNCTION_NAME) \
@@ -74,3 +75,52 @@ MULTIPLE_CONVOLVE(convolve_avx_unrolled_vector_aligned);
 MULTIPLE_CONVOLVE(convolve_avx_unrolled_vector_local_output);
 
 #endif
+
+#ifdef NEON
+MULTIPLE_CONVOLVE(convolve_neon_simple);
+MULTIPLE_CONVOLVE(convolve_neon_partial_unroll);
+MULTIPLE_CONVOLVE(convolve_neon_unrolled_vector);
+MULTIPLE_CONVOLVE(convolve_neon_unrolled_vector_fma);
+
+#endif
+
+#ifdef SVE
+MULTIPLE_CONVOLVE(convolve_sve_simple);
+
+#endif
+
+#ifdef SSE3
+MULTIPLE_CONVOLVE(convolve_sse_generic);
+#endif
+
+#ifdef AVX
+MULTIPLE_CONVOLVE(convolve_avx_generic);
+#endif
+
+#ifdef AVX512
+MULTIPLE_CONVOLVE(convolve_avx512_generic);
+#endif
+
+#ifdef NEON
+MULTIPLE_CONVOLVE(convolve_neon_generic);
+#endif
+
+#ifndef MULTIPLE_CONVOLVE_2D
+#define MULTIPLE_CONVOLVE_2D(FUNCTION_NAME) \
+int FUNCTION_NAME ## _multiple(float* in, float* out, float* workspace, \
+        int cols, int rows, float* kernel, int kernel_length, int N) \
+{ \
+    for(int i=0; i<N; i++){ \
+        FUNCTION_NAME(in, out, workspace, cols, rows, kernel, \
+                kernel_length); \
+    } \
+ \
+    return 0; \
+}
+#endif
+
+#ifdef SSE3
+MULTIPLE_CONVOLVE_2D(convolve_sse_2d_separable);
+MULTIPLE_CONVOLVE_2D(convolve_sse_2d_separable_transpose);
+MULTIPLE_CONVOLVE_2D(convolve_sse_2d_separable_columns);
+#endif
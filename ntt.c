@@ -0,0 +1,665 @@
+/* Copyright (C) 2013 Henry Gomersall <heng@cantab.net> 
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the organization nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY  THE AUTHOR ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+#include "ntt.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(AVX) && defined(__AVX2__)
+#include <immintrin.h>
+#define NTT_AVX2
+#endif
+
+/* Exact convolution of integer sequences, where the rounding in the
+ * floating point FFT would lose the low bits.
+ *
+ * The convolution is done three times, modulo three primes of the form
+ * c*2^k+1 below 2^30, each with a cyclic number theoretic transform of a
+ * power of two length, and the results are combined with the Chinese
+ * remainder theorem in 128-bit arithmetic. The product of the primes is
+ * about 2^86, so every output that fits in an int64_t is exact.
+ *
+ * Multiplication modulo a prime uses Montgomery reduction with R = 2^32,
+ * which needs no division. The inputs are moved into Montgomery form as
+ * they are reduced, the twiddles are kept in it, and the final scale by
+ * 1/n also takes the results back out of it.
+ *
+ * The forward transforms are decimation in frequency, which takes the
+ * data in order and leaves the spectrum in bit reversed order, and the
+ * inverse is decimation in time, which takes it back. The pointwise
+ * product does not care about the order, so no bit reversal is ever
+ * done. As in fft.c, each stage reads its twiddles contiguously from
+ * offset h of a table, and the stages that fit in a block are done a
+ * block at a time. With AVX2 every butterfly and the pointwise product
+ * work on eight points at a time, with the 32 x 32 -> 64-bit products
+ * of the even and odd lanes done separately by _mm256_mul_epu32.
+ * */
+
+#define NTT_N_PRIMES 3
+
+typedef struct {
+    uint32_t prime;
+    uint32_t generator;
+    int max_log2_length;
+} _ntt_prime;
+
+static const _ntt_prime _primes[NTT_N_PRIMES] = {
+    {998244353u, 3, 23},    // 119*2^23 + 1
+    {167772161u, 3, 25},    // 5*2^25 + 1
+    {469762049u, 3, 26},    // 7*2^26 + 1
+};
+
+#define NTT_MAX_LOG2_LENGTH 23
+
+typedef struct {
+    uint32_t prime;
+    // -prime^-1 mod 2^32
+    uint32_t prime_neg_inverse;
+    // 2^64 mod prime, to move into Montgomery form
+    uint32_t r_squared;
+} _montgomery;
+
+static uint32_t _pow_mod(uint64_t base, uint64_t exponent, uint32_t prime)
+{
+    uint64_t result = 1;
+    base %= prime;
+
+    while (exponent){
+        if (exponent & 1){
+            result = result * base % prime;
+        }
+        base = base * base % prime;
+        exponent >>= 1;
+    }
+
+    return result;
+}
+
+static void _montgomery_init(_montgomery* m, uint32_t prime)
+{
+    // Newton's iteration for the inverse modulo 2^32
+    uint32_t inverse = prime;
+    for(int i=0; i<5; i++){
+        inverse *= 2 - prime * inverse;
+    }
+
+    m->prime = prime;
+    m->prime_neg_inverse = -inverse;
+
+    uint64_t r = ((uint64_t) 1 << 32) % prime;
+    m->r_squared = r * r % prime;
+}
+
+/* a*b/R mod prime, for a*b < prime*2^32. */
+static inline uint32_t _montgomery_mul(_montgomery* m, uint32_t a,
+        uint32_t b)
+{
+    uint64_t product = (uint64_t) a * b;
+    uint32_t q = (uint32_t) product * m->prime_neg_inverse;
+    uint32_t t = (product + (uint64_t) q * m->prime) >> 32;
+
+    return t >= m->prime ? t - m->prime : t;
+}
+
+static inline uint32_t _to_montgomery(_montgomery* m, uint32_t a)
+{
+    return _montgomery_mul(m, a, m->r_squared);
+}
+
+#ifdef NTT_AVX2
+static inline __m256i _montgomery_mul_avx2(__m256i a, __m256i b,
+        __m256i prime, __m256i prime_neg_inverse)
+{
+    __m256i product_even = _mm256_mul_epu32(a, b);
+    __m256i product_odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32),
+            _mm256_srli_epi64(b, 32));
+
+    __m256i q_even = _mm256_mul_epu32(product_even, prime_neg_inverse);
+    __m256i q_odd = _mm256_mul_epu32(product_odd, prime_neg_inverse);
+
+    __m256i t_even = _mm256_add_epi64(product_even,
+            _mm256_mul_epu32(q_even, prime));
+    __m256i t_odd = _mm256_add_epi64(product_odd,
+            _mm256_mul_epu32(q_odd, prime));
+
+    // The results are the high halves of the 64-bit lanes
+    __m256i t = _mm256_blend_epi32(_mm256_srli_epi64(t_even, 32), t_odd,
+            0xAA);
+
+    return _mm256_min_epu32(t, _mm256_sub_epi32(t, prime));
+}
+
+static inline void _butterfly_dit_avx2(__m256i* a, __m256i* b, __m256i w,
+        __m256i prime, __m256i prime_neg_inverse)
+{
+    __m256i t = _montgomery_mul_avx2(*b, w, prime, prime_neg_inverse);
+
+    __m256i sum = _mm256_add_epi32(*a, t);
+    __m256i difference = _mm256_add_epi32(_mm256_sub_epi32(*a, t), prime);
+
+    *a = _mm256_min_epu32(sum, _mm256_sub_epi32(sum, prime));
+    *b = _mm256_min_epu32(difference,
+            _mm256_sub_epi32(difference, prime));
+}
+
+static inline void _butterfly_dif_avx2(__m256i* a, __m256i* b, __m256i w,
+        __m256i prime, __m256i prime_neg_inverse)
+{
+    __m256i sum = _mm256_add_epi32(*a, *b);
+    __m256i difference = _mm256_add_epi32(_mm256_sub_epi32(*a, *b), prime);
+
+    *a = _mm256_min_epu32(sum, _mm256_sub_epi32(sum, prime));
+    difference = _mm256_min_epu32(difference,
+            _mm256_sub_epi32(difference, prime));
+    *b = _montgomery_mul_avx2(difference, w, prime, prime_neg_inverse);
+}
+#endif
+
+/* Fills the twiddle table for a transform of ``length'' with ``root'' a
+ * primitive length-th root of unity. The stage of half length h reads
+ * root^(j*length/(2h)) for j < h, in Montgomery form, from offset h.
+ *
+ * The last stage's powers are each the product of a power from a short
+ * table of root^j and one from a short table of root^(j*NTT_TWIDDLE_SPLIT),
+ * so the multiplications are independent rather than one long chain, and
+ * the earlier stages take every other one of the stage after them.
+ * */
+#define NTT_TWIDDLE_SPLIT 1024
+
+static void _twiddles(_montgomery* m, uint32_t* twiddles, int length,
+        uint32_t root)
+{
+    if (length < 2){
+        return;
+    }
+
+    int half = length / 2;
+    int split = half < NTT_TWIDDLE_SPLIT ? half : NTT_TWIDDLE_SPLIT;
+
+    uint32_t low[split];
+    uint32_t high[half / split];
+
+    uint32_t step = _to_montgomery(m, root);
+    low[0] = _to_montgomery(m, 1);
+    for(int j=1; j<split; j++){
+        low[j] = _montgomery_mul(m, low[j - 1], step);
+    }
+
+    uint32_t big_step = _montgomery_mul(m, low[split - 1], step);
+    high[0] = low[0];
+    for(int k=1; k<half/split; k++){
+        high[k] = _montgomery_mul(m, high[k - 1], big_step);
+    }
+
+    for(int k=0; k<half/split; k++){
+        for(int j=0; j<split; j++){
+            twiddles[half + k*split + j] =
+                _montgomery_mul(m, high[k], low[j]);
+        }
+    }
+
+    for(half/=2; half>=1; half/=2){
+        for(int j=0; j<half; j++){
+            twiddles[half + j] = twiddles[2*half + 2*j];
+        }
+    }
+}
+
+/* The twiddles of the inverse, from those of the forward transform:
+ * root^-j = root^(2h-j) = -root^(h-j) for the (2h)th root.
+ * */
+static void _inverse_twiddles(_montgomery* m, uint32_t* forward,
+        uint32_t* inverse, int length)
+{
+    for(int half=1; half<length; half*=2){
+        inverse[half] = forward[half];
+        for(int j=1; j<half; j++){
+            inverse[half + j] = m->prime - forward[2*half - j];
+        }
+    }
+}
+
+/* The decimation in frequency stages of half length from ``last'' down
+ * to ``first'', on ``length'' points of ``data''.
+ * */
+static void _stages_dif(_montgomery* m, uint32_t* data, int length,
+        int first, int last, uint32_t* twiddles)
+{
+    uint32_t prime = m->prime;
+
+#ifdef NTT_AVX2
+    __m256i prime_v = _mm256_set1_epi32(prime);
+    __m256i prime_neg_inverse_v = _mm256_set1_epi32(m->prime_neg_inverse);
+#endif
+
+    for(int half=last; half>=first; half/=2){
+        uint32_t* w = twiddles + half;
+
+        for(int g=0; g<length; g+=2*half){
+            uint32_t* x0 = data + g;
+            uint32_t* x1 = x0 + half;
+
+            int j = 0;
+#ifdef NTT_AVX2
+            for(; j+8<=half; j+=8){
+                __m256i a = _mm256_loadu_si256((__m256i*) (x0 + j));
+                __m256i b = _mm256_loadu_si256((__m256i*) (x1 + j));
+                __m256i tw = _mm256_loadu_si256((__m256i*) (w + j));
+
+                _butterfly_dif_avx2(&a, &b, tw, prime_v,
+                        prime_neg_inverse_v);
+
+                _mm256_storeu_si256((__m256i*) (x0 + j), a);
+                _mm256_storeu_si256((__m256i*) (x1 + j), b);
+            }
+#endif
+            for(; j<half; j++){
+                uint32_t sum = x0[j] + x1[j];
+                uint32_t difference = x0[j] - x1[j] + prime;
+
+                // Both are below 2*prime, so one subtraction reduces them
+                x0[j] = sum >= prime ? sum - prime : sum;
+                x1[j] = _montgomery_mul(m, difference >= prime ?
+                        difference - prime : difference, w[j]);
+            }
+        }
+    }
+}
+
+/* The decimation in time stages of half length from ``first'' up to
+ * ``last''.
+ * */
+static void _stages_dit(_montgomery* m, uint32_t* data, int length,
+        int first, int last, uint32_t* twiddles)
+{
+    uint32_t prime = m->prime;
+
+#ifdef NTT_AVX2
+    __m256i prime_v = _mm256_set1_epi32(prime);
+    __m256i prime_neg_inverse_v = _mm256_set1_epi32(m->prime_neg_inverse);
+#endif
+
+    for(int half=first; half<=last; half*=2){
+        uint32_t* w = twiddles + half;
+
+        for(int g=0; g<length; g+=2*half){
+            uint32_t* x0 = data + g;
+            uint32_t* x1 = x0 + half;
+
+            int j = 0;
+#ifdef NTT_AVX2
+            for(; j+8<=half; j+=8){
+                __m256i a = _mm256_loadu_si256((__m256i*) (x0 + j));
+                __m256i b = _mm256_loadu_si256((__m256i*) (x1 + j));
+                __m256i tw = _mm256_loadu_si256((__m256i*) (w + j));
+
+                _butterfly_dit_avx2(&a, &b, tw, prime_v,
+                        prime_neg_inverse_v);
+
+                _mm256_storeu_si256((__m256i*) (x0 + j), a);
+                _mm256_storeu_si256((__m256i*) (x1 + j), b);
+            }
+#endif
+            for(; j<half; j++){
+                uint32_t t = _montgomery_mul(m, x1[j], w[j]);
+                uint32_t sum = x0[j] + t;
+                uint32_t difference = x0[j] - t + prime;
+
+                x0[j] = sum >= prime ? sum - prime : sum;
+                x1[j] = difference >= prime ? difference - prime
+                    : difference;
+            }
+        }
+    }
+}
+
+#ifdef NTT_AVX2
+static inline void _transpose_8x8(__m256i* v)
+{
+    __m256i t[8];
+    for(int i=0; i<8; i+=2){
+        t[i] = _mm256_unpacklo_epi32(v[i], v[i + 1]);
+        t[i + 1] = _mm256_unpackhi_epi32(v[i], v[i + 1]);
+    }
+
+    __m256i u[8];
+    for(int i=0; i<8; i+=4){
+        u[i] = _mm256_unpacklo_epi64(t[i], t[i + 2]);
+        u[i + 1] = _mm256_unpackhi_epi64(t[i], t[i + 2]);
+        u[i + 2] = _mm256_unpacklo_epi64(t[i + 1], t[i + 3]);
+        u[i + 3] = _mm256_unpackhi_epi64(t[i + 1], t[i + 3]);
+    }
+
+    for(int i=0; i<4; i++){
+        v[i] = _mm256_permute2x128_si256(u[i], u[i + 4], 0x20);
+        v[i + 4] = _mm256_permute2x128_si256(u[i], u[i + 4], 0x31);
+    }
+}
+
+/* The stages of half length 1, 2 and 4 work within groups of eight
+ * points, too short for the vectors in the stages above. Eight groups
+ * are loaded and transposed, so that each vector holds the same point of
+ * every group and the butterflies are between whole vectors with the
+ * twiddle broadcast. The twiddles of index 0 are 1; they are still
+ * multiplied by, which keeps the code the same for every butterfly.
+ * */
+static void _short_stages_avx2(_montgomery* m, uint32_t* data, int length,
+        uint32_t* twiddles, int dif)
+{
+    __m256i prime = _mm256_set1_epi32(m->prime);
+    __m256i prime_neg_inverse = _mm256_set1_epi32(m->prime_neg_inverse);
+
+    __m256i w[8];
+    for(int i=1; i<8; i++){
+        w[i] = _mm256_set1_epi32(twiddles[i]);
+    }
+
+    for(int g=0; g<length; g+=64){
+        __m256i v[8];
+        for(int i=0; i<8; i++){
+            v[i] = _mm256_loadu_si256((__m256i*) (data + g + 8*i));
+        }
+        _transpose_8x8(v);
+
+        for(int s=0; s<3; s++){
+            int half = dif ? 4 >> s : 1 << s;
+
+            for(int group=0; group<8; group+=2*half){
+                for(int j=0; j<half; j++){
+                    if (dif){
+                        _butterfly_dif_avx2(&v[group + j],
+                                &v[group + j + half], w[half + j], prime,
+                                prime_neg_inverse);
+                    } else {
+                        _butterfly_dit_avx2(&v[group + j],
+                                &v[group + j + half], w[half + j], prime,
+                                prime_neg_inverse);
+                    }
+                }
+            }
+        }
+
+        _transpose_8x8(v);
+        for(int i=0; i<8; i++){
+            _mm256_storeu_si256((__m256i*) (data + g + 8*i), v[i]);
+        }
+    }
+}
+#endif
+
+/* The stages that fit in a block of NTT_BLOCK_LENGTH points are all done
+ * on one block before moving to the next, so that they run in cache, and
+ * only the other stages pass over the whole transform.
+ * */
+#define NTT_BLOCK_LENGTH 4096
+
+/* Natural order in, bit reversed order out. */
+static void _forward(_montgomery* m, uint32_t* data, int length,
+        uint32_t* twiddles)
+{
+    int block = length < NTT_BLOCK_LENGTH ? length : NTT_BLOCK_LENGTH;
+
+    _stages_dif(m, data, length, block, length/2, twiddles);
+
+    for(int b=0; b<length; b+=block){
+#ifdef NTT_AVX2
+        if (block >= 64){
+            _stages_dif(m, data + b, block, 8, block/2, twiddles);
+            _short_stages_avx2(m, data + b, block, twiddles, 1);
+            continue;
+        }
+#endif
+        _stages_dif(m, data + b, block, 1, block/2, twiddles);
+    }
+}
+
+/* Bit reversed order in, natural order out. */
+static void _inverse(_montgomery* m, uint32_t* data, int length,
+        uint32_t* twiddles)
+{
+    int block = length < NTT_BLOCK_LENGTH ? length : NTT_BLOCK_LENGTH;
+
+    for(int b=0; b<length; b+=block){
+#ifdef NTT_AVX2
+        if (block >= 64){
+            _short_stages_avx2(m, data + b, block, twiddles, 0);
+            _stages_dit(m, data + b, block, 8, block/2, twiddles);
+            continue;
+        }
+#endif
+        _stages_dit(m, data + b, block, 1, block/2, twiddles);
+    }
+
+    _stages_dit(m, data, length, block, length/2, twiddles);
+}
+
+static void _pointwise(_montgomery* m, uint32_t* a, uint32_t* b,
+        int length)
+{
+    int i = 0;
+#ifdef NTT_AVX2
+    __m256i prime_v = _mm256_set1_epi32(m->prime);
+    __m256i prime_neg_inverse_v = _mm256_set1_epi32(m->prime_neg_inverse);
+
+    for(; i+8<=length; i+=8){
+        __m256i x = _mm256_loadu_si256((__m256i*) (a + i));
+        __m256i y = _mm256_loadu_si256((__m256i*) (b + i));
+        _mm256_storeu_si256((__m256i*) (a + i),
+                _montgomery_mul_avx2(x, y, prime_v, prime_neg_inverse_v));
+    }
+#endif
+    for(; i<length; i++){
+        a[i] = _montgomery_mul(m, a[i], b[i]);
+    }
+}
+
+/* ``value'' modulo the prime in Montgomery form, without a division. A
+ * negative value is read as value + 2^32, so R*2^32 = R^2 is taken off
+ * again.
+ * */
+static inline uint32_t _reduce(_montgomery* m, int32_t value)
+{
+    uint32_t r = _montgomery_mul(m, (uint32_t) value, m->r_squared);
+
+    if (value < 0){
+        r = r >= m->r_squared ? r - m->r_squared
+            : r + m->prime - m->r_squared;
+    }
+    return r;
+}
+
+/* The cyclic convolution of a and b, zero padded to ``length'', modulo
+ * each prime in turn, into residues[p*length ...].
+ * */
+static int _cyclic_residues(int32_t* a, int a_length, int32_t* b,
+        int b_length, int length, uint32_t* residues)
+{
+    uint32_t* forward = malloc(length*sizeof(uint32_t));
+    uint32_t* inverse = malloc(length*sizeof(uint32_t));
+    uint32_t* b_transform = malloc(length*sizeof(uint32_t));
+
+    if (forward == NULL || inverse == NULL || b_transform == NULL){
+        free(forward);
+        free(inverse);
+        free(b_transform);
+        return -1;
+    }
+
+    for(int p=0; p<NTT_N_PRIMES; p++){
+        uint32_t prime = _primes[p].prime;
+        uint32_t* a_transform = residues + p*length;
+
+        _montgomery m;
+        _montgomery_init(&m, prime);
+
+        uint32_t root = _pow_mod(_primes[p].generator,
+                (prime - 1) / length, prime);
+        _twiddles(&m, forward, length, root);
+        _inverse_twiddles(&m, forward, inverse, length);
+
+        for(int i=0; i<length; i++){
+            a_transform[i] = i < a_length ? _reduce(&m, a[i]) : 0;
+            b_transform[i] = i < b_length ? _reduce(&m, b[i]) : 0;
+        }
+
+        _forward(&m, a_transform, length, forward);
+        _forward(&m, b_transform, length, forward);
+        _pointwise(&m, a_transform, b_transform, length);
+        _inverse(&m, a_transform, length, inverse);
+
+        /* The inverse left a factor of length, and the data is still in
+         * Montgomery form, so a Montgomery multiplication by a plain
+         * 1/length undoes both.
+         * */
+        uint32_t length_inverse = _pow_mod(length, prime - 2, prime);
+
+        for(int i=0; i<length; i++){
+            a_transform[i] = _montgomery_mul(&m, a_transform[i],
+                    length_inverse);
+        }
+    }
+
+    free(forward);
+    free(inverse);
+    free(b_transform);
+
+    return 0;
+}
+
+/* Garner's form of the Chinese remainder theorem, giving the value in
+ * (-P/2, P/2] that has the three residues, with P the product of the
+ * primes.
+ * */
+typedef struct {
+    // p0^-1 mod p1 and (p0*p1)^-1 mod p2
+    uint64_t p0_inverse_1;
+    uint64_t p01_inverse_2;
+} _garner;
+
+static void _garner_init(_garner* g)
+{
+    uint64_t p0 = _primes[0].prime;
+    uint64_t p1 = _primes[1].prime;
+    uint64_t p2 = _primes[2].prime;
+
+    g->p0_inverse_1 = _pow_mod(p0, p1 - 2, p1);
+    g->p01_inverse_2 = _pow_mod(p0 * p1 % p2, p2 - 2, p2);
+}
+
+static inline int64_t _combine(_garner* g, uint32_t r0, uint32_t r1,
+        uint32_t r2)
+{
+    const uint64_t p0 = _primes[0].prime;
+    const uint64_t p1 = _primes[1].prime;
+    const uint64_t p2 = _primes[2].prime;
+
+    uint64_t x1 = (r1 + p1 - r0 % p1) % p1 * g->p0_inverse_1 % p1;
+    uint64_t x01 = (r0 + x1 * p0) % p2;
+    uint64_t x2 = (r2 + p2 - x01) % p2 * g->p01_inverse_2 % p2;
+
+    unsigned __int128 value = (unsigned __int128) x2 * (p0 * p1)
+        + x1 * p0 + r0;
+    unsigned __int128 product = (unsigned __int128) p0 * p1 * p2;
+
+    if (value > product / 2){
+        return (int64_t) -(__int128) (product - value);
+    }
+    return (int64_t) value;
+}
+
+/* The full convolution of a and b, a_length+b_length-1 long. */
+int ntt_convolve_full(int32_t* a, int a_length, int32_t* b, int b_length,
+        int64_t* out)
+{
+    int out_length = a_length + b_length - 1;
+
+    int length = 1;
+    while (length < out_length){
+        length *= 2;
+    }
+    if (length > (1 << NTT_MAX_LOG2_LENGTH)){
+        return -1;
+    }
+
+    uint32_t* residues = malloc(NTT_N_PRIMES*length*sizeof(uint32_t));
+    if (residues == NULL ||
+            _cyclic_residues(a, a_length, b, b_length, length, residues)){
+        free(residues);
+        return -1;
+    }
+
+    _garner g;
+    _garner_init(&g);
+
+    for(int i=0; i<out_length; i++){
+        out[i] = _combine(&g, residues[i], residues[length + i],
+                residues[2*length + i]);
+    }
+
+    free(residues);
+
+    return 0;
+}
+
+/* The valid part of the convolution, length-kernel_length+1 long, as for
+ * the floating point kernels. The cyclic convolution only wraps into the
+ * first kernel_length-1 outputs, which are not wanted, so the transform
+ * only needs to be as long as the input.
+ * */
+int ntt_convolve(int32_t* in, int64_t* out, int length, int32_t* kernel,
+        int kernel_length)
+{
+    int transform_length = 1;
+    while (transform_length < length){
+        transform_length *= 2;
+    }
+    if (transform_length > (1 << NTT_MAX_LOG2_LENGTH)){
+        return -1;
+    }
+
+    uint32_t* residues = malloc(
+            NTT_N_PRIMES*transform_length*sizeof(uint32_t));
+    if (residues == NULL || _cyclic_residues(in, length, kernel,
+                kernel_length, transform_length, residues)){
+        free(residues);
+        return -1;
+    }
+
+    _garner g;
+    _garner_init(&g);
+
+    for(int i=0; i<length-kernel_length+1; i++){
+        int j = i + kernel_length - 1;
+        out[i] = _combine(&g, residues[j], residues[transform_length + j],
+                residues[2*transform_length + j]);
+    }
+
+    free(residues);
+
+    return 0;
+}
@@ -0,0 +1,333 @@
+/* Copyright (C) 2013 Henry Gomersall <heng@cantab.net> 
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the organization nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY  THE AUTHOR ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+#include "poly.h"
+#include "convolve.h"
+#include "fft.h"
+#include "ntt.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(AVX)
+#define _convolve_row convolve_avx_generic
+#elif defined(SSE3)
+#define _convolve_row convolve_sse_generic
+#elif defined(NEON)
+#define _convolve_row convolve_neon_generic
+#endif
+
+/* Below this many coefficients in the shorter polynomial, the float
+ * product is done by schoolbook multiplication, and below the FFT
+ * threshold by Karatsuba. Measured with AVX.
+ * */
+#define KARATSUBA_MIN_LENGTH 128
+#define FFT_MIN_LENGTH 2048
+
+/* Below this many coefficients in the shorter polynomial, the integer
+ * product is done by schoolbook multiplication rather than by NTT.
+ * */
+#define NTT_MIN_LENGTH 768
+
+/* The schoolbook product is done this many outputs at a time. */
+#define SCHOOLBOOK_CHUNK 4096
+
+/* Polynomial multiplication, picking the method by the size of the
+ * product.
+ *
+ * Schoolbook multiplication is the generic SIMD convolution of the
+ * longer polynomial, zero padded at both ends, with the shorter one. The
+ * padded copy is made a chunk at a time in a buffer on the stack, which
+ * the shorter polynomial being under KARATSUBA_MIN_LENGTH keeps small
+ * however long the longer one is.
+ * Karatsuba splits each polynomial in two and does three half size
+ * products instead of four; a product of very different lengths is cut
+ * into pieces the length of the shorter one first. The FFT product
+ * transforms both with the real FFT of the next power of two that holds
+ * the product.
+ *
+ * Integer products are exact: schoolbook in 64-bit arithmetic for short
+ * polynomials, and the three prime NTT otherwise.
+ * */
+
+static void _schoolbook(float* a, int a_length, float* b, int b_length,
+        float* out)
+{
+    if (a_length < b_length){
+        float* swap = a; a = b; b = swap;
+        int swap_length = a_length; a_length = b_length; b_length = swap_length;
+    }
+
+    int out_length = a_length + b_length - 1;
+    float padded[SCHOOLBOOK_CHUNK + KARATSUBA_MIN_LENGTH - 1];
+
+    for(int offset=0; offset<out_length; offset+=SCHOOLBOOK_CHUNK){
+        int chunk = out_length - offset < SCHOOLBOOK_CHUNK ?
+            out_length - offset : SCHOOLBOOK_CHUNK;
+        int padded_length = chunk + b_length - 1;
+
+        // padded[i] is a[start + i], or zero outside a
+        int start = offset - (b_length - 1);
+        int first = start < 0 ? -start : 0;
+        int last = a_length - start < padded_length ?
+            a_length - start : padded_length;
+
+        memset(padded, 0, first*sizeof(float));
+        memcpy(padded + first, a + start + first,
+                (last - first)*sizeof(float));
+        memset(padded + last, 0, (padded_length - last)*sizeof(float));
+
+        _convolve_row(padded, out + offset, padded_length, b, b_length);
+    }
+}
+
+/* Both polynomials are ``length'' long, and ``out'' is 2*length-1. */
+static void _karatsuba(float* a, float* b, int length, float* out)
+{
+    if (length < KARATSUBA_MIN_LENGTH){
+        _schoolbook(a, length, b, length, out);
+        return;
+    }
+
+    int low = length / 2;
+    int high = length - low;
+
+    // a = a0 + x^low a1, and the same for b
+    float* a0 = a;
+    float* a1 = a + low;
+    float* b0 = b;
+    float* b1 = b + low;
+
+    float a_sum[high];
+    float b_sum[high];
+    for(int i=0; i<high; i++){
+        a_sum[i] = a1[i] + (i < low ? a0[i] : 0.0f);
+        b_sum[i] = b1[i] + (i < low ? b0[i] : 0.0f);
+    }
+
+    float middle[2*high - 1];
+    _karatsuba(a_sum, b_sum, high, middle);
+
+    // The low and high products go straight into place
+    _karatsuba(a0, b0, low, out);
+    out[2*low - 1] = 0.0f;
+    _karatsuba(a1, b1, high, out + 2*low);
+
+    for(int i=0; i<2*low-1; i++){
+        middle[i] -= out[i];
+    }
+    for(int i=0; i<2*high-1; i++){
+        middle[i] -= out[2*low + i];
+    }
+
+    for(int i=0; i<2*high-1; i++){
+        out[low + i] += middle[i];
+    }
+}
+
+/* a is the longer polynomial. It is cut into pieces of b_length, each
+ * multiplied by b with Karatsuba and added in at its offset.
+ * */
+static void _karatsuba_unbalanced(float* a, int a_length, float* b,
+        int b_length, float* out)
+{
+    float piece[b_length];
+    float product[2*b_length - 1];
+
+    memset(out, 0, (a_length + b_length - 1)*sizeof(float));
+
+    for(int offset=0; offset<a_length; offset+=b_length){
+        int piece_length = a_length - offset < b_length ?
+            a_length - offset : b_length;
+
+        memcpy(piece, a + offset, piece_length*sizeof(float));
+        memset(piece + piece_length, 0,
+                (b_length - piece_length)*sizeof(float));
+
+        _karatsuba(piece, b, b_length, product);
+
+        int product_length = piece_length + b_length - 1;
+        for(int i=0; i<product_length; i++){
+            out[offset + i] += product[i];
+        }
+    }
+}
+
+/* The FFT product needs a real plan of the next power of two that holds
+ * the whole product.
+ * */
+static int _fft_length(int a_length, int b_length)
+{
+    int length = 2;
+    while (length < a_length + b_length - 1){
+        length *= 2;
+    }
+    return length;
+}
+
+static int _fft_multiply(fft_real_plan* plan, float* a, int a_length,
+        float* b, int b_length, float* out)
+{
+    int out_length = a_length + b_length - 1;
+    int length = plan->length;
+
+    float* a_spectrum = malloc((length + 2)*sizeof(float));
+    float* b_spectrum = malloc((length + 2)*sizeof(float));
+    if (a_spectrum == NULL || b_spectrum == NULL){
+        free(a_spectrum);
+        free(b_spectrum);
+        return -1;
+    }
+
+    memcpy(a_spectrum, a, a_length*sizeof(float));
+    memset(a_spectrum + a_length, 0, (length - a_length)*sizeof(float));
+    memcpy(b_spectrum, b, b_length*sizeof(float));
+    memset(b_spectrum + b_length, 0, (length - b_length)*sizeof(float));
+
+    fft_real_forward(plan, a_spectrum, a_spectrum);
+    fft_real_forward(plan, b_spectrum, b_spectrum);
+
+    float scale = 1.0f / length;
+    for(int k=0; k<=length/2; k++){
+        float re = a_spectrum[2*k]*b_spectrum[2*k]
+            - a_spectrum[2*k + 1]*b_spectrum[2*k + 1];
+        float im = a_spectrum[2*k]*b_spectrum[2*k + 1]
+            + a_spectrum[2*k + 1]*b_spectrum[2*k];
+        a_spectrum[2*k] = re * scale;
+        a_spectrum[2*k + 1] = im * scale;
+    }
+
+    fft_real_inverse(plan, a_spectrum, a_spectrum);
+    memcpy(out, a_spectrum, out_length*sizeof(float));
+
+    free(a_spectrum);
+    free(b_spectrum);
+
+    return 0;
+}
+
+static int _uses_fft(int a_length, int b_length)
+{
+    return (a_length < b_length ? a_length : b_length) >= FFT_MIN_LENGTH;
+}
+
+/* The product by the method for its size. ``plan'' is only used, and
+ * only needs to be made, when _uses_fft says so.
+ * */
+static int _multiply(float* a, int a_length, float* b, int b_length,
+        float* out, fft_real_plan* plan)
+{
+    if (a_length < b_length){
+        float* swap = a; a = b; b = swap;
+        int swap_length = a_length; a_length = b_length; b_length = swap_length;
+    }
+
+    if (b_length < KARATSUBA_MIN_LENGTH){
+        _schoolbook(a, a_length, b, b_length, out);
+        return 0;
+    }
+
+    if (b_length < FFT_MIN_LENGTH){
+        _karatsuba_unbalanced(a, a_length, b, b_length, out);
+        return 0;
+    }
+
+    return _fft_multiply(plan, a, a_length, b, b_length, out);
+}
+
+/* Returns 0, or -1 if memory for the FFT runs out. */
+int poly_multiply(float* a, int a_length, float* b, int b_length,
+        float* out)
+{
+    if (!_uses_fft(a_length, b_length)){
+        return _multiply(a, a_length, b, b_length, out, NULL);
+    }
+
+    fft_real_plan plan;
+    if (fft_real_plan_init(&plan, _fft_length(a_length, b_length)) != 0){
+        return -1;
+    }
+
+    int failed = _multiply(a, a_length, b, b_length, out, &plan);
+    fft_real_plan_destroy(&plan);
+
+    return failed;
+}
+
+/* Returns 0, or -1 if the product is too long for the NTT. */
+int poly_multiply_int(int32_t* a, int a_length, int32_t* b, int b_length,
+        int64_t* out)
+{
+    int shorter = a_length < b_length ? a_length : b_length;
+
+    if (shorter >= NTT_MIN_LENGTH){
+        return ntt_convolve_full(a, a_length, b, b_length, out);
+    }
+
+    memset(out, 0, (a_length + b_length - 1)*sizeof(int64_t));
+
+    for(int i=0; i<a_length; i++){
+        int64_t a_i = a[i];
+        for(int j=0; j<b_length; j++){
+            out[i + j] += a_i * b[j];
+        }
+    }
+
+    return 0;
+}
+
+/* Many small products at once. Every product is the same size, so they
+ * all use the same method, and for the FFT the one plan is made up front
+ * and shared. The products are split over threads with OpenMP when it
+ * is available.
+ * */
+int poly_multiply_batch(float* a, int a_length, float* b, int b_length,
+        float* out, int n)
+{
+    int out_length = a_length + b_length - 1;
+    int uses_fft = _uses_fft(a_length, b_length);
+    int failed = 0;
+
+    fft_real_plan plan;
+    if (uses_fft && fft_real_plan_init(&plan,
+                _fft_length(a_length, b_length)) != 0){
+        return -1;
+    }
+
+    #pragma omp parallel for reduction(|:failed)
+    for(int i=0; i<n; i++){
+        failed |= _multiply(a + (size_t) i*a_length, a_length,
+                b + (size_t) i*b_length, b_length,
+                out + (size_t) i*out_length, uses_fft ? &plan : NULL);
+    }
+
+    if (uses_fft){
+        fft_real_plan_destroy(&plan);
+    }
+
+    return failed ? -1 : 0;
+}
@@ -105,10 +105,30 @@ functions = [
     'convolve_avx_unrolled_vector_m128_load_multiple',
     'convolve_avx_unrolled_vector_aligned_multiple',
     'convolve_avx_unrolled_vector_local_output_multiple',
-    'convolve_avx_unrolled_vector_partial_aligned_multiple'
+    'convolve_avx_unrolled_vector_partial_aligned_multiple',
+    'convolve_sse_generic_multiple',
+    'convolve_avx_generic_multiple',
+    'convolve_avx512_generic_multiple',
+    'convolve_neon_simple_multiple',
+    'convolve_neon_partial_unroll_multiple',
+    'convolve_neon_unrolled_vector_multiple',
+    'convolve_neon_unrolled_vector_fma_multiple',
+    'convolve_neon_generic_multiple',
+    'convolve_sve_simple_multiple',
 ]
 
-def time_convolutions():
+def built_functions():
+    '''Returns the entries of ``functions`` that are in the library.
+
+    Which kernels are built depends on the SSE3, AVX, AVX512, NEON and SVE
+    defines that CMake sets for the target, so an x86 build has no NEON
+    kernels and an AArch64 build has no SSE or AVX ones.
+    '''
+    lib = numpy.ctypeslib.load_library('libconvolve_funcs', '.')
+
+    return [each for each in functions if hasattr(lib, each)]
+
+def time_convolutions(functions):
     import timeit
 
     def make_setup_script(func):
@@ -159,7 +179,8 @@ def time_convolutions():
 
 if __name__ == '__main__':
 
-    times, flops = time_convolutions()
+    functions = built_functions()
+    times, flops = time_convolutions(functions)
 
     # Chop off each "convolve_"  and "_multiple" from each function name
     function_type = [each[9:-9] for each in functions]
@@ -0,0 +1,366 @@
+/* Copyright (C) 2013 Henry Gomersall <heng@cantab.net> 
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the organization nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY  THE AUTHOR ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+/* Image resizing as a separable polyphase convolution.
+ *
+ * Output sample i sits at (i + 0.5)*scale - 0.5 in the input, with
+ * scale = in_length/out_length, and is the sum of the input samples
+ * around it weighted by the filter at their distance. When shrinking,
+ * the filter is stretched by the scale, so that it also removes what the
+ * output is too coarse to hold. The weights of every output are found
+ * once, in a resample_table, and normalised to sum to 1. Samples past
+ * the ends are the end samples repeated, which is folded into the
+ * weights, so the passes themselves never look outside the input.
+ *
+ * Down the columns, each output row is a weighted sum of input rows,
+ * which is the generic column kernel from convolve_template.h with that
+ * row's weights as the kernel. Along the rows, every output has its own
+ * weights and start, so a vector of rows is interleaved at a time, so
+ * that the same input column of each is one contiguous load, and each
+ * output is then a vector for all the rows at once.
+ *
+ * The pass that shrinks the image the most goes first. Both are split
+ * over threads with OpenMP when it is available.
+ * */
+
+#include "resample.h"
+#include "convolve.h"
+#include "simd.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RESAMPLE_PI 3.14159265358979323846
+
+static double _sinc(double x)
+{
+    if (x == 0.0){
+        return 1.0;
+    }
+    return sin(RESAMPLE_PI*x) / (RESAMPLE_PI*x);
+}
+
+/* The filter at x, and how far either side of 0 it reaches. */
+static double _filter(int filter, double x)
+{
+    x = fabs(x);
+
+    switch(filter){
+        case RESAMPLE_BILINEAR:
+            return x < 1.0 ? 1.0 - x : 0.0;
+        case RESAMPLE_BICUBIC:
+            // Keys' cubic with a = -0.5
+            if (x < 1.0){
+                return (1.5*x - 2.5)*x*x + 1.0;
+            }
+            if (x < 2.0){
+                return ((-0.5*x + 2.5)*x - 4.0)*x + 2.0;
+            }
+            return 0.0;
+        case RESAMPLE_LANCZOS3:
+            return x < 3.0 ? _sinc(x) * _sinc(x/3.0) : 0.0;
+    }
+    return 0.0;
+}
+
+static double _filter_support(int filter)
+{
+    switch(filter){
+        case RESAMPLE_BILINEAR: return 1.0;
+        case RESAMPLE_BICUBIC: return 2.0;
+        case RESAMPLE_LANCZOS3: return 3.0;
+    }
+    return 0.0;
+}
+
+int resample_table_init(resample_table* table, int in_length,
+        int out_length, int filter, float* blur, int blur_length)
+{
+    double support = _filter_support(filter);
+    if (support == 0.0 || in_length < 1 || out_length < 1
+            || (blur != NULL && blur_length < 1)){
+        return -1;
+    }
+    if (blur == NULL){
+        blur_length = 1;
+    }
+
+    double scale = (double) in_length / out_length;
+    double stretch = scale > 1.0 ? scale : 1.0;
+
+    // The filter's taps, before the blur and the ends are folded in
+    int filter_taps = (int) ceil(2*support*stretch) + 1;
+    int padded_taps = filter_taps + blur_length - 1;
+    int taps = padded_taps < in_length ? padded_taps : in_length;
+
+    table->in_length = in_length;
+    table->out_length = out_length;
+    table->taps = taps;
+    table->starts = malloc(out_length*sizeof(int));
+    table->kernels = malloc(out_length*taps*sizeof(float));
+
+    // On the heap, as a big reduction stretches the filter over many taps
+    double* weights = malloc((filter_taps + padded_taps)*sizeof(double));
+
+    if (table->starts == NULL || table->kernels == NULL || weights == NULL){
+        resample_table_destroy(table);
+        free(weights);
+        return -1;
+    }
+
+    double* padded = weights + filter_taps;
+    int blur_centre = (blur_length - 1)/2;
+
+    for(int i=0; i<out_length; i++){
+
+        double centre = (i + 0.5)*scale - 0.5;
+        int first = (int) floor(centre - support*stretch) + 1;
+
+        double sum = 0.0;
+        for(int k=0; k<filter_taps; k++){
+            weights[k] = _filter(filter, (first + k - centre) / stretch);
+            sum += weights[k];
+        }
+
+        // The blur's input sample j feeds the filter's j - offset, with
+        // the blur reversed as a convolution kernel. A filter tap past
+        // the ends reads the blurred end sample, as if the blur had been
+        // done first, so it is moved onto that sample before the blur.
+        for(int k=0; k<padded_taps; k++){
+            padded[k] = 0.0;
+        }
+        for(int k=0; k<filter_taps; k++){
+            int tap = first + k;
+            tap = tap < 0 ? 0 : tap;
+            tap = tap > in_length - 1 ? in_length - 1 : tap;
+
+            for(int b=0; b<blur_length; b++){
+                double blur_weight = blur == NULL ? 1.0
+                    : blur[blur_length - 1 - b];
+                padded[tap - first + b] += weights[k] / sum * blur_weight;
+            }
+        }
+        int padded_first = first - blur_centre;
+
+        // Fold the samples past the ends onto the end samples
+        int start = padded_first;
+        start = start > in_length - taps ? in_length - taps : start;
+        start = start < 0 ? 0 : start;
+        table->starts[i] = start;
+
+        float* kernel = table->kernels + i*taps;
+        for(int k=0; k<taps; k++){
+            kernel[k] = 0.0f;
+        }
+        for(int k=0; k<padded_taps; k++){
+            int j = padded_first + k;
+            j = j < 0 ? 0 : j;
+            j = j > in_length - 1 ? in_length - 1 : j;
+
+            // Reversed, as a convolution kernel
+            kernel[taps - 1 - (j - start)] += padded[k];
+        }
+    }
+
+    free(weights);
+
+    return 0;
+}
+
+void resample_table_destroy(resample_table* table)
+{
+    free(table->starts);
+    free(table->kernels);
+    table->starts = NULL;
+    table->kernels = NULL;
+}
+
+#if defined(SSE3) || defined(NEON)
+
+/* The widest instruction set that is built. */
+#if defined(AVX512)
+#define SIMD_ISA avx512
+#elif defined(AVX)
+#define SIMD_ISA avx
+#elif defined(SSE3)
+#define SIMD_ISA sse
+#else
+#define SIMD_ISA neon
+#endif
+
+/* Resamples each of ``rows'' rows of ``in'' into ``out'' with ``table''.
+ * Returns -1 if the line buffers can't be allocated.
+ * */
+static int _resample_rows(float* in, float* out, int rows,
+        resample_table* table)
+{
+    int in_cols = table->in_length;
+    int out_cols = table->out_length;
+    int taps = table->taps;
+    int failed = 0;
+
+    #pragma omp parallel
+    {
+        float* interleaved = malloc(in_cols*SIMD_WIDTH*sizeof(float));
+        float* results = malloc(out_cols*SIMD_WIDTH*sizeof(float));
+        if (interleaved == NULL || results == NULL){
+            #pragma omp atomic write
+            failed = 1;
+        }
+
+        #pragma omp for
+        for(int row=0; row<rows-SIMD_WIDTH+1; row+=SIMD_WIDTH){
+            if (interleaved == NULL || results == NULL){
+                continue;
+            }
+
+            for(int c=0; c<in_cols; c++){
+                for(int r=0; r<SIMD_WIDTH; r++){
+                    interleaved[c*SIMD_WIDTH + r] = in[(row + r)*in_cols + c];
+                }
+            }
+
+            for(int c=0; c<out_cols; c++){
+                float* kernel = table->kernels + c*taps;
+                float* source = interleaved + table->starts[c]*SIMD_WIDTH;
+
+                SIMD_T acc = SIMD_OP(zero)();
+                for(int k=0; k<taps; k++){
+                    acc = SIMD_OP(fmadd)(SIMD_OP(set1)(kernel[taps - k - 1]),
+                            SIMD_OP(loadu)(source + k*SIMD_WIDTH), acc);
+                }
+                SIMD_OP(storeu)(results + c*SIMD_WIDTH, acc);
+            }
+
+            for(int c=0; c<out_cols; c++){
+                for(int r=0; r<SIMD_WIDTH; r++){
+                    out[(row + r)*out_cols + c] = results[c*SIMD_WIDTH + r];
+                }
+            }
+        }
+
+        free(interleaved);
+        free(results);
+    }
+
+    // The rows that don't fill a vector
+    for(int row=rows - rows % SIMD_WIDTH; row<rows; row++){
+        for(int c=0; c<out_cols; c++){
+            float* kernel = table->kernels + c*taps;
+            float* source = in + row*in_cols + table->starts[c];
+
+            float sum = 0.0f;
+            for(int k=0; k<taps; k++){
+                sum += source[k] * kernel[taps - k - 1];
+            }
+            out[row*out_cols + c] = sum;
+        }
+    }
+
+    return failed ? -1 : 0;
+}
+
+/* Resamples down the columns of ``cols'' wide ``in'' with ``table''. */
+static void _resample_columns(float* in, float* out, int cols,
+        resample_table* table)
+{
+    int taps = table->taps;
+
+    #pragma omp parallel for
+    for(int row=0; row<table->out_length; row++){
+        SIMD_FUNC(columns)(in + table->starts[row]*cols, cols,
+                out + row*cols, cols, table->kernels + row*taps, taps);
+    }
+}
+
+int resample_2d_workspace_length(int in_cols, int in_rows, int out_cols,
+        int out_rows)
+{
+    int rows_first = in_rows*out_cols;
+    int columns_first = out_rows*in_cols;
+    return rows_first > columns_first ? rows_first : columns_first;
+}
+
+int resample_2d_tables(float* in, float* out, float* workspace,
+        int in_cols, int in_rows, resample_table* row_table,
+        resample_table* col_table)
+{
+    int out_cols = row_table->out_length;
+    int out_rows = col_table->out_length;
+
+    if (row_table->in_length != in_cols || col_table->in_length != in_rows){
+        return -1;
+    }
+
+    // The multiply-adds of each order
+    double rows_first = (double) in_rows*out_cols*row_table->taps
+        + (double) out_rows*out_cols*col_table->taps;
+    double columns_first = (double) out_rows*in_cols*col_table->taps
+        + (double) out_rows*out_cols*row_table->taps;
+
+    if (rows_first <= columns_first){
+        if (_resample_rows(in, workspace, in_rows, row_table) != 0){
+            return -1;
+        }
+        _resample_columns(workspace, out, out_cols, col_table);
+    } else {
+        _resample_columns(in, workspace, in_cols, col_table);
+        if (_resample_rows(workspace, out, out_rows, row_table) != 0){
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int resample_2d(float* in, float* out, float* workspace, int in_cols,
+        int in_rows, int out_cols, int out_rows, int filter)
+{
+    resample_table row_table;
+    resample_table col_table;
+
+    if (resample_table_init(&row_table, in_cols, out_cols, filter,
+                NULL, 0) != 0){
+        return -1;
+    }
+    if (resample_table_init(&col_table, in_rows, out_rows, filter,
+                NULL, 0) != 0){
+        resample_table_destroy(&row_table);
+        return -1;
+    }
+
+    int result = resample_2d_tables(in, out, workspace, in_cols, in_rows,
+            &row_table, &col_table);
+
+    resample_table_destroy(&row_table);
+    resample_table_destroy(&col_table);
+
+    return result;
+}
+
+#endif
@@ -0,0 +1,79 @@
+/* Copyright (C) 2013 Henry Gomersall <heng@cantab.net> 
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the organization nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY  THE AUTHOR ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+#ifndef _RESAMPLE_H
+#define _RESAMPLE_H
+
+/* The resampling filters. */
+#define RESAMPLE_BILINEAR 0
+#define RESAMPLE_BICUBIC 1
+#define RESAMPLE_LANCZOS3 2
+
+/* The weights of each output sample of a resampling from in_length to
+ * out_length samples (see resample.c). Output i is
+ *     sum_k in[starts[i] + k] * kernels[i*taps + taps - k - 1]
+ * so each output's weights are a convolution kernel, reversed.
+ * */
+typedef struct {
+    int in_length;
+    int out_length;
+    int taps;
+    int* starts;
+    float* kernels;
+} resample_table;
+
+/* ``blur'', if it is not NULL, is blur_length taps, centred, that are
+ * convolved with the input, its ends repeated, before the resampling,
+ * in the same order as the library's other kernels. It is folded into
+ * the table so that it costs nothing more than a few more taps.
+ *
+ * Returns -1 for an unknown filter, an empty input, output or blur, or
+ * if the table can't be allocated.
+ * */
+int resample_table_init(resample_table* table, int in_length,
+        int out_length, int filter, float* blur, int blur_length);
+
+void resample_table_destroy(resample_table* table);
+
+#if defined(SSE3) || defined(NEON)
+int resample_2d_workspace_length(int in_cols, int in_rows, int out_cols,
+        int out_rows);
+
+/* Resizes in_cols x in_rows to row_table->out_length x
+ * col_table->out_length, with ``row_table'' along the rows and
+ * ``col_table'' down the columns. Returns -1 if the tables don't fit
+ * the input or the line buffers can't be allocated.
+ * */
+int resample_2d_tables(float* in, float* out, float* workspace,
+        int in_cols, int in_rows, resample_table* row_table,
+        resample_table* col_table);
+
+int resample_2d(float* in, float* out, float* workspace, int in_cols,
+        int in_rows, int out_cols, int out_rows, int filter);
+#endif
+
+#endif /* Header guard */
@@ -0,0 +1,284 @@
+/* Copyright (C) 2013 Henry Gomersall <heng@cantab.net> 
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the organization nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY  THE AUTHOR ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+#ifndef _SIMD_H
+#define _SIMD_H
+
+#include "convolve.h"
+
+/* Thin inline wrappers over the float vector of each instruction set.
+ *
+ * Every instruction set provides the same names, simd_<isa>_<op>, so
+ * that an algorithm can be written once against them and instantiated
+ * for each instruction set by including a template file with SIMD_ISA
+ * defined (see convolve_template.h). The available isa prefixes are
+ * sse, avx, avx512 and neon, each only when the matching define is set.
+ *
+ * simd_<isa>_t          the vector type
+ * simd_<isa>_width      the number of floats in the vector
+ * zero, set1, load,     as the usual intrinsics (load needs ``p''
+ * loadu, storeu, add,   aligned to a whole vector)
+ * sub, mul, div, max,
+ * min
+ * load_halves           a load as two aligned loads of half a vector,
+ *                       so ``p'' need only be aligned to half a vector
+ * fmadd(a, b, c)        a * b + c, fused where the hardware allows
+ * hsum, hmax, hmin      horizontal reductions to a float
+ * gt_mask(a, b)         an int with bit i set where lane i of a > b
+ * */
+
+#ifdef SSE3
+typedef __m128 simd_sse_t;
+#define simd_sse_width 4
+
+static inline simd_sse_t simd_sse_zero(void)
+{ return _mm_setzero_ps(); }
+static inline simd_sse_t simd_sse_set1(float a)
+{ return _mm_set1_ps(a); }
+static inline simd_sse_t simd_sse_load(const float* p)
+{ return _mm_load_ps(p); }
+static inline simd_sse_t simd_sse_loadu(const float* p)
+{ return _mm_loadu_ps(p); }
+static inline simd_sse_t simd_sse_load_halves(const float* p)
+{
+    return _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), (const __m64*) p),
+            (const __m64*) (p + 2));
+}
+static inline void simd_sse_storeu(float* p, simd_sse_t a)
+{ _mm_storeu_ps(p, a); }
+static inline simd_sse_t simd_sse_add(simd_sse_t a, simd_sse_t b)
+{ return _mm_add_ps(a, b); }
+static inline simd_sse_t simd_sse_sub(simd_sse_t a, simd_sse_t b)
+{ return _mm_sub_ps(a, b); }
+static inline simd_sse_t simd_sse_mul(simd_sse_t a, simd_sse_t b)
+{ return _mm_mul_ps(a, b); }
+static inline simd_sse_t simd_sse_div(simd_sse_t a, simd_sse_t b)
+{ return _mm_div_ps(a, b); }
+static inline simd_sse_t simd_sse_max(simd_sse_t a, simd_sse_t b)
+{ return _mm_max_ps(a, b); }
+static inline simd_sse_t simd_sse_min(simd_sse_t a, simd_sse_t b)
+{ return _mm_min_ps(a, b); }
+
+// SSE has no FMA, so this is always a separate multiply and add
+static inline simd_sse_t simd_sse_fmadd(simd_sse_t a, simd_sse_t b,
+        simd_sse_t c)
+{ return _mm_add_ps(_mm_mul_ps(a, b), c); }
+
+static inline float simd_sse_hsum(simd_sse_t a)
+{
+    a = _mm_hadd_ps(a, a);
+    a = _mm_hadd_ps(a, a);
+    return _mm_cvtss_f32(a);
+}
+static inline float simd_sse_hmax(simd_sse_t a)
+{
+    a = _mm_max_ps(a, _mm_movehl_ps(a, a));
+    a = _mm_max_ss(a, _mm_shuffle_ps(a, a, 1));
+    return _mm_cvtss_f32(a);
+}
+static inline float simd_sse_hmin(simd_sse_t a)
+{
+    a = _mm_min_ps(a, _mm_movehl_ps(a, a));
+    a = _mm_min_ss(a, _mm_shuffle_ps(a, a, 1));
+    return _mm_cvtss_f32(a);
+}
+static inline int simd_sse_gt_mask(simd_sse_t a, simd_sse_t b)
+{ return _mm_movemask_ps(_mm_cmpgt_ps(a, b)); }
+#endif
+
+#ifdef AVX
+typedef __m256 simd_avx_t;
+#define simd_avx_width 8
+
+static inline simd_avx_t simd_avx_zero(void)
+{ return _mm256_setzero_ps(); }
+static inline simd_avx_t simd_avx_set1(float a)
+{ return _mm256_set1_ps(a); }
+static inline simd_avx_t simd_avx_load(const float* p)
+{ return _mm256_load_ps(p); }
+static inline simd_avx_t simd_avx_loadu(const float* p)
+{ return _mm256_loadu_ps(p); }
+static inline simd_avx_t simd_avx_load_halves(const float* p)
+{
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_load_ps(p)),
+            _mm_load_ps(p + 4), 1);
+}
+static inline void simd_avx_storeu(float* p, simd_avx_t a)
+{ _mm256_storeu_ps(p, a); }
+static inline simd_avx_t simd_avx_add(simd_avx_t a, simd_avx_t b)
+{ return _mm256_add_ps(a, b); }
+static inline simd_avx_t simd_avx_sub(simd_avx_t a, simd_avx_t b)
+{ return _mm256_sub_ps(a, b); }
+static inline simd_avx_t simd_avx_mul(simd_avx_t a, simd_avx_t b)
+{ return _mm256_mul_ps(a, b); }
+static inline simd_avx_t simd_avx_div(simd_avx_t a, simd_avx_t b)
+{ return _mm256_div_ps(a, b); }
+static inline simd_avx_t simd_avx_max(simd_avx_t a, simd_avx_t b)
+{ return _mm256_max_ps(a, b); }
+static inline simd_avx_t simd_avx_min(simd_avx_t a, simd_avx_t b)
+{ return _mm256_min_ps(a, b); }
+
+static inline simd_avx_t simd_avx_fmadd(simd_avx_t a, simd_avx_t b,
+        simd_avx_t c)
+{
+#ifdef __FMA__
+    return _mm256_fmadd_ps(a, b, c);
+#else
+    return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+}
+
+static inline float simd_avx_hsum(simd_avx_t a)
+{
+    return simd_sse_hsum(_mm_add_ps(_mm256_castps256_ps128(a),
+                _mm256_extractf128_ps(a, 1)));
+}
+static inline float simd_avx_hmax(simd_avx_t a)
+{
+    return simd_sse_hmax(_mm_max_ps(_mm256_castps256_ps128(a),
+                _mm256_extractf128_ps(a, 1)));
+}
+static inline float simd_avx_hmin(simd_avx_t a)
+{
+    return simd_sse_hmin(_mm_min_ps(_mm256_castps256_ps128(a),
+                _mm256_extractf128_ps(a, 1)));
+}
+static inline int simd_avx_gt_mask(simd_avx_t a, simd_avx_t b)
+{ return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GT_OQ)); }
+#endif
+
+#ifdef AVX512
+typedef __m512 simd_avx512_t;
+#define simd_avx512_width 16
+
+static inline simd_avx512_t simd_avx512_zero(void)
+{ return _mm512_setzero_ps(); }
+static inline simd_avx512_t simd_avx512_set1(float a)
+{ return _mm512_set1_ps(a); }
+static inline simd_avx512_t simd_avx512_load(const float* p)
+{ return _mm512_load_ps(p); }
+static inline simd_avx512_t simd_avx512_loadu(const float* p)
+{ return _mm512_loadu_ps(p); }
+static inline simd_avx512_t simd_avx512_load_halves(const float* p)
+{
+    return _mm512_castpd_ps(_mm512_insertf64x4(
+                _mm512_castps_pd(_mm512_castps256_ps512(_mm256_load_ps(p))),
+                _mm256_castps_pd(_mm256_load_ps(p + 8)), 1));
+}
+static inline void simd_avx512_storeu(float* p, simd_avx512_t a)
+{ _mm512_storeu_ps(p, a); }
+static inline simd_avx512_t simd_avx512_add(simd_avx512_t a,
+        simd_avx512_t b)
+{ return _mm512_add_ps(a, b); }
+static inline simd_avx512_t simd_avx512_sub(simd_avx512_t a,
+        simd_avx512_t b)
+{ return _mm512_sub_ps(a, b); }
+static inline simd_avx512_t simd_avx512_mul(simd_avx512_t a,
+        simd_avx512_t b)
+{ return _mm512_mul_ps(a, b); }
+static inline simd_avx512_t simd_avx512_div(simd_avx512_t a,
+        simd_avx512_t b)
+{ return _mm512_div_ps(a, b); }
+static inline simd_avx512_t simd_avx512_max(simd_avx512_t a,
+        simd_avx512_t b)
+{ return _mm512_max_ps(a, b); }
+static inline simd_avx512_t simd_avx512_min(simd_avx512_t a,
+        simd_avx512_t b)
+{ return _mm512_min_ps(a, b); }
+static inline simd_avx512_t simd_avx512_fmadd(simd_avx512_t a,
+        simd_avx512_t b, simd_avx512_t c)
+{ return _mm512_fmadd_ps(a, b, c); }
+static inline float simd_avx512_hsum(simd_avx512_t a)
+{ return _mm512_reduce_add_ps(a); }
+static inline float simd_avx512_hmax(simd_avx512_t a)
+{ return _mm512_reduce_max_ps(a); }
+static inline float simd_avx512_hmin(simd_avx512_t a)
+{ return _mm512_reduce_min_ps(a); }
+static inline int simd_avx512_gt_mask(simd_avx512_t a, simd_avx512_t b)
+{ return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+#endif
+
+#ifdef NEON
+typedef float32x4_t simd_neon_t;
+#define simd_neon_width 4
+
+static inline simd_neon_t simd_neon_zero(void)
+{ return vdupq_n_f32(0.0f); }
+static inline simd_neon_t simd_neon_set1(float a)
+{ return vdupq_n_f32(a); }
+// NEON loads have no aligned form, so load is the same as loadu
+static inline simd_neon_t simd_neon_load(const float* p)
+{ return vld1q_f32(p); }
+static inline simd_neon_t simd_neon_loadu(const float* p)
+{ return vld1q_f32(p); }
+static inline simd_neon_t simd_neon_load_halves(const float* p)
+{ return vcombine_f32(vld1_f32(p), vld1_f32(p + 2)); }
+static inline void simd_neon_storeu(float* p, simd_neon_t a)
+{ vst1q_f32(p, a); }
+static inline simd_neon_t simd_neon_add(simd_neon_t a, simd_neon_t b)
+{ return vaddq_f32(a, b); }
+static inline simd_neon_t simd_neon_sub(simd_neon_t a, simd_neon_t b)
+{ return vsubq_f32(a, b); }
+static inline simd_neon_t simd_neon_mul(simd_neon_t a, simd_neon_t b)
+{ return vmulq_f32(a, b); }
+static inline simd_neon_t simd_neon_div(simd_neon_t a, simd_neon_t b)
+{ return vdivq_f32(a, b); }
+static inline simd_neon_t simd_neon_max(simd_neon_t a, simd_neon_t b)
+{ return vmaxq_f32(a, b); }
+static inline simd_neon_t simd_neon_min(simd_neon_t a, simd_neon_t b)
+{ return vminq_f32(a, b); }
+static inline simd_neon_t simd_neon_fmadd(simd_neon_t a, simd_neon_t b,
+        simd_neon_t c)
+{ return vfmaq_f32(c, a, b); }
+static inline float simd_neon_hsum(simd_neon_t a)
+{ return vaddvq_f32(a); }
+static inline float simd_neon_hmax(simd_neon_t a)
+{ return vmaxvq_f32(a); }
+static inline float simd_neon_hmin(simd_neon_t a)
+{ return vminvq_f32(a); }
+static inline int simd_neon_gt_mask(simd_neon_t a, simd_neon_t b)
+{
+    static const uint32_t bits[4] = {1, 2, 4, 8};
+    return vaddvq_u32(vandq_u32(vcgtq_f32(a, b), vld1q_u32(bits)));
+}
+#endif
+
+/* Helpers for the template files. With SIMD_ISA defined as, say, sse:
+ *     SIMD_T          -> simd_sse_t
+ *     SIMD_WIDTH      -> simd_sse_width
+ *     SIMD_OP(add)    -> simd_sse_add
+ *     SIMD_FUNC(generic) -> convolve_sse_generic
+ * */
+#define _SIMD_PASTE(a, b, c) a ## _ ## b ## _ ## c
+#define _SIMD_NAME(a, b, c) _SIMD_PASTE(a, b, c)
+
+#define SIMD_T _SIMD_NAME(simd, SIMD_ISA, t)
+#define SIMD_WIDTH _SIMD_NAME(simd, SIMD_ISA, width)
+#define SIMD_OP(OP) _SIMD_NAME(simd, SIMD_ISA, OP)
+#define SIMD_FUNC(NAME) _SIMD_NAME(convolve, SIMD_ISA, NAME)
+
+#endif /*Header guard*/
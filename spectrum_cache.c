@@ -0,0 +1,215 @@
+/* Copyright (C) 2013 Henry Gomersall <heng@cantab.net> 
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the organization nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY  THE AUTHOR ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+/* posix_memalign */
+#define _POSIX_C_SOURCE 200112L
+
+#include "spectrum_cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Spectra are aligned for the widest vector loads we build for. */
+#define SPECTRUM_CACHE_ALIGNMENT 64
+
+/* A cache of kernel spectra for the FFT convolutions, which otherwise
+ * transform the same few kernels for every signal.
+ *
+ * Entries are keyed by the kernel contents and the transform length. The
+ * contents are hashed with 64-bit FNV-1a over the raw bytes to find
+ * candidates quickly, and a copy of the kernel is kept and compared so
+ * that a hash collision can never return the wrong spectrum. Only a
+ * handful of kernels are expected, so the entries are a plain list in
+ * order of use, newest first, and the search is linear.
+ *
+ * The cache holds at most byte_budget bytes of kernels and spectra. Once
+ * a miss has made and transformed its new entry, it evicts the least
+ * recently used entries until the new one fits; an
+ * entry bigger than the whole budget is still kept, on its own, so that
+ * the pointer returned is always valid.
+ *
+ * The pointer returned by spectrum_cache_get is only valid until the
+ * next call on the same cache, which may evict it. The cache does no
+ * locking, so each thread should use its own.
+ * */
+
+uint64_t spectrum_cache_hash(float* kernel, int kernel_length)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    unsigned char* bytes = (unsigned char*) kernel;
+
+    for(size_t i=0; i<kernel_length*sizeof(float); i++){
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+int spectrum_cache_init(spectrum_cache* cache, size_t byte_budget)
+{
+    cache->byte_budget = byte_budget;
+    cache->bytes = 0;
+    cache->entries = 0;
+    cache->newest = NULL;
+    cache->oldest = NULL;
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->evictions = 0;
+
+    return 0;
+}
+
+static void _unlink(spectrum_cache* cache, spectrum_cache_entry* entry)
+{
+    if (entry->newer) entry->newer->older = entry->older;
+    else cache->newest = entry->older;
+
+    if (entry->older) entry->older->newer = entry->newer;
+    else cache->oldest = entry->newer;
+}
+
+static void _push_newest(spectrum_cache* cache, spectrum_cache_entry* entry)
+{
+    entry->newer = NULL;
+    entry->older = cache->newest;
+
+    if (cache->newest) cache->newest->newer = entry;
+    else cache->oldest = entry;
+
+    cache->newest = entry;
+}
+
+static void _free_entry(spectrum_cache* cache, spectrum_cache_entry* entry)
+{
+    _unlink(cache, entry);
+    cache->bytes -= entry->bytes;
+    cache->entries--;
+
+    free(entry->kernel);
+    free(entry->spectrum);
+    free(entry);
+}
+
+/* Frees every entry. The cache can still be used afterwards. */
+int spectrum_cache_clear(spectrum_cache* cache)
+{
+    while (cache->oldest){
+        _free_entry(cache, cache->oldest);
+    }
+
+    return 0;
+}
+
+/* Returns the spectrum of ``kernel'' for a transform of transform_length,
+ * calling ``transform'' to compute it on a miss. Returns NULL if the
+ * memory for a new entry cannot be allocated or the transform fails, and
+ * then nothing is added or evicted.
+ * */
+float* spectrum_cache_get(spectrum_cache* cache, float* kernel,
+        int kernel_length, int transform_length, int spectrum_length,
+        spectrum_cache_transform transform, void* context)
+{
+    uint64_t hash = spectrum_cache_hash(kernel, kernel_length);
+
+    for(spectrum_cache_entry* entry = cache->newest; entry != NULL;
+            entry = entry->older){
+
+        if (entry->hash == hash
+                && entry->kernel_length == kernel_length
+                && entry->transform_length == transform_length
+                && entry->spectrum_length == spectrum_length
+                && memcmp(entry->kernel, kernel,
+                    kernel_length*sizeof(float)) == 0){
+
+            _unlink(cache, entry);
+            _push_newest(cache, entry);
+            cache->hits++;
+
+            return entry->spectrum;
+        }
+    }
+
+    cache->misses++;
+
+    size_t bytes = (kernel_length + spectrum_length)*sizeof(float);
+
+    spectrum_cache_entry* entry = malloc(sizeof(spectrum_cache_entry));
+    if (entry == NULL){
+        return NULL;
+    }
+
+    entry->kernel = malloc(kernel_length*sizeof(float));
+    if (entry->kernel == NULL
+            || posix_memalign((void**) &entry->spectrum,
+                SPECTRUM_CACHE_ALIGNMENT,
+                spectrum_length*sizeof(float)) != 0){
+        free(entry->kernel);
+        free(entry);
+        return NULL;
+    }
+
+    if (transform(kernel, kernel_length, transform_length, entry->spectrum,
+                context) != 0){
+        free(entry->kernel);
+        free(entry->spectrum);
+        free(entry);
+        return NULL;
+    }
+
+    memcpy(entry->kernel, kernel, kernel_length*sizeof(float));
+
+    entry->hash = hash;
+    entry->kernel_length = kernel_length;
+    entry->transform_length = transform_length;
+    entry->spectrum_length = spectrum_length;
+    entry->bytes = bytes;
+
+    // Only now that the entry is made, so a failed miss evicts nothing
+    while (cache->oldest && cache->bytes + bytes > cache->byte_budget){
+        _free_entry(cache, cache->oldest);
+        cache->evictions++;
+    }
+
+    _push_newest(cache, entry);
+    cache->bytes += bytes;
+    cache->entries++;
+
+    return entry->spectrum;
+}
+
+int spectrum_cache_get_stats(spectrum_cache* cache,
+        spectrum_cache_stats* stats)
+{
+    stats->hits = cache->hits;
+    stats->misses = cache->misses;
+    stats->evictions = cache->evictions;
+    stats->entries = cache->entries;
+    stats->bytes = cache->bytes;
+
+    return 0;
+}
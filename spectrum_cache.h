@@ -0,0 +1,89 @@
+/* Copyright (C) 2013 Henry Gomersall <heng@cantab.net> 
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the organization nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY  THE AUTHOR ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+#ifndef _SPECTRUM_CACHE_H
+#define _SPECTRUM_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Computes the spectrum of ``kernel'' for a transform of
+ * transform_length into ``spectrum'', which is spectrum_length floats.
+ * ``context'' is passed through from spectrum_cache_get, for instance
+ * to carry a transform plan. Returns 0, or -1 if the spectrum could not
+ * be computed.
+ * */
+typedef int (*spectrum_cache_transform)(float* kernel, int kernel_length,
+        int transform_length, float* spectrum, void* context);
+
+typedef struct spectrum_cache_entry {
+    uint64_t hash;
+    int kernel_length;
+    int transform_length;
+    int spectrum_length;
+    size_t bytes;
+    float* kernel;
+    float* spectrum;
+    struct spectrum_cache_entry* newer;
+    struct spectrum_cache_entry* older;
+} spectrum_cache_entry;
+
+/* A least recently used cache of kernel spectra (see spectrum_cache.c).
+ * */
+typedef struct {
+    size_t byte_budget;
+    size_t bytes;
+    int entries;
+    spectrum_cache_entry* newest;
+    spectrum_cache_entry* oldest;
+    long hits;
+    long misses;
+    long evictions;
+} spectrum_cache;
+
+typedef struct {
+    long hits;
+    long misses;
+    long evictions;
+    int entries;
+    size_t bytes;
+} spectrum_cache_stats;
+
+int spectrum_cache_init(spectrum_cache* cache, size_t byte_budget);
+
+int spectrum_cache_clear(spectrum_cache* cache);
+
+float* spectrum_cache_get(spectrum_cache* cache, float* kernel,
+        int kernel_length, int transform_length, int spectrum_length,
+        spectrum_cache_transform transform, void* context);
+
+int spectrum_cache_get_stats(spectrum_cache* cache,
+        spectrum_cache_stats* stats);
+
+uint64_t spectrum_cache_hash(float* kernel, int kernel_length);
+
+#endif /* Header guard */
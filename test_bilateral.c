@@ -0,0 +1,237 @@
+/* Copyright (C) 2012 Henry Gomersall <heng@cantab.net> 
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the organization nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY  THE AUTHOR ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "bilateral.h"
+
+#ifdef SSE3
+
+/* The bilateral filter of ``in'' over the window, straight from its
+ * definition.
+ * */
+void reference_bilateral(float* in, float* out, int cols, int rows,
+        int radius, float sigma_space, float sigma_range)
+{
+    int out_cols = cols - 2*radius;
+    int out_rows = rows - 2*radius;
+
+    for (int row=0; row<out_rows; row++){
+        for (int col=0; col<out_cols; col++){
+            float centre = in[(row + radius)*cols + col + radius];
+            double sum = 0.0;
+            double total_weight = 0.0;
+
+            for (int dy=-radius; dy<=radius; dy++){
+                for (int dx=-radius; dx<=radius; dx++){
+                    float value = in[(row + radius + dy)*cols
+                        + col + radius + dx];
+                    float diff = value - centre;
+                    double weight = expf(
+                            -(dx*dx + dy*dy)/(2*sigma_space*sigma_space)
+                            - diff*diff/(2*sigma_range*sigma_range));
+
+                    sum += weight*value;
+                    total_weight += weight;
+                }
+            }
+            out[row*out_cols + col] = sum / total_weight;
+        }
+    }
+}
+
+/* The largest difference between ``a'' and ``b''. */
+float max_error(float* a, float* b, int length)
+{
+    float error = 0.0f;
+    for (int i=0; i<length; i++){
+        // Written so that a NaN is the largest error
+        if (!(fabsf(a[i] - b[i]) <= error)){
+            error = isnan(a[i] - b[i]) ? INFINITY : fabsf(a[i] - b[i]);
+        }
+    }
+    return error;
+}
+
+/* The direct path, at every radius it takes, against the reference on
+ * noise with edges in it. Its weights are within 1.1e-3 of the
+ * exponential, so the outputs of a unit range image are within a few
+ * thousandths.
+ * */
+int check_direct()
+{
+    int cols = 67;
+    int rows = 45;
+    float* in = malloc(sizeof(float)*cols*rows);
+    float* out = malloc(sizeof(float)*cols*rows);
+    float* expected = malloc(sizeof(float)*cols*rows);
+
+    for (int i=0; i<cols*rows; i++){
+        float step = (i % cols) < cols/2 ? 0.0f : 0.7f;
+        in[i] = step + 0.3f*((float) rand() / RAND_MAX);
+    }
+
+    int failed = 0;
+
+    for (int radius=0; radius<=4; radius++){
+        int out_length = (cols - 2*radius)*(rows - 2*radius);
+        float sigma_space = 0.5f + radius;
+
+        reference_bilateral(in, expected, cols, rows, radius, sigma_space,
+                0.2f);
+        int wrong = convolve_sse_2d_bilateral(in, out, cols, rows, radius,
+                sigma_space, 0.2f) != 0;
+        float error = max_error(out, expected, out_length);
+
+        if (wrong || error > 4e-3f){
+            printf("The direct bilateral filter of radius %d is off by "
+                    "%g.\n", radius, error);
+            failed = -1;
+        }
+    }
+
+    free(in);
+    free(out);
+    free(expected);
+
+    return failed;
+}
+
+/* The grid path against the reference on a smooth image, where the
+ * grid's coarse sampling costs little: within 2% of the image's range.
+ * */
+int check_grid()
+{
+    int cols = 150;
+    int rows = 110;
+    float* in = malloc(sizeof(float)*cols*rows);
+    float* out = malloc(sizeof(float)*cols*rows);
+    float* expected = malloc(sizeof(float)*cols*rows);
+
+    for (int row=0; row<rows; row++){
+        for (int col=0; col<cols; col++){
+            in[row*cols + col] = sinf(col*0.05f) * cosf(row*0.04f);
+        }
+    }
+
+    int failed = 0;
+    int radii[] = {5, 8, 12};
+
+    for (int r=0; r<3; r++){
+        int radius = radii[r];
+        int out_length = (cols - 2*radius)*(rows - 2*radius);
+        float sigma_space = radius/2.0f;
+
+        reference_bilateral(in, expected, cols, rows, radius, sigma_space,
+                0.3f);
+        int wrong = convolve_sse_2d_bilateral(in, out, cols, rows, radius,
+                sigma_space, 0.3f) != 0;
+        float error = max_error(out, expected, out_length);
+
+        if (wrong || error > 0.04f){
+            printf("The bilateral grid of radius %d is off by %g.\n",
+                    radius, error);
+            failed = -1;
+        }
+    }
+
+    free(in);
+    free(out);
+    free(expected);
+
+    return failed;
+}
+
+/* A range that 1/sigma_range doesn't divide exactly, where the highest
+ * value once rounded into a slice past the grid, and the arguments the
+ * filter refuses.
+ * */
+int check_edges()
+{
+    int cols = 32;
+    int rows = 32;
+    float in[cols*rows];
+    float out[cols*rows];
+
+    for (int i=0; i<cols*rows; i++){
+        in[i] = i % 76;
+    }
+
+    int failed = 0;
+    int radius = 5;
+    int out_cols = cols - 2*radius;
+    int wrong = convolve_sse_2d_bilateral(in, out, cols, rows, radius,
+            3.0f, 0.15f) != 0;
+
+    for (int row=0; row<rows - 2*radius; row++){
+        for (int col=0; col<out_cols; col++){
+            float value = out[row*out_cols + col];
+            wrong |= !(value >= 0.0f && value <= 75.0f);
+        }
+    }
+
+    if (wrong){
+        printf("The bilateral grid is wrong at the top of its range.\n");
+        failed = -1;
+    }
+
+    if (convolve_sse_2d_bilateral(in, out, cols, rows, -1, 1.0f, 1.0f) != -1
+            || convolve_sse_2d_bilateral(in, out, cols, rows, 2, 0.0f,
+                1.0f) != -1
+            || convolve_sse_2d_bilateral(in, out, cols, rows, 2, 1.0f,
+                NAN) != -1){
+        printf("The bilateral filter took arguments it should refuse.\n");
+        failed = -1;
+    }
+
+    return failed;
+}
+
+#endif
+
+int main()
+{
+    srand(0);
+
+    int failed = 0;
+
+#ifdef SSE3
+    failed |= check_direct();
+    failed |= check_grid();
+    failed |= check_edges();
+#endif
+
+    if (failed){
+        return -1;
+    }
+
+    printf("Bilateral filters are valid.\n");
+
+    return 0;
+}
@@ -26,6 +26,8 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include <glib.h>
 #include <sys/time.h>
 
@@ -55,63 +57,1414 @@ long time_delta(struct timeval* now, struct timeval* then)
     return delta;
 }
 
+void random_fill(float* data, int length)
+{
+    for (int i=0; i<length; i++){
+        data[i] = ((float) rand() / RAND_MAX) - 0.5f;
+    }
+}
+
+/* The 1D convolution straight from its definition, in double precision. */
+void reference_1d(float* in, double* out, int length, float* kernel,
+        int kernel_length)
+{
+    for (int i=0; i<=length-kernel_length; i++){
+        out[i] = 0.0;
+        for (int k=0; k<kernel_length; k++){
+            out[i] += (double) in[i+k] * kernel[kernel_length - k - 1];
+        }
+    }
+}
+
+/* The separable 2D convolution straight from its definition, in double
+ * precision: ``row_kernel'' along the rows and ``col_kernel'' down the
+ * columns of the cols x rows image ``in'', whose rows are ``pitch''
+ * floats apart. ``out'' is packed.
+ * */
+void reference_2d(float* in, int pitch, double* out, int cols, int rows,
+        float* row_kernel, int row_length, float* col_kernel,
+        int col_length)
+{
+    int out_cols = cols - row_length + 1;
+    int out_rows = rows - col_length + 1;
+
+    for (int row=0; row<out_rows; row++){
+        for (int col=0; col<out_cols; col++){
+            double sum = 0.0;
+            for (int i=0; i<col_length; i++){
+                for (int j=0; j<row_length; j++){
+                    sum += (double) in[(row + i)*pitch + col + j] *
+                        col_kernel[col_length - i - 1] *
+                        row_kernel[row_length - j - 1];
+                }
+            }
+            out[row*out_cols + col] = sum;
+        }
+    }
+}
+
+/* The largest difference between ``test'' and ``reference'', which are
+ * cols x rows with rows ``pitch'' floats apart in ``test''.
+ * */
+double max_error(float* test, int pitch, double* reference, int cols,
+        int rows)
+{
+    double error = 0.0;
+
+    for (int row=0; row<rows; row++){
+        for (int col=0; col<cols; col++){
+            error = fmax(error, 
+                    fabs(test[row*pitch + col] - reference[row*cols + col]));
+        }
+    }
+
+    return error;
+}
+
+int check(const char* name, double error)
+{
+    if (error > 1e-4){
+        printf("%s is incorrect (error %g).\n", name, error);
+        return -1;
+    }
+    return 0;
+}
+
+/* Every 1D kernel that is built is checked against the reference output.
+ * Which ones exist depends on the instruction set defines.
+ * */
+int check_1d_kernels()
+{
+    struct {
+        const char* name;
+        int (*function)(float*, float*, int, float*, int);
+    } kernels[] = {
+        {"naive", convolve_naive},
+        {"reversed naive", convolve_reversed_naive},
+#ifdef SSE3
+        {"sse simple", convolve_sse_simple},
+        {"sse partial unroll", convolve_sse_partial_unroll},
+        {"sse in aligned", convolve_sse_in_aligned},
+        {"sse in aligned fixed kernel", 
+            convolve_sse_in_aligned_fixed_kernel},
+        {"sse unrolled avx vector", convolve_sse_unrolled_avx_vector},
+        {"sse unrolled vector", convolve_sse_unrolled_vector},
+        {"sse generic", convolve_sse_generic},
+#endif
+#ifdef AVX
+        {"avx unrolled vector", convolve_avx_unrolled_vector},
+        {"avx unrolled vector unaligned", 
+            convolve_avx_unrolled_vector_unaligned},
+        {"avx unrolled vector unaligned fma", 
+            convolve_avx_unrolled_vector_unaligned_fma},
+        {"avx unrolled vector m128 load", 
+            convolve_avx_unrolled_vector_m128_load},
+        {"avx unrolled vector aligned", 
+            convolve_avx_unrolled_vector_aligned},
+        {"avx unrolled vector partial aligned", 
+            convolve_avx_unrolled_vector_partial_aligned},
+        {"avx unrolled vector local output", 
+            convolve_avx_unrolled_vector_local_output},
+        {"avx generic", convolve_avx_generic},
+#endif
+#ifdef AVX512
+        {"avx512 generic", convolve_avx512_generic},
+#endif
+#ifdef NEON
+        {"neon simple", convolve_neon_simple},
+        {"neon partial unroll", convolve_neon_partial_unroll},
+        {"neon unrolled vector", convolve_neon_unrolled_vector},
+        {"neon unrolled vector fma", convolve_neon_unrolled_vector_fma},
+        {"neon generic", convolve_neon_generic},
+#endif
+#ifdef SVE
+        {"sve simple", convolve_sve_simple},
+#endif
+    };
+    int n_kernels = sizeof(kernels)/sizeof(kernels[0]);
+
+    float test_output[INPUT_LENGTH-KERNEL_LENGTH+1];
+
+    for (int n=0; n<n_kernels; n++){
+
+        kernels[n].function(INPUT_ARRAY, test_output, INPUT_LENGTH, 
+                KERNEL, KERNEL_LENGTH);
+
+        for (int i=0; i<(INPUT_LENGTH-KERNEL_LENGTH+1); i++){
+            float error = TEST_OUTPUT_CORRECT[i] - test_output[i];
+
+            if (error > 1e-4 || error < -1e-4){
+                printf("The %s convolution is incorrect.\n", 
+                        kernels[n].name);
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/* The generic kernels and the separable 2D convolution run in place
+ * must give the same as out of place.
+ * */
+int check_in_place()
+{
+    struct {
+        const char* name;
+        int (*function)(float*, float*, int, float*, int);
+    } kernels[] = {
+#ifdef SSE3
+        {"sse generic", convolve_sse_generic},
+#endif
+#ifdef AVX
+        {"avx generic", convolve_avx_generic},
+#endif
+#ifdef AVX512
+        {"avx512 generic", convolve_avx512_generic},
+#endif
+#ifdef NEON
+        {"neon generic", convolve_neon_generic},
+#endif
+    };
+    int n_kernels = sizeof(kernels)/sizeof(kernels[0]);
+
+    int lengths[] = {1, 3, 5, 7, 9, 13, 16, 33};
+    int n_lengths = sizeof(lengths)/sizeof(lengths[0]);
+
+    int failed = 0;
+
+    float in[1000];
+    float out[1000];
+    float data[1000];
+    float kernel[33];
+    random_fill(in, 1000);
+
+    for (int n=0; n<n_kernels; n++){
+        for (int l=0; l<n_lengths; l++){
+            for (int length=lengths[l]; length<1000; length+=331){
+
+                random_fill(kernel, lengths[l]);
+                memcpy(data, in, sizeof(float)*length);
+
+                kernels[n].function(in, out, length, kernel, lengths[l]);
+                kernels[n].function(data, data, length, kernel, lengths[l]);
+
+                if (memcmp(data, out, 
+                            sizeof(float)*(length-lengths[l]+1)) != 0){
+                    printf("The %s convolution in place is incorrect.\n",
+                            kernels[n].name);
+                    failed = -1;
+                }
+            }
+        }
+    }
+
+#ifdef SSE3
+    int cols = 77;
+    int rows = 43;
+
+    float* image = malloc(sizeof(float)*cols*rows);
+    float* image_copy = malloc(sizeof(float)*cols*rows);
+    float* out_of_place = malloc(sizeof(float)*cols*rows);
+    float* workspace = malloc(sizeof(float)*cols*rows);
+    double* reference = malloc(sizeof(double)*cols*rows);
+    random_fill(image, cols*rows);
+
+    for (int l=0; l<n_lengths; l++){
+        int out_cols = cols - lengths[l] + 1;
+        int out_rows = rows - lengths[l] + 1;
+
+        random_fill(kernel, lengths[l]);
+        memcpy(image_copy, image, sizeof(float)*cols*rows);
+
+        convolve_sse_2d_separable_in_place(image_copy, cols, rows,
+                kernel, lengths[l]);
+
+        reference_2d(image, cols, reference, cols, rows, kernel, lengths[l],
+                kernel, lengths[l]);
+        failed |= check("The 2D convolution in place", 
+                max_error(image_copy, out_cols, reference, out_cols, 
+                    out_rows));
+
+        convolve_sse_2d_separable(image, out_of_place, workspace, cols, rows,
+                kernel, lengths[l]);
+        for (int i=0; i<out_cols*out_rows; i++){
+            reference[i] = out_of_place[i];
+        }
+        failed |= check("The 2D convolution in place against out of place",
+                max_error(image_copy, out_cols, reference, out_cols, 
+                    out_rows));
+    }
+
+    free(image);
+    free(image_copy);
+    free(out_of_place);
+    free(workspace);
+    free(reference);
+#endif
+
+    return failed;
+}
+
+/* The thresholded and top k correlations of every instruction set that
+ * is built. The data and pattern are small integers, so that every
+ * correlation is exact and many of them tie.
+ * */
+int check_correlate()
+{
+    struct {
+        const char* name;
+        int (*threshold)(float*, int, float*, int, float, int*, float*,
+                int);
+        int (*top_k)(float*, int, float*, int, int, int*, float*);
+    } isas[] = {
+#ifdef SSE3
+        {"sse", convolve_sse_correlate_threshold,
+            convolve_sse_correlate_top_k},
+#endif
+#ifdef AVX
+        {"avx", convolve_avx_correlate_threshold,
+            convolve_avx_correlate_top_k},
+#endif
+#ifdef AVX512
+        {"avx512", convolve_avx512_correlate_threshold,
+            convolve_avx512_correlate_top_k},
+#endif
+#ifdef NEON
+        {"neon", convolve_neon_correlate_threshold,
+            convolve_neon_correlate_top_k},
+#endif
+    };
+    int n_isas = sizeof(isas)/sizeof(isas[0]);
+
+    int length = 1000;
+    int pattern_length = 7;
+    int out_length = length - pattern_length + 1;
+    float threshold = 8.5f;
+
+    float in[length];
+    float pattern[pattern_length];
+    float correlation[out_length];
+    for (int i=0; i<length; i++){
+        in[i] = rand() % 7 - 3;
+    }
+    for (int i=0; i<pattern_length; i++){
+        pattern[i] = rand() % 3 - 1;
+    }
+
+    int n_expected = 0;
+    int expected[out_length];
+    for (int i=0; i<out_length; i++){
+        correlation[i] = 0.0f;
+        for (int k=0; k<pattern_length; k++){
+            correlation[i] += in[i + k] * pattern[k];
+        }
+        if (correlation[i] > threshold){
+            expected[n_expected++] = i;
+        }
+    }
+
+    int indices[out_length + 1];
+    float values[out_length + 1];
+    int failed = 0;
+
+    for (int n=0; n<n_isas; n++){
+        int wrong = 0;
+
+        /* Every match, in order, then only the first few of them with
+         * nothing written past max_matches, then without values.
+         * */
+        for (int run=0; run<3; run++){
+            int max_matches = run == 1 ? n_expected/2 : out_length;
+            for (int i=0; i<=out_length; i++){
+                indices[i] = -1;
+                values[i] = -1.0f;
+            }
+
+            int n_matches = isas[n].threshold(in, length, pattern,
+                    pattern_length, threshold, indices,
+                    run == 2 ? NULL : values, max_matches);
+
+            wrong |= n_matches != n_expected;
+            for (int i=0; i<max_matches && i<n_expected; i++){
+                wrong |= indices[i] != expected[i];
+                wrong |= run != 2 && values[i] != correlation[expected[i]];
+            }
+            for (int i=max_matches < n_expected ? max_matches : n_expected;
+                    i<=out_length; i++){
+                wrong |= indices[i] != -1;
+            }
+            for (int i=run == 2 ? 0 : n_expected; i<=out_length; i++){
+                wrong |= values[i] != -1.0f;
+            }
+        }
+
+        /* The k largest, largest first, where the smallest of them ties
+         * with others that are left out, and then more than there are.
+         * */
+        for (int run=0; run<2; run++){
+            int k = run == 0 ? 10 : out_length + 1;
+            int n_kept = isas[n].top_k(in, length, pattern, pattern_length,
+                    k, indices, values);
+
+            wrong |= n_kept != (k < out_length ? k : out_length);
+
+            int seen[out_length];
+            memset(seen, 0, sizeof(seen));
+            for (int i=0; i<n_kept && !wrong; i++){
+                wrong |= indices[i] < 0 || indices[i] >= out_length ||
+                    seen[indices[i]]++;
+                wrong |= values[i] != correlation[indices[i]];
+                wrong |= i > 0 && values[i] > values[i - 1];
+            }
+
+            // Nothing left out is larger than the smallest kept
+            for (int i=0; i<out_length && !wrong; i++){
+                wrong |= !seen[i] && correlation[i] > values[n_kept - 1];
+            }
+        }
+
+        if (wrong){
+            printf("The %s correlations are incorrect.\n", isas[n].name);
+            failed = -1;
+        }
+    }
+
+    return failed;
+}
+
+#ifdef SSE3
+/* Pushing the rows of an image through a stream must give the rows of
+ * convolve_sse_2d_separable, each once the stream has filled.
+ * */
+int check_stream()
+{
+    int cols = 61;
+    int rows = 37;
+    int lengths[] = {1, 3, 5, 8, 16};
+    int n_lengths = sizeof(lengths)/sizeof(lengths[0]);
+
+    float* image = malloc(sizeof(float)*cols*rows);
+    float* expected = malloc(sizeof(float)*cols*rows);
+    float* workspace = malloc(sizeof(float)*cols*rows);
+    float out_row[61];
+    float kernel[16];
+
+    int failed = 0;
+    random_fill(image, cols*rows);
+
+    for (int l=0; l<n_lengths; l++){
+        int out_cols = cols - lengths[l] + 1;
+
+        random_fill(kernel, lengths[l]);
+        convolve_sse_2d_separable(image, expected, workspace, cols, rows,
+                kernel, lengths[l]);
+
+        convolve_sse_2d_stream stream;
+        float* ring = malloc(sizeof(float)*
+                convolve_sse_2d_stream_workspace_length(cols, lengths[l]));
+        convolve_sse_2d_stream_init(&stream, ring, cols, kernel, lengths[l]);
+
+        for (int row=0; row<rows; row++){
+            int written = convolve_sse_2d_stream_push(&stream, 
+                    image + row*cols, out_row);
+
+            if (written != (row >= lengths[l] - 1)){
+                printf("The stream wrote a row when it should not.\n");
+                failed = -1;
+            } else if (written){
+                float* expected_row = 
+                    expected + (row - lengths[l] + 1)*out_cols;
+                for (int col=0; col<out_cols; col++){
+                    if (fabs(out_row[col] - expected_row[col]) > 1e-5){
+                        printf("The streamed convolution is incorrect.\n");
+                        failed = -1;
+                        break;
+                    }
+                }
+            }
+        }
+        free(ring);
+    }
+
+    free(image);
+    free(expected);
+    free(workspace);
+
+    return failed;
+}
+#endif
+
+#ifdef SSE3
+/* Each strategy for the separable 2D convolution, on random images of a
+ * few shapes with random kernels, against the reference. The shapes
+ * include narrow, tall images, for which convolve_sse_2d_separable
+ * picks the transpose strategy.
+ * */
+int check_strategies()
+{
+    struct {
+        const char* name;
+        int (*function)(float*, float*, float*, int, int, float*, int);
+    } strategies[] = {
+        {"The transpose strategy", convolve_sse_2d_separable_transpose},
+        {"The columns strategy", convolve_sse_2d_separable_columns},
+        {"The planned strategy", convolve_sse_2d_separable},
+    };
+    int n_strategies = sizeof(strategies)/sizeof(strategies[0]);
+
+    struct {
+        int cols;
+        int rows;
+        int kernel_length;
+    } shapes[] = {
+        {37, 150, 5}, {20, 201, 3}, {200, 23, 7}, {16, 16, 16},
+        {5, 9, 1}, {63, 66, 9},
+    };
+    int n_shapes = sizeof(shapes)/sizeof(shapes[0]);
+
+    int failed = 0;
+
+    for (int n=0; n<n_shapes; n++){
+        int cols = shapes[n].cols;
+        int rows = shapes[n].rows;
+        int kernel_length = shapes[n].kernel_length;
+        int out_cols = cols - kernel_length + 1;
+        int out_rows = rows - kernel_length + 1;
+
+        float* image = malloc(sizeof(float)*cols*rows);
+        float* out = malloc(sizeof(float)*out_cols*out_rows);
+        float* workspace = malloc(sizeof(float)*out_cols*rows);
+        double* reference = malloc(sizeof(double)*out_cols*out_rows);
+        float kernel[16];
+
+        random_fill(image, cols*rows);
+        random_fill(kernel, kernel_length);
+        reference_2d(image, cols, reference, cols, rows, kernel,
+                kernel_length, kernel, kernel_length);
+
+        for (int s=0; s<n_strategies; s++){
+            strategies[s].function(image, out, workspace, cols, rows,
+                    kernel, kernel_length);
+            failed |= check(strategies[s].name,
+                    max_error(out, out_cols, reference, out_cols, out_rows));
+        }
+
+        free(image);
+        free(out);
+        free(workspace);
+        free(reference);
+    }
+
+    return failed;
+}
+#endif
+
+#ifdef SSE3
+/* Each pyramid level is the level before, convolved and decimated by 2,
+ * and a pyramid deeper than the image allows, or a level that isn't in
+ * the arena, is refused.
+ * */
+int check_pyramid()
+{
+    int cols = 101;
+    int rows = 70;
+    int levels = 3;
+    float kernel[5];
+    random_fill(kernel, 5);
+
+    float* image = malloc(sizeof(float)*cols*rows);
+    double* reference = malloc(sizeof(double)*cols*rows);
+    float* arena = malloc(sizeof(float)*
+            convolve_sse_2d_pyramid_arena_length(cols, rows, levels, 5));
+    random_fill(image, cols*rows);
+
+    int failed = 0;
+    if (convolve_sse_2d_pyramid(image, arena, cols, rows, levels, kernel,
+                5) != 0){
+        printf("The pyramid failed.\n");
+        failed = -1;
+    }
+
+    float* level_in = image;
+    int level_cols = cols;
+    int level_rows = rows;
+
+    for (int level=1; level<=levels && !failed; level++){
+        int out_cols, out_rows;
+        float* level_out = convolve_sse_2d_pyramid_level(arena, cols, rows,
+                level, 5, &out_cols, &out_rows);
+
+        int full_cols = level_cols - 4;
+        reference_2d(level_in, level_cols, reference, level_cols, level_rows,
+                kernel, 5, kernel, 5);
+
+        double error = 0.0;
+        for (int row=0; row<out_rows; row++){
+            for (int col=0; col<out_cols; col++){
+                error = fmax(error, fabs(level_out[row*out_cols + col] - 
+                            reference[2*row*full_cols + 2*col]));
+            }
+        }
+        failed |= check("A pyramid level", error);
+
+        level_in = level_out;
+        level_cols = out_cols;
+        level_rows = out_rows;
+    }
+
+    // 101x70 gives 49x33, 23x15, 10x6 and then 3x1, with nothing after
+    if (convolve_sse_2d_pyramid_arena_length(cols, rows, 5, 5) != -1 ||
+            convolve_sse_2d_pyramid(image, arena, cols, rows, 6, kernel,
+                5) != -1){
+        printf("A pyramid with empty levels was not refused.\n");
+        failed = -1;
+    }
+
+    if (convolve_sse_2d_pyramid_level(arena, cols, rows, 0, 5,
+                &level_cols, &level_rows) != NULL ||
+            convolve_sse_2d_pyramid_level(arena, cols, rows, -1, 5,
+                &level_cols, &level_rows) != NULL){
+        printf("A pyramid level below 1 was not refused.\n");
+        failed = -1;
+    }
+
+    free(image);
+    free(reference);
+    free(arena);
+
+    return failed;
+}
+#endif
+
+#ifdef SSE3
+/* The uint8 output for a reference value: rounded to nearest and
+ * saturated. A value within a hair of a half may round either way in
+ * single precision, so any output next to it is accepted.
+ * */
+int u8_matches(uint8_t test, double reference)
+{
+    double rounded = fmin(fmax(nearbyint(reference), 0.0), 255.0);
+
+    if (test == rounded){
+        return 1;
+    }
+    return fabs(fabs(reference - floor(reference)) - 0.5) < 1e-3 &&
+        fabs(test - reference) < 1.0 && reference > -1.0 && reference < 256.0;
+}
+
+/* Every channel of an interleaved or planar image is what the single
+ * channel convolution gives for that channel alone, and the uint8
+ * versions round and saturate the same result.
+ * */
+int check_channels()
+{
+    int cols = 37;
+    int rows = 23;
+    int channels = 3;
+    int kernel_length = 5;
+    int out_cols = cols - kernel_length + 1;
+    int out_rows = rows - kernel_length + 1;
+    int plane = cols*rows;
+    int out_plane = out_cols*out_rows;
+
+    float kernel[kernel_length];
+    random_fill(kernel, kernel_length);
+
+    float* planes = malloc(sizeof(float)*plane*channels);
+    float* interleaved = malloc(sizeof(float)*plane*channels);
+    float* single = malloc(sizeof(float)*out_plane*channels);
+    float* out = malloc(sizeof(float)*out_plane*channels);
+    float* workspace = malloc(sizeof(float)*rows*out_cols*channels);
+    double* reference = malloc(sizeof(double)*out_plane);
+    uint8_t* planes_u8 = malloc(plane*channels);
+    uint8_t* interleaved_u8 = malloc(plane*channels);
+    uint8_t* out_u8 = malloc(out_plane*channels);
+
+    random_fill(planes, plane*channels);
+    for (int c=0; c<channels; c++){
+        for (int i=0; i<plane; i++){
+            interleaved[i*channels + c] = planes[c*plane + i];
+        }
+        convolve_sse_2d_separable(planes + c*plane, single + c*out_plane,
+                workspace, cols, rows, kernel, kernel_length);
+    }
+
+    int failed = 0;
+    double error;
+
+    convolve_sse_2d_separable_planar(planes, out, workspace, cols, rows,
+            channels, kernel, kernel_length);
+    error = 0.0;
+    for (int i=0; i<out_plane*channels; i++){
+        error = fmax(error, fabs(out[i] - single[i]));
+    }
+    failed |= check("A planar channel", error);
+
+    convolve_sse_2d_separable_interleaved(interleaved, out, workspace, cols,
+            rows, channels, kernel, kernel_length);
+    error = 0.0;
+    for (int c=0; c<channels; c++){
+        for (int i=0; i<out_plane; i++){
+            error = fmax(error,
+                    fabs(out[i*channels + c] - single[c*out_plane + i]));
+        }
+    }
+    failed |= check("An interleaved channel", error);
+
+    /* One kernel whose gain of 6.25 pushes most outputs past 255 and one
+     * with negative taps that takes some below 0, so that the rounding
+     * and both ends of the saturation are all used.
+     * */
+    float bright[] = {0.5f, 0.5f, 0.5f, 0.5f, 0.5f};
+    float signed_kernel[] = {-0.75f, 0.25f, 1.0f, 0.5f, -0.5f};
+    float* u8_kernels[] = {bright, signed_kernel};
+
+    for (int i=0; i<plane*channels; i++){
+        planes_u8[i] = rand() % 256;
+    }
+    for (int c=0; c<channels; c++){
+        for (int i=0; i<plane; i++){
+            interleaved_u8[i*channels + c] = planes_u8[c*plane + i];
+            planes[c*plane + i] = planes_u8[c*plane + i];
+        }
+    }
+
+    for (int k=0; k<2; k++){
+        int planar_wrong = 0;
+        int interleaved_wrong = 0;
+        int low = 0;
+        int high = 0;
+
+        convolve_sse_2d_separable_planar_u8(planes_u8, out_u8, workspace,
+                cols, rows, channels, u8_kernels[k], kernel_length);
+
+        for (int c=0; c<channels; c++){
+            reference_2d(planes + c*plane, cols, reference, cols, rows,
+                    u8_kernels[k], kernel_length, u8_kernels[k],
+                    kernel_length);
+            for (int i=0; i<out_plane; i++){
+                planar_wrong |= !u8_matches(out_u8[c*out_plane + i],
+                        reference[i]);
+                low += reference[i] < 0.0;
+                high += reference[i] > 255.0;
+            }
+        }
+
+        convolve_sse_2d_separable_interleaved_u8(interleaved_u8, out_u8,
+                workspace, cols, rows, channels, u8_kernels[k],
+                kernel_length);
+
+        for (int c=0; c<channels; c++){
+            reference_2d(planes + c*plane, cols, reference, cols, rows,
+                    u8_kernels[k], kernel_length, u8_kernels[k],
+                    kernel_length);
+            for (int i=0; i<out_plane; i++){
+                interleaved_wrong |= !u8_matches(out_u8[i*channels + c],
+                        reference[i]);
+            }
+        }
+
+        if (planar_wrong || interleaved_wrong){
+            printf("The uint8 %s convolution is incorrect.\n",
+                    planar_wrong ? "planar" : "interleaved");
+            failed = -1;
+        }
+        if (k == 0 ? high == 0 : low == 0){
+            printf("The uint8 test kernel does not saturate.\n");
+            failed = -1;
+        }
+    }
+
+    free(planes);
+    free(interleaved);
+    free(single);
+    free(out);
+    free(workspace);
+    free(reference);
+    free(planes_u8);
+    free(interleaved_u8);
+    free(out_u8);
+
+    return failed;
+}
+#endif
+
+#ifdef SSE3
+/* A batch is the same as convolving each of its images on its own. */
+int check_batch()
+{
+    int n = 5;
+    int cols = 131;
+    int rows = 29;
+    int kernel_length = 7;
+    int out_cols = cols - kernel_length + 1;
+    int out_rows = rows - kernel_length + 1;
+
+    float kernel[kernel_length];
+    random_fill(kernel, kernel_length);
+
+    float* images = malloc(sizeof(float)*n*cols*rows);
+    float* batch = malloc(sizeof(float)*n*out_cols*out_rows);
+    float* single = malloc(sizeof(float)*out_cols*out_rows);
+    float* workspace = malloc(sizeof(float)*out_cols*rows);
+    random_fill(images, n*cols*rows);
+
+    int failed = 0;
+    if (convolve_sse_2d_separable_batch(images, batch, n, cols, rows,
+                kernel, kernel_length) != 0){
+        printf("The batch convolution failed.\n");
+        failed = -1;
+    }
+
+    double error = 0.0;
+    for (int image=0; image<n; image++){
+        convolve_sse_2d_separable(images + image*cols*rows, single,
+                workspace, cols, rows, kernel, kernel_length);
+        for (int i=0; i<out_cols*out_rows; i++){
+            error = fmax(error, 
+                    fabs(batch[image*out_cols*out_rows + i] - single[i]));
+        }
+    }
+    failed |= check("The batch convolution", error);
+
+    free(images);
+    free(batch);
+    free(single);
+    free(workspace);
+
+    return failed;
+}
+#endif
+
+#ifdef SSE3
+/* The gradients are the separable convolutions they are defined as, with
+ * x increasing along the rows and y down the columns, and outputs that
+ * are NULL are skipped without changing the others.
+ * */
+int check_gradients()
+{
+    int cols = 45;
+    int rows = 31;
+    int out_cols = cols - 2;
+    int out_rows = rows - 2;
+    int out_length = out_cols*out_rows;
+
+    float* image = malloc(sizeof(float)*cols*rows);
+    float* gx = malloc(sizeof(float)*out_length);
+    float* gy = malloc(sizeof(float)*out_length);
+    float* magnitude = malloc(sizeof(float)*out_length);
+    float* orientation = malloc(sizeof(float)*out_length);
+    float* alone = malloc(sizeof(float)*out_length);
+    double* reference_x = malloc(sizeof(double)*out_length);
+    double* reference_y = malloc(sizeof(double)*out_length);
+    random_fill(image, cols*rows);
+
+    struct {
+        const char* name;
+        int (*function)(float*, float*, float*, float*, float*, int, int);
+        float smooth[3];
+        float gain;
+    } operators[] = {
+        {"Sobel", convolve_sse_2d_sobel, {1.0, 2.0, 1.0}, 8.0},
+        {"Scharr", convolve_sse_2d_scharr, {3.0, 10.0, 3.0}, 32.0},
+    };
+    float derivative[3] = {1.0, 0.0, -1.0};
+
+    int failed = 0;
+
+    for (int op=0; op<2; op++){
+        operators[op].function(image, gx, gy, magnitude, orientation,
+                cols, rows);
+
+        reference_2d(image, cols, reference_x, cols, rows, derivative, 3,
+                operators[op].smooth, 3);
+        reference_2d(image, cols, reference_y, cols, rows,
+                operators[op].smooth, 3, derivative, 3);
+
+        double error_x = max_error(gx, out_cols, reference_x, out_cols,
+                out_rows);
+        double error_y = max_error(gy, out_cols, reference_y, out_cols,
+                out_rows);
+        double error_magnitude = 0.0;
+        double error_orientation = 0.0;
+        for (int i=0; i<out_length; i++){
+            error_magnitude = fmax(error_magnitude, fabs(magnitude[i] - 
+                        hypot(reference_x[i], reference_y[i])));
+            error_orientation = fmax(error_orientation, fabs(orientation[i]
+                        - atan2f(gy[i], gx[i])));
+        }
+
+        if (check(operators[op].name, fmax(error_x, error_y)) ||
+                check("A gradient magnitude", error_magnitude) ||
+                check("A gradient orientation", error_orientation)){
+            failed = -1;
+        }
+
+        // Each output on its own is the same as with all of them
+        int null_wrong = 0;
+        for (int which=0; which<4; which++){
+            float* outputs[4] = {NULL, NULL, NULL, NULL};
+            float* expected[4] = {gx, gy, magnitude, orientation};
+            outputs[which] = alone;
+
+            operators[op].function(image, outputs[0], outputs[1],
+                    outputs[2], outputs[3], cols, rows);
+            null_wrong |= memcmp(alone, expected[which],
+                    sizeof(float)*out_length) != 0;
+        }
+        if (null_wrong){
+            printf("The %s outputs depend on which are NULL.\n",
+                    operators[op].name);
+            failed = -1;
+        }
+    }
+
+    /* On the ramp x + 2y the gradient is the operator's gain times
+     * (1, 2), positive along the rows and down the columns, and for the
+     * derivative of Gaussian the gain is close to 1.
+     * */
+    for (int row=0; row<rows; row++){
+        for (int col=0; col<cols; col++){
+            image[row*cols + col] = col + 2*row;
+        }
+    }
+
+    for (int op=0; op<3; op++){
+        float gain = op < 2 ? operators[op].gain : 1.0f;
+        float tolerance = op < 2 ? 1e-4f : 1e-2f;
+        int wrong = 0;
+
+        if (op < 2){
+            operators[op].function(image, gx, gy, magnitude, orientation,
+                    cols, rows);
+        }
+        else{
+            convolve_sse_2d_gaussian_gradient(image, gx, gy, magnitude,
+                    orientation, cols, rows, 1.0, 7);
+        }
+
+        int length = op < 2 ? out_length : (cols - 6)*(rows - 6);
+        for (int i=0; i<length; i++){
+            wrong |= fabsf(gx[i] - gain) > tolerance*gain;
+            wrong |= fabsf(gy[i] - 2*gain) > tolerance*2*gain;
+            wrong |= fabsf(magnitude[i] - sqrtf(5.0f)*gain) > 
+                tolerance*3*gain;
+            wrong |= fabsf(orientation[i] - atan2f(2.0f, 1.0f)) > tolerance;
+        }
+        if (wrong){
+            printf("The gradient of a ramp is wrong (operator %d).\n", op);
+            failed = -1;
+        }
+    }
+
+    free(image);
+    free(gx);
+    free(gy);
+    free(magnitude);
+    free(orientation);
+    free(alone);
+    free(reference_x);
+    free(reference_y);
+
+    return failed;
+}
+#endif
+
+#ifdef SSE3
+/* Different kernels along the rows and down the columns, at every
+ * pairing of the specialised lengths, a length without a specialised
+ * version and a length of 1, which is folded into the other kernel.
+ * */
+int check_asymmetric()
+{
+    int cols = 61;
+    int rows = 47;
+    int lengths[] = {1, 3, 4, 5, 7, 9, 11, 16};
+    int n_lengths = sizeof(lengths)/sizeof(lengths[0]);
+
+    float row_kernel[16];
+    float col_kernel[16];
+    float* image = malloc(sizeof(float)*cols*rows);
+    float* out = malloc(sizeof(float)*cols*rows);
+    float* workspace = malloc(sizeof(float)*cols*rows);
+    double* reference = malloc(sizeof(double)*cols*rows);
+    random_fill(image, cols*rows);
+
+    int failed = 0;
+
+    for (int r=0; r<n_lengths; r++){
+        for (int c=0; c<n_lengths; c++){
+            int row_length = lengths[r];
+            int col_length = lengths[c];
+            random_fill(row_kernel, row_length);
+            random_fill(col_kernel, col_length);
+
+            convolve_sse_2d_separable_asymmetric(image, out, workspace,
+                    cols, rows, row_kernel, row_length, col_kernel,
+                    col_length);
+            reference_2d(image, cols, reference, cols, rows, row_kernel,
+                    row_length, col_kernel, col_length);
+
+            int out_cols = cols - row_length + 1;
+            int out_rows = rows - col_length + 1;
+            if (check("The asymmetric convolution", max_error(out, 
+                            out_cols, reference, out_cols, out_rows))){
+                printf("(row kernel %d, column kernel %d)\n", row_length,
+                        col_length);
+                failed = -1;
+            }
+        }
+    }
+
+    free(image);
+    free(out);
+    free(workspace);
+    free(reference);
+
+    return failed;
+}
+#endif
+
+#ifdef SSE3
+/* Rows that are further apart than the image is wide, and a region of a
+ * larger frame, give the same result as the packed image, and nothing
+ * between the rows of the output is written.
+ * */
+int check_strided()
+{
+    int cols = 53;
+    int rows = 37;
+    int row_length = 5;
+    int col_length = 7;
+    int out_cols = cols - row_length + 1;
+    int out_rows = rows - col_length + 1;
+
+    int frame_pitch = cols + 19;
+    int frame_rows = rows + 11;
+    int roi_col = 7;
+    int roi_row = 4;
+    int out_pitch = out_cols + 13;
+    int workspace_pitch = out_cols + 3;
+
+    float row_kernel[5];
+    float col_kernel[7];
+    random_fill(row_kernel, row_length);
+    random_fill(col_kernel, col_length);
+
+    float* image = malloc(sizeof(float)*cols*rows);
+    float* frame = malloc(sizeof(float)*frame_pitch*frame_rows);
+    float* packed = malloc(sizeof(float)*out_cols*out_rows);
+    float* out = malloc(sizeof(float)*out_pitch*out_rows);
+    float* workspace = malloc(sizeof(float)*workspace_pitch*rows);
+
+    random_fill(frame, frame_pitch*frame_rows);
+    for (int row=0; row<rows; row++){
+        memcpy(image + row*cols, frame + (roi_row + row)*frame_pitch +
+                roi_col, sizeof(float)*cols);
+    }
+
+    convolve_sse_2d_separable_asymmetric(image, packed, workspace, cols,
+            rows, row_kernel, row_length, col_kernel, col_length);
+
+    int failed = 0;
+
+    for (int roi=0; roi<2; roi++){
+        for (int i=0; i<out_pitch*out_rows; i++){
+            out[i] = 1234.0f;
+        }
+
+        if (roi){
+            convolve_sse_2d_separable_roi(frame, frame_pitch, roi_col,
+                    roi_row, cols, rows, out, out_pitch, workspace,
+                    workspace_pitch, row_kernel, row_length, col_kernel,
+                    col_length);
+        }
+        else{
+            convolve_sse_2d_separable_strided(
+                    frame + roi_row*frame_pitch + roi_col, frame_pitch,
+                    out, out_pitch, workspace, workspace_pitch, cols, rows,
+                    row_kernel, row_length, col_kernel, col_length);
+        }
+
+        int wrong = 0;
+        for (int row=0; row<out_rows; row++){
+            wrong |= memcmp(out + row*out_pitch, packed + row*out_cols,
+                    sizeof(float)*out_cols) != 0;
+            for (int col=out_cols; col<out_pitch; col++){
+                wrong |= out[row*out_pitch + col] != 1234.0f;
+            }
+        }
+        if (wrong){
+            printf("The %s convolution differs from the packed one.\n",
+                    roi ? "region of interest" : "strided");
+            failed = -1;
+        }
+    }
+
+    free(image);
+    free(frame);
+    free(packed);
+    free(out);
+    free(workspace);
+
+    return failed;
+}
+#endif
+
+#ifdef SSE3
+/* After each change to the image is marked and the output updated, the
+ * output is the same as convolving the whole changed image, for changes
+ * in the middle, against each edge and corner, partly outside the image,
+ * and for two changes marked before one update.
+ * */
+int check_incremental()
+{
+    int cols = 83;
+    int rows = 59;
+    int row_length = 5;
+    int col_length = 3;
+    int out_cols = cols - row_length + 1;
+    int out_rows = rows - col_length + 1;
+
+    float row_kernel[5];
+    float col_kernel[3];
+    random_fill(row_kernel, row_length);
+    random_fill(col_kernel, col_length);
+
+    float* image = malloc(sizeof(float)*cols*rows);
+    float* out = malloc(sizeof(float)*out_cols*out_rows);
+    float* workspace = malloc(sizeof(float)*out_cols*rows);
+    double* reference = malloc(sizeof(double)*out_cols*out_rows);
+    random_fill(image, cols*rows);
+
+    convolve_sse_2d_incremental state;
+    convolve_sse_2d_incremental_init(&state, workspace, cols, rows,
+            row_kernel, row_length, col_kernel, col_length);
+
+    /* {col, row, cols, rows}, with -1 ending a group that is marked
+     * together, so the last -1 is an update with nothing marked.
+     * */
+    int rects[][4] = {
+        {30, 20, 6, 4}, {-1},
+        {0, 0, 3, 2}, {-1},
+        {cols - 2, rows - 1, 2, 1}, {-1},
+        {0, rows - 3, 1, 3}, {-1},
+        {cols - 7, 0, 7, 1}, {-1},
+        {-4, 10, 8, 5}, {-1},
+        {70, 50, 40, 40}, {-1},
+        {5, 5, 2, 2}, {60, 40, 3, 3}, {-1},
+        {-1},
+    };
+    int n_rects = sizeof(rects)/sizeof(rects[0]);
+
+    int failed = 0;
+
+    // Nothing is marked yet, but the first update is of the whole image
+    convolve_sse_2d_incremental_update(&state, image, out);
+    reference_2d(image, cols, reference, cols, rows, row_kernel,
+            row_length, col_kernel, col_length);
+    failed |= check("The first incremental update", max_error(out,
+                out_cols, reference, out_cols, out_rows));
+
+    for (int r=0; r<n_rects; r++){
+        if (rects[r][0] == -1){
+            convolve_sse_2d_incremental_update(&state, image, out);
+            reference_2d(image, cols, reference, cols, rows, row_kernel,
+                    row_length, col_kernel, col_length);
+            if (check("The incremental convolution", max_error(out,
+                            out_cols, reference, out_cols, out_rows))){
+                printf("(after the change ending at entry %d)\n", r);
+                failed = -1;
+            }
+            continue;
+        }
+
+        int col = rects[r][0];
+        int row = rects[r][1];
+        for (int y=row; y<row + rects[r][3]; y++){
+            for (int x=col; x<col + rects[r][2]; x++){
+                if (x >= 0 && x < cols && y >= 0 && y < rows){
+                    image[y*cols + x] = ((float) rand() / RAND_MAX) - 0.5f;
+                }
+            }
+        }
+        convolve_sse_2d_incremental_mark_dirty(&state, col, row,
+                rects[r][2], rects[r][3]);
+    }
+
+    free(image);
+    free(out);
+    free(workspace);
+    free(reference);
+
+    return failed;
+}
+#endif
+
+#ifdef SSE3
+/* The reductions of a window of ``reference'', pool_cols x pool_rows at
+ * (col, row) with rows ``pitch'' apart, for the pooling checks: the
+ * error in ``value'' for the mean or max, and for the argmax whether
+ * ``index'' is in the window and within the tolerance of its maximum.
+ * */
+double pool_error(double* reference, int pitch, int col, int row,
+        int pool_cols, int pool_rows, int mode, float value, int index)
+{
+    double best = -INFINITY;
+    double sum = 0.0;
+
+    for (int y=row; y<row + pool_rows; y++){
+        for (int x=col; x<col + pool_cols; x++){
+            best = fmax(best, reference[y*pitch + x]);
+            sum += reference[y*pitch + x];
+        }
+    }
+
+    if (mode == CONVOLVE_POOL_MEAN){
+        return fabs(value - sum / (pool_cols*pool_rows));
+    }
+
+    double error = fabs(value - best);
+    if (mode == CONVOLVE_POOL_ARGMAX){
+        int x = index % pitch;
+        int y = index / pitch;
+        if (x < col || x >= col + pool_cols || y < row ||
+                y >= row + pool_rows){
+            return INFINITY;
+        }
+        error = fmax(error, best - reference[index]);
+    }
+    return error;
+}
+
+/* Every mode of the 1D pooling of each instruction set, with windows
+ * either side of each vector width, and the 2D pooling, against the
+ * pooled reference; and windows of no outputs are refused.
+ * */
+int check_pool()
+{
+    struct {
+        const char* name;
+        int (*function)(float*, float*, int*, int, float*, int, int, int);
+    } isas[] = {
+        {"sse", convolve_sse_generic_pool},
+#ifdef AVX
+        {"avx", convolve_avx_generic_pool},
+#endif
+#ifdef AVX512
+        {"avx512", convolve_avx512_generic_pool},
+#endif
+    };
+    int n_isas = sizeof(isas)/sizeof(isas[0]);
+
+    int length = 3000;
+    int kernel_length = 9;
+    int out_length = length - kernel_length + 1;
+    int pools[] = {1, 3, 4, 8, 15, 16, 37, 64, 70};
+    int n_pools = sizeof(pools)/sizeof(pools[0]);
+
+    float kernel[kernel_length];
+    float* in = malloc(sizeof(float)*length);
+    float* out = malloc(sizeof(float)*out_length);
+    int* argmax = malloc(sizeof(int)*out_length);
+    double* reference = malloc(sizeof(double)*out_length);
+    random_fill(kernel, kernel_length);
+    random_fill(in, length);
+    reference_1d(in, reference, length, kernel, kernel_length);
+
+    int failed = 0;
+
+    for (int n=0; n<n_isas; n++){
+        for (int p=0; p<n_pools; p++){
+            for (int mode=0; mode<3; mode++){
+                int pool = pools[p];
+                isas[n].function(in, out, argmax, length, kernel,
+                        kernel_length, pool, mode);
+
+                double error = 0.0;
+                for (int w=0; w<out_length/pool; w++){
+                    error = fmax(error, pool_error(reference, out_length,
+                                w*pool, 0, pool, 1, mode, out[w],
+                                argmax[w]));
+                }
+                if (check("A 1D pooling", error)){
+                    printf("(%s, pool %d, mode %d)\n", isas[n].name, pool,
+                            mode);
+                    failed = -1;
+                }
+            }
+        }
+
+        if (isas[n].function(in, out, argmax, length, kernel,
+                    kernel_length, 0, CONVOLVE_POOL_MAX) != -1){
+            printf("The %s pooling took an empty window.\n",
+                    isas[n].name);
+            failed = -1;
+        }
+    }
+
+    int cols = 67;
+    int rows = 45;
+    int out_cols = cols - kernel_length + 1;
+    int out_rows = rows - 5 + 1;
+    float* image = malloc(sizeof(float)*cols*rows);
+    float* workspace = malloc(sizeof(float)*out_cols*rows);
+    double* reference_2 = malloc(sizeof(double)*out_cols*out_rows);
+    random_fill(image, cols*rows);
+    reference_2d(image, cols, reference_2, cols, rows, kernel,
+            kernel_length, kernel, 5);
+
+    int pool_sizes[][2] = {{1, 1}, {2, 3}, {5, 1}, {1, 4}, {17, 6}};
+
+    for (int p=0; p<5; p++){
+        for (int mode=0; mode<3; mode++){
+            int pool_cols = pool_sizes[p][0];
+            int pool_rows = pool_sizes[p][1];
+            int pooled_cols = out_cols / pool_cols;
+
+            convolve_sse_2d_separable_pool(image, out, argmax, workspace,
+                    cols, rows, kernel, kernel_length, kernel, 5,
+                    pool_cols, pool_rows, mode);
+
+            double error = 0.0;
+            for (int y=0; y<out_rows/pool_rows; y++){
+                for (int x=0; x<pooled_cols; x++){
+                    error = fmax(error, pool_error(reference_2, out_cols,
+                                x*pool_cols, y*pool_rows, pool_cols,
+                                pool_rows, mode, out[y*pooled_cols + x],
+                                argmax[y*pooled_cols + x]));
+                }
+            }
+            if (check("A 2D pooling", error)){
+                printf("(pool %d x %d, mode %d)\n", pool_cols, pool_rows,
+                        mode);
+                failed = -1;
+            }
+        }
+    }
+
+    if (convolve_sse_2d_separable_pool(image, out, argmax, workspace, cols,
+                rows, kernel, kernel_length, kernel, 5, 0, 2,
+                CONVOLVE_POOL_MAX) != -1 ||
+            convolve_sse_2d_separable_pool(image, out, argmax, workspace,
+                cols, rows, kernel, kernel_length, kernel, 5, 2, -1,
+                CONVOLVE_POOL_MAX) != -1){
+        printf("The 2D pooling took an empty window.\n");
+        failed = -1;
+    }
+
+    free(in);
+    free(out);
+    free(argmax);
+    free(reference);
+    free(image);
+    free(workspace);
+    free(reference_2);
+
+    return failed;
+}
+#endif
+
 int main()
 {
+    int failed = 0;
+
+    failed |= check_1d_kernels();
+    failed |= check_in_place();
+    failed |= check_correlate();
+#ifdef SSE3
+    failed |= check_stream();
+    failed |= check_strategies();
+    failed |= check_pyramid();
+    failed |= check_channels();
+    failed |= check_batch();
+    failed |= check_gradients();
+    failed |= check_asymmetric();
+    failed |= check_strided();
+    failed |= check_incremental();
+    failed |= check_pool();
+#endif
+
+    if (failed){
+        g_error("Computed convolution is incorrect.");
+        return(-1);
+    }
+
+#ifdef SSE3
     float* test_output = malloc(
             sizeof(float)*(INPUT_LENGTH-KERNEL_LENGTH+1)*ROWS);
 
     float* workspace = malloc(
             sizeof(float)*(INPUT_LENGTH-KERNEL_LENGTH+1)*ROWS);
 
-    float* input_array;
-    if (ROWS > 1) {
-        input_array = malloc(sizeof(float)*(INPUT_LENGTH*ROWS));
-        for (int col=0; col<INPUT_LENGTH; col++){
-            for(int row=0; row<ROWS; row++){
-                input_array[row*INPUT_LENGTH + col] = INPUT_ARRAY[col];
-            }
-        }
-    } else {
-        input_array = INPUT_ARRAY;
-    }
+    float* input_array = malloc(sizeof(float)*(INPUT_LENGTH*ROWS));
+    random_fill(input_array, INPUT_LENGTH*ROWS);
+
+    /* The kernel is random rather than KERNEL, so that it is not
+     * symmetric and a pass that applies it the wrong way round fails.
+     * */
+    float kernel[KERNEL_LENGTH];
+    random_fill(kernel, KERNEL_LENGTH);
+
+    int out_cols = INPUT_LENGTH - KERNEL_LENGTH + 1;
+    int out_rows = ROWS - KERNEL_LENGTH + 1;
+    double* reference = malloc(sizeof(double)*out_cols*out_rows);
+    reference_2d(input_array, INPUT_LENGTH, reference, INPUT_LENGTH, ROWS,
+            kernel, KERNEL_LENGTH, kernel, KERNEL_LENGTH);
+
+    /* Each strategy for the 2D convolution is timed in turn, so they
+     * can be compared.
+     * */
+    struct {
+        const char* name;
+        int (*function)(float*, float*, float*, int, int, float*, int, int);
+    } strategies[] = {
+        {"transpose", convolve_sse_2d_separable_transpose_multiple},
+        {"columns", convolve_sse_2d_separable_columns_multiple},
+        {"planned", convolve_sse_2d_separable_multiple},
+    };
+    int n_strategies = sizeof(strategies)/sizeof(strategies[0]);
 
     struct timeval now, then;
 
-    float min_delta = -1.0;
-    float delta;
     printf("Running %d tests of %d loops\n", N_TESTS, N_LOOPS);
 
-    for (int j=0; j<N_TESTS; j++){
-        gettimeofday(&then, NULL);
+    for (int s=0; s<n_strategies; s++){
 
-        convolve_sse_2d_separable_multiple(input_array, test_output, workspace, 
-        //convolve_sse_in_aligned_fixed_kernel_multiple(INPUT_ARRAY, test_output,
-        //convolve_sse_in_aligned_multiple(INPUT_ARRAY, test_output,
-        //convolve_sse_partial_unroll_multiple(INPUT_ARRAY, test_output,
-        //convolve_sse_simple_multiple(INPUT_ARRAY, test_output,
-        //convolve_naive_multiple(INPUT_ARRAY, test_output,
-                    INPUT_LENGTH, ROWS, KERNEL, KERNEL_LENGTH, N_LOOPS);
+        float min_delta = -1.0;
+        float delta;
 
-        gettimeofday(&now, NULL);
-        delta = ((float)time_delta(&now, &then))/N_LOOPS;
+        for (int j=0; j<N_TESTS; j++){
+            gettimeofday(&then, NULL);
 
-        min_delta = ((min_delta == -1.0) || 
-                (delta < min_delta)) ? delta : min_delta;
-    }
+            strategies[s].function(input_array, test_output, workspace, 
+                    INPUT_LENGTH, ROWS, kernel, KERNEL_LENGTH, N_LOOPS);
+
+            gettimeofday(&now, NULL);
+            delta = ((float)time_delta(&now, &then))/N_LOOPS;
+
+            min_delta = ((min_delta == -1.0) || 
+                    (delta < min_delta)) ? delta : min_delta;
+        }
 
-    printf("Lowest test time: %1.3f microseconds per loop.\n", 
-            min_delta);
+        printf("%s: lowest test time: %1.3f microseconds per loop.\n", 
+                strategies[s].name, min_delta);
 
-    for (int i=0; i<(INPUT_LENGTH-KERNEL_LENGTH+1); i++){
-        if (TEST_OUTPUT_CORRECT[i] != test_output[i]){
+        if (check(strategies[s].name, max_error(test_output, out_cols,
+                        reference, out_cols, out_rows)) != 0){
             g_error("Computed convolution is incorrect.");
             return(-1);
         }
     }
 
-    printf("Convolution is valid.\n");    
-
+    free(input_array);
+    free(reference);
+    free(workspace);
     free(test_output);
+#endif
+
+    printf("Convolution is valid.\n");    
 
     return 0;
 }
@@ -0,0 +1,240 @@
+/* Copyright (C) 2012 Henry Gomersall <heng@cantab.net> 
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the organization nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY  THE AUTHOR ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <sys/time.h>
+
+#include "fft.h"
+
+#define MAX_LENGTH 4096
+#define N_LOOPS 100
+#define N_TESTS 10
+
+#define TOLERANCE 1e-5
+
+long time_delta(struct timeval* now, struct timeval* then)
+{
+    long delta = 0l;
+
+    delta += (now->tv_sec - then->tv_sec) * 1000000;
+    delta += (now->tv_usec - then->tv_usec);
+
+    return delta;
+}
+
+/* The DFT straight from its definition, in double precision, to check
+ * the FFT against. ``in'' is complex unless ``real'' is set, and the
+ * first n_out bins are computed.
+ * */
+void naive_dft(float* in, double* out, int length, int n_out, int real)
+{
+    for (int k=0; k<n_out; k++){
+        double sum_re = 0.0;
+        double sum_im = 0.0;
+
+        for (int t=0; t<length; t++){
+            double re = real ? in[t] : in[2*t];
+            double im = real ? 0.0 : in[2*t + 1];
+            double angle = -2.0 * 3.14159265358979323846 * 
+                ((double) k * t / length);
+
+            sum_re += re*cos(angle) - im*sin(angle);
+            sum_im += re*sin(angle) + im*cos(angle);
+        }
+
+        out[2*k] = sum_re;
+        out[2*k + 1] = sum_im;
+    }
+}
+
+/* The largest error relative to the largest magnitude in the reference. */
+double relative_error(float* test, double* reference, int n_floats)
+{
+    double error = 0.0;
+    double largest = 1.0;
+
+    for (int i=0; i<n_floats; i++){
+        error = fmax(error, fabs(test[i] - reference[i]));
+        largest = fmax(largest, fabs(reference[i]));
+    }
+
+    return error / largest;
+}
+
+int check(const char* name, int length, double error)
+{
+    if (error > TOLERANCE){
+        printf("%s of length %d is incorrect (error %g).\n",
+                name, length, error);
+        return -1;
+    }
+    return 0;
+}
+
+/* Times ``loops'' calls of whichever transform ``which'' selects, and
+ * returns the lowest time per call over N_TESTS runs in microseconds.
+ * */
+float time_transform(int which, fft_plan* plan, fft_real_plan* real_plan,
+        float* in, float* out, double* reference, int length, int loops)
+{
+    struct timeval now, then;
+    float min_delta = -1.0;
+
+    for (int j=0; j<N_TESTS; j++){
+        gettimeofday(&then, NULL);
+
+        for (int n=0; n<loops; n++){
+            switch (which){
+                case 0:
+                    fft_forward(plan, in, out);
+                    break;
+                case 1:
+                    fft_real_forward(real_plan, in, out);
+                    break;
+                default:
+                    naive_dft(in, reference, length, length, 0);
+            }
+        }
+
+        gettimeofday(&now, NULL);
+        float delta = ((float)time_delta(&now, &then))/loops;
+
+        min_delta = ((min_delta == -1.0) || 
+                (delta < min_delta)) ? delta : min_delta;
+    }
+
+    return min_delta;
+}
+
+int main()
+{
+    float* in = malloc(sizeof(float)*(2*MAX_LENGTH + 2));
+    float* out = malloc(sizeof(float)*(2*MAX_LENGTH + 2));
+    float* buffer = malloc(sizeof(float)*(2*MAX_LENGTH + 2));
+    double* reference = malloc(sizeof(double)*(2*MAX_LENGTH + 2));
+
+    srand(0);
+    for (int i=0; i<2*MAX_LENGTH; i++){
+        in[i] = ((float) rand() / RAND_MAX) - 0.5f;
+    }
+
+    int failed = 0;
+
+    /* Every length is checked against the naive DFT, out of place and in
+     * place, and by the round trip through the inverse.
+     * */
+    for (int length=2; length<=MAX_LENGTH; length*=2){
+        fft_plan plan;
+        fft_real_plan real_plan;
+
+        if (fft_plan_init(&plan, length) != 0 ||
+                fft_real_plan_init(&real_plan, length) != 0){
+            printf("Could not make the plans for length %d.\n", length);
+            return -1;
+        }
+
+        naive_dft(in, reference, length, length, 0);
+
+        fft_forward(&plan, in, out);
+        failed |= check("Complex FFT", length,
+                relative_error(out, reference, 2*length));
+
+        for (int i=0; i<2*length; i++){
+            buffer[i] = in[i];
+        }
+        fft_forward(&plan, buffer, buffer);
+        failed |= check("In place complex FFT", length,
+                relative_error(buffer, reference, 2*length));
+
+        fft_inverse(&plan, buffer, buffer);
+        double error = 0.0;
+        for (int i=0; i<2*length; i++){
+            error = fmax(error, fabs(buffer[i]/length - in[i]));
+        }
+        failed |= check("Complex FFT round trip", length, error);
+
+        naive_dft(in, reference, length, length/2 + 1, 1);
+
+        fft_real_forward(&real_plan, in, out);
+        failed |= check("Real FFT", length,
+                relative_error(out, reference, length + 2));
+
+        for (int i=0; i<length; i++){
+            buffer[i] = in[i];
+        }
+        fft_real_forward(&real_plan, buffer, buffer);
+        failed |= check("In place real FFT", length,
+                relative_error(buffer, reference, length + 2));
+
+        fft_real_inverse(&real_plan, buffer, buffer);
+        error = 0.0;
+        for (int i=0; i<length; i++){
+            error = fmax(error, fabs(buffer[i]/length - in[i]));
+        }
+        failed |= check("Real FFT round trip", length, error);
+
+        fft_plan_destroy(&plan);
+        fft_real_plan_destroy(&real_plan);
+    }
+
+    if (failed){
+        return -1;
+    }
+
+    printf("FFT is valid.\n");
+
+    printf("Running %d tests of %d loops\n", N_TESTS, N_LOOPS);
+
+    for (int length=64; length<=MAX_LENGTH; length*=4){
+        fft_plan plan;
+        fft_real_plan real_plan;
+
+        fft_plan_init(&plan, length);
+        fft_real_plan_init(&real_plan, length);
+
+        printf("Length %d: complex %1.3f, real %1.3f, "
+                "naive DFT %1.3f microseconds per loop.\n", length,
+                time_transform(0, &plan, &real_plan, in, out, reference,
+                    length, N_LOOPS),
+                time_transform(1, &plan, &real_plan, in, out, reference,
+                    length, N_LOOPS),
+                time_transform(2, &plan, &real_plan, in, out, reference,
+                    length, length > 256 ? 1 : N_LOOPS/10));
+
+        fft_plan_destroy(&plan);
+        fft_real_plan_destroy(&real_plan);
+    }
+
+    free(in);
+    free(out);
+    free(buffer);
+    free(reference);
+
+    return 0;
+}
@@ -0,0 +1,256 @@
+/* Copyright (C) 2012 Henry Gomersall <heng@cantab.net> 
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the organization nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY  THE AUTHOR ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "guided.h"
+
+#ifdef SSE3
+
+/* The mean of each box_cols x box_rows box of ``in'', summed out in
+ * full.
+ * */
+void reference_box(double* in, double* out, int cols, int rows,
+        int box_cols, int box_rows)
+{
+    int out_cols = cols - box_cols + 1;
+    int out_rows = rows - box_rows + 1;
+
+    for (int row=0; row<out_rows; row++){
+        for (int col=0; col<out_cols; col++){
+            double sum = 0.0;
+            for (int y=0; y<box_rows; y++){
+                for (int x=0; x<box_cols; x++){
+                    sum += in[(row + y)*cols + col + x];
+                }
+            }
+            out[row*out_cols + col] = sum / (box_cols*box_rows);
+        }
+    }
+}
+
+/* The guided filter from its definition, one box after another. */
+void reference_guided(float* guide, float* in, double* out, int cols,
+        int rows, int radius, float epsilon)
+{
+    int box = 2*radius + 1;
+    int length = cols*rows;
+    int mid_cols = cols - 2*radius;
+    int mid_length = mid_cols*(rows - 2*radius);
+
+    double* images = malloc(4*length*sizeof(double));
+    double* means = malloc(4*mid_length*sizeof(double));
+    double* a = malloc(2*mid_length*sizeof(double));
+    double* b = a + mid_length;
+    double* mean_a = malloc(2*length*sizeof(double));
+    double* mean_b = mean_a + length;
+
+    for (int i=0; i<length; i++){
+        images[i] = guide[i];
+        images[length + i] = in[i];
+        images[2*length + i] = (double) guide[i]*guide[i];
+        images[3*length + i] = (double) guide[i]*in[i];
+    }
+    for (int q=0; q<4; q++){
+        reference_box(images + q*length, means + q*mid_length, cols, rows,
+                box, box);
+    }
+
+    for (int i=0; i<mid_length; i++){
+        double mean_guide = means[i];
+        double mean_in = means[mid_length + i];
+        double variance = means[2*mid_length + i] - mean_guide*mean_guide;
+        double covariance = means[3*mid_length + i] - mean_guide*mean_in;
+
+        a[i] = covariance / (variance + epsilon);
+        b[i] = mean_in - a[i]*mean_guide;
+    }
+
+    int out_cols = cols - 4*radius;
+    reference_box(a, mean_a, mid_cols, rows - 2*radius, box, box);
+    reference_box(b, mean_b, mid_cols, rows - 2*radius, box, box);
+
+    for (int row=0; row<rows - 4*radius; row++){
+        for (int col=0; col<out_cols; col++){
+            int i = row*out_cols + col;
+            out[i] = mean_a[i]*guide[(row + 2*radius)*cols + col + 2*radius]
+                + mean_b[i];
+        }
+    }
+
+    free(images);
+    free(means);
+    free(a);
+    free(mean_a);
+}
+
+/* The largest difference between ``a'' and ``b''. */
+double max_error(float* a, double* b, int length)
+{
+    double error = 0.0;
+    for (int i=0; i<length; i++){
+        // Written so that a NaN is the largest error
+        if (!(fabs(a[i] - b[i]) <= error)){
+            error = isnan(a[i] - b[i]) ? INFINITY : fabs(a[i] - b[i]);
+        }
+    }
+    return error;
+}
+
+/* Boxes either side of the width where the row sums stop being a
+ * convolution, on an image tall enough for several strips of rows, and
+ * the boxes the filter refuses or has no room for.
+ * */
+int check_box()
+{
+    int cols = 131;
+    int rows = 250;
+    float* in = malloc(sizeof(float)*cols*rows);
+    float* out = malloc(sizeof(float)*cols*rows);
+    double* in_double = malloc(sizeof(double)*cols*rows);
+    double* expected = malloc(sizeof(double)*cols*rows);
+
+    for (int i=0; i<cols*rows; i++){
+        in[i] = (float) rand() / RAND_MAX;
+        in_double[i] = in[i];
+    }
+
+    int failed = 0;
+    int sizes[][2] = {{1, 1}, {3, 3}, {7, 2}, {32, 5}, {33, 5}, {1, 9},
+        {64, 3}, {131, 1}};
+
+    for (int s=0; s<8; s++){
+        int box_cols = sizes[s][0];
+        int box_rows = sizes[s][1];
+        int out_length = (cols - box_cols + 1)*(rows - box_rows + 1);
+
+        reference_box(in_double, expected, cols, rows, box_cols, box_rows);
+        int wrong = convolve_sse_2d_box(in, out, cols, rows, box_cols,
+                box_rows) != 0;
+        double error = max_error(out, expected, out_length);
+
+        if (wrong || error > 1e-5){
+            printf("The %dx%d box is off by %g.\n", box_cols, box_rows,
+                    error);
+            failed = -1;
+        }
+    }
+
+    if (convolve_sse_2d_box(in, out, cols, rows, 0, 3) != -1 ||
+            convolve_sse_2d_box(in, out, cols, rows, 3, -1) != -1 ||
+            convolve_sse_2d_box(in, out, cols, rows, cols + 1, 3) != 0){
+        printf("The box filter took a box it should refuse.\n");
+        failed = -1;
+    }
+
+    free(in);
+    free(out);
+    free(in_double);
+    free(expected);
+
+    return failed;
+}
+
+/* The guided filter at radii whose boxes are either side of the same
+ * width, again over several strips, with an input that isn't the guide.
+ * */
+int check_guided()
+{
+    int cols = 150;
+    int rows = 700;
+    float* guide = malloc(sizeof(float)*cols*rows);
+    float* in = malloc(sizeof(float)*cols*rows);
+    float* out = malloc(sizeof(float)*cols*rows);
+    double* expected = malloc(sizeof(double)*cols*rows);
+
+    for (int row=0; row<rows; row++){
+        for (int col=0; col<cols; col++){
+            float noise = (float) rand() / RAND_MAX;
+            guide[row*cols + col] = (col < cols/2 ? 0.2f : 0.8f)
+                + 0.1f*noise;
+            in[row*cols + col] = 0.5f*guide[row*cols + col]
+                + 0.2f*((float) rand() / RAND_MAX);
+        }
+    }
+
+    int failed = 0;
+    int radii[] = {0, 1, 2, 8, 15, 16};
+
+    for (int r=0; r<6; r++){
+        int radius = radii[r];
+        int out_length = (cols - 4*radius)*(rows - 4*radius);
+
+        reference_guided(guide, in, expected, cols, rows, radius, 0.01f);
+        int wrong = convolve_sse_2d_guided(guide, in, out, cols, rows,
+                radius, 0.01f) != 0;
+        double error = max_error(out, expected, out_length);
+
+        if (wrong || error > 1e-5){
+            printf("The guided filter of radius %d is off by %g.\n",
+                    radius, error);
+            failed = -1;
+        }
+    }
+
+    if (convolve_sse_2d_guided(guide, in, out, cols, rows, -1, 0.01f) != -1
+            || convolve_sse_2d_guided(guide, in, out, cols, rows,
+                cols/4, 0.01f) != 0){
+        printf("The guided filter took a radius it should refuse.\n");
+        failed = -1;
+    }
+
+    free(guide);
+    free(in);
+    free(out);
+    free(expected);
+
+    return failed;
+}
+
+#endif
+
+int main()
+{
+    srand(0);
+
+    int failed = 0;
+
+#ifdef SSE3
+    failed |= check_box();
+    failed |= check_guided();
+#endif
+
+    if (failed){
+        return -1;
+    }
+
+    printf("Box and guided filters are valid.\n");
+
+    return 0;
+}
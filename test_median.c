@@ -0,0 +1,246 @@
+/* Copyright (C) 2012 Henry Gomersall <heng@cantab.net> 
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the organization nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY  THE AUTHOR ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "median.h"
+
+int compare_float(const void* a, const void* b)
+{
+    float x = *(const float*) a;
+    float y = *(const float*) b;
+    return (x > y) - (x < y);
+}
+
+int compare_u8(const void* a, const void* b)
+{
+    return *(const uint8_t*) a - *(const uint8_t*) b;
+}
+
+/* Sorts the ``n'' samples and returns the one of ``rank''. */
+float sorted_float(float* samples, int n, int rank)
+{
+    qsort(samples, n, sizeof(float), compare_float);
+    return samples[rank];
+}
+
+/* Every odd window the 1D median takes, out of place and in place, and
+ * the windows it refuses.
+ * */
+int check_1d()
+{
+    int length = 301;
+    float in[length];
+    float out[length];
+    float expected[length];
+    float samples[64];
+
+    for (int i=0; i<length; i++){
+        in[i] = ((float) rand() / RAND_MAX) - 0.5f;
+    }
+
+    int failed = 0;
+
+    for (int window=1; window<64; window+=2){
+        int out_length = length - window + 1;
+
+        for (int i=0; i<out_length; i++){
+            memcpy(samples, in + i, window*sizeof(float));
+            expected[i] = sorted_float(samples, window, (window - 1)/2);
+        }
+
+        int wrong = median_1d(in, out, length, window) != 0 ||
+            memcmp(out, expected, out_length*sizeof(float)) != 0;
+
+        memcpy(out, in, length*sizeof(float));
+        wrong |= median_1d(out, out, length, window) != 0 ||
+            memcmp(out, expected, out_length*sizeof(float)) != 0;
+
+        if (wrong){
+            printf("The 1D median of %d is incorrect.\n", window);
+            failed = -1;
+        }
+    }
+
+    int refused[] = {0, 2, 64, 65};
+    for (int i=0; i<4; i++){
+        if (median_1d(in, out, length, refused[i]) != -1){
+            printf("The 1D median took a window of %d.\n", refused[i]);
+            failed = -1;
+        }
+    }
+
+    return failed;
+}
+
+/* The 2D median up to the 7x7 limit, and the 9x9 it refuses. */
+int check_2d()
+{
+    int cols = 53;
+    int rows = 31;
+    float* in = malloc(sizeof(float)*cols*rows);
+    float* out = malloc(sizeof(float)*cols*rows);
+    float samples[49];
+
+    for (int i=0; i<cols*rows; i++){
+        in[i] = ((float) rand() / RAND_MAX) - 0.5f;
+    }
+
+    int failed = 0;
+
+    for (int window=1; window<=7; window+=2){
+        int out_cols = cols - window + 1;
+        int out_rows = rows - window + 1;
+        int wrong = median_2d(in, out, cols, rows, window) != 0;
+
+        for (int row=0; row<out_rows && !wrong; row++){
+            for (int col=0; col<out_cols; col++){
+                for (int y=0; y<window; y++){
+                    memcpy(samples + y*window, in + (row + y)*cols + col,
+                            window*sizeof(float));
+                }
+                wrong |= out[row*out_cols + col] != sorted_float(samples,
+                        window*window, (window*window - 1)/2);
+            }
+        }
+
+        if (wrong){
+            printf("The %dx%d median is incorrect.\n", window, window);
+            failed = -1;
+        }
+    }
+
+    if (median_2d(in, out, cols, rows, 9) != -1 ||
+            median_2d(in, out, cols, rows, 4) != -1){
+        printf("The 2D median took a window it should refuse.\n");
+        failed = -1;
+    }
+
+    free(in);
+    free(out);
+
+    return failed;
+}
+
+/* The 8-bit rank filter at several radii, including ones whose strips
+ * of rows split the image, at the lowest, median, highest and other
+ * ranks.
+ * */
+int check_u8()
+{
+    int cols = 97;
+    int rows = 83;
+    uint8_t* in = malloc(cols*rows);
+    uint8_t* out = malloc(6*cols*rows);
+    uint8_t* samples = malloc(41*41);
+
+    for (int i=0; i<cols*rows; i++){
+        // Narrow ranges make many ties
+        in[i] = i < cols*rows/2 ? rand() % 256 : 100 + rand() % 8;
+    }
+
+    int failed = 0;
+    int radii[] = {0, 1, 2, 3, 7, 20};
+
+    for (int r=0; r<6; r++){
+        int radius = radii[r];
+        int window = 2*radius + 1;
+        int n = window*window;
+        int out_cols = cols - window + 1;
+        int out_rows = rows - window + 1;
+        int out_length = out_cols*out_rows;
+
+        // The last is the median, from median_2d_u8
+        int ranks[] = {0, n/4, (n - 1)/2, n - 2 > 0 ? n - 2 : 0, n - 1,
+            2*radius*(radius + 1)};
+        int wrong[6];
+
+        for (int k=0; k<6; k++){
+            wrong[k] = k < 5 ?
+                median_rank_2d_u8(in, out + k*out_length, cols, rows,
+                        radius, ranks[k]) != 0 :
+                median_2d_u8(in, out + k*out_length, cols, rows,
+                        radius) != 0;
+        }
+
+        for (int row=0; row<out_rows; row++){
+            for (int col=0; col<out_cols; col++){
+                for (int y=0; y<window; y++){
+                    memcpy(samples + y*window, in + (row + y)*cols + col,
+                            window);
+                }
+                qsort(samples, n, sizeof(uint8_t), compare_u8);
+
+                for (int k=0; k<6; k++){
+                    wrong[k] |= out[k*out_length + row*out_cols + col] !=
+                        samples[ranks[k]];
+                }
+            }
+        }
+
+        for (int k=0; k<6; k++){
+            if (wrong[k]){
+                printf("The 8-bit rank %d of radius %d is incorrect.\n",
+                        ranks[k], radius);
+                failed = -1;
+            }
+        }
+
+        if (median_rank_2d_u8(in, out, cols, rows, radius, n) != -1 ||
+                median_rank_2d_u8(in, out, cols, rows, radius, -1) != -1){
+            printf("The 8-bit rank filter took a rank it should refuse.\n");
+            failed = -1;
+        }
+    }
+
+    free(in);
+    free(out);
+    free(samples);
+
+    return failed;
+}
+
+int main()
+{
+    srand(0);
+
+    int failed = 0;
+    failed |= check_1d();
+    failed |= check_2d();
+    failed |= check_u8();
+
+    if (failed){
+        return -1;
+    }
+
+    printf("Median filters are valid.\n");
+
+    return 0;
+}
@@ -0,0 +1,251 @@
+/* Copyright (C) 2012 Henry Gomersall <heng@cantab.net> 
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the organization nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY  THE AUTHOR ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "morphology.h"
+
+void random_fill(float* data, int length)
+{
+    for (int i=0; i<length; i++){
+        data[i] = ((float) rand() / RAND_MAX) - 0.5f;
+    }
+}
+
+/* The flat and weighted elements straight from their definitions; a NULL
+ * ``element'' is flat. Every output is one of the sums the functions
+ * make, so they must match exactly.
+ * */
+void reference(float* in, float* out, int length, float* element,
+        int element_length, int erode)
+{
+    for (int i=0; i<=length-element_length; i++){
+        float value = erode ? INFINITY : -INFINITY;
+
+        for (int k=0; k<element_length; k++){
+            float sample = in[i+k];
+            if (element != NULL){
+                sample = erode ? sample - element[k] :
+                    sample + element[element_length - k - 1];
+            }
+            value = erode ? fminf(value, sample) : fmaxf(value, sample);
+        }
+        out[i] = value;
+    }
+}
+
+int check(const char* name, float* test, float* expected, int length,
+        int element_length)
+{
+    if (memcmp(test, expected, length*sizeof(float)) != 0){
+        printf("%s with an element of %d is incorrect.\n", name,
+                element_length);
+        return -1;
+    }
+    return 0;
+}
+
+/* Flat elements either side of the switch to van Herk/Gil-Werman at 64,
+ * out of place and in place.
+ * */
+int check_flat()
+{
+    int length = 1000;
+    int lengths[] = {1, 2, 5, 17, 63, 64, 65, 100, 333, 1000};
+    int n_lengths = sizeof(lengths)/sizeof(lengths[0]);
+
+    float* in = malloc(sizeof(float)*length);
+    float* out = malloc(sizeof(float)*length);
+    float* expected = malloc(sizeof(float)*length);
+    float* workspace = malloc(sizeof(float)*length);
+    random_fill(in, length);
+
+    int failed = 0;
+
+    for (int n=0; n<n_lengths; n++){
+        int element_length = lengths[n];
+        int out_length = length - element_length + 1;
+
+        for (int erode=0; erode<2; erode++){
+            int (*function)(float*, float*, int, int, float*) =
+                erode ? morphology_erode : morphology_dilate;
+            const char* name = erode ? "Erosion" : "Dilation";
+
+            reference(in, expected, length, NULL, element_length, erode);
+
+            function(in, out, length, element_length, workspace);
+            failed |= check(name, out, expected, out_length,
+                    element_length);
+
+            memcpy(out, in, sizeof(float)*length);
+            function(out, out, length, element_length, workspace);
+            failed |= check(name, out, expected, out_length,
+                    element_length);
+        }
+    }
+
+    free(in);
+    free(out);
+    free(expected);
+    free(workspace);
+
+    return failed;
+}
+
+/* An element that is not symmetric, so that dilation must reverse it and
+ * erosion must not.
+ * */
+int check_weighted()
+{
+    int length = 777;
+    int lengths[] = {1, 2, 3, 8, 31};
+    int n_lengths = sizeof(lengths)/sizeof(lengths[0]);
+
+    float element[31];
+    float* in = malloc(sizeof(float)*length);
+    float* out = malloc(sizeof(float)*length);
+    float* expected = malloc(sizeof(float)*length);
+    random_fill(in, length);
+
+    int failed = 0;
+
+    for (int n=0; n<n_lengths; n++){
+        int element_length = lengths[n];
+        int out_length = length - element_length + 1;
+        random_fill(element, element_length);
+
+        reference(in, expected, length, element, element_length, 0);
+        morphology_dilate_weighted(in, out, length, element,
+                element_length);
+        failed |= check("Weighted dilation", out, expected, out_length,
+                element_length);
+
+        reference(in, expected, length, element, element_length, 1);
+        morphology_erode_weighted(in, out, length, element,
+                element_length);
+        failed |= check("Weighted erosion", out, expected, out_length,
+                element_length);
+    }
+
+    free(in);
+    free(out);
+    free(expected);
+
+    return failed;
+}
+
+/* Rectangles with heights either side of the switch to van Herk/Gil-Werman
+ * down the columns at 12, and widths either side of the one along the
+ * rows.
+ * */
+int check_rectangle()
+{
+    int cols = 150;
+    int rows = 90;
+    int sizes[][2] = {{1, 1}, {3, 5}, {64, 12}, {65, 13}, {7, 40},
+        {100, 2}, {150, 90}};
+    int n_sizes = sizeof(sizes)/sizeof(sizes[0]);
+
+    float* in = malloc(sizeof(float)*cols*rows);
+    float* out = malloc(sizeof(float)*cols*rows);
+    float* expected = malloc(sizeof(float)*cols*rows);
+    float* workspace = malloc(sizeof(float)*cols*rows);
+    float column[rows];
+    float column_out[rows];
+    random_fill(in, cols*rows);
+
+    int failed = 0;
+
+    for (int n=0; n<n_sizes; n++){
+        int element_cols = sizes[n][0];
+        int element_rows = sizes[n][1];
+        int out_cols = cols - element_cols + 1;
+        int out_rows = rows - element_rows + 1;
+
+        for (int erode=0; erode<2; erode++){
+
+            // Along the rows into the workspace, then down each column
+            for (int row=0; row<rows; row++){
+                reference(in + row*cols, workspace + row*out_cols, cols,
+                        NULL, element_cols, erode);
+            }
+            for (int col=0; col<out_cols; col++){
+                for (int row=0; row<rows; row++){
+                    column[row] = workspace[row*out_cols + col];
+                }
+                reference(column, column_out, rows, NULL, element_rows,
+                        erode);
+                for (int row=0; row<out_rows; row++){
+                    expected[row*out_cols + col] = column_out[row];
+                }
+            }
+
+            if (erode){
+                morphology_2d_erode(in, out, workspace, cols, rows,
+                        element_cols, element_rows);
+            } else {
+                morphology_2d_dilate(in, out, workspace, cols, rows,
+                        element_cols, element_rows);
+            }
+
+            if (memcmp(out, expected, sizeof(float)*out_cols*out_rows)){
+                printf("The 2D %s with a %d x %d rectangle is incorrect.\n",
+                        erode ? "erosion" : "dilation", element_cols,
+                        element_rows);
+                failed = -1;
+            }
+        }
+    }
+
+    free(in);
+    free(out);
+    free(expected);
+    free(workspace);
+
+    return failed;
+}
+
+int main()
+{
+    srand(0);
+
+    int failed = 0;
+    failed |= check_flat();
+    failed |= check_weighted();
+    failed |= check_rectangle();
+
+    if (failed){
+        return -1;
+    }
+
+    printf("Morphology is valid.\n");
+
+    return 0;
+}
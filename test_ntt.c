@@ -0,0 +1,160 @@
+/* Copyright (C) 2012 Henry Gomersall <heng@cantab.net> 
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the organization nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY  THE AUTHOR ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "ntt.h"
+
+/* A random value with |value| < 2^bits, for bits up to 31. */
+int32_t random_value(int bits)
+{
+    uint32_t r = ((uint32_t) rand() << 16) ^ (uint32_t) rand();
+    int64_t value = r & ((1u << bits) - 1);
+
+    return (int32_t) (rand() & 1 ? -value : value);
+}
+
+/* The full convolution straight from its definition. The inputs are
+ * kept small enough for every sum to fit in an int64_t.
+ * */
+void schoolbook_full(int32_t* a, int a_length, int32_t* b, int b_length,
+        int64_t* out)
+{
+    for (int i=0; i<a_length+b_length-1; i++){
+        out[i] = 0;
+    }
+    for (int i=0; i<a_length; i++){
+        for (int j=0; j<b_length; j++){
+            out[i + j] += (int64_t) a[i] * b[j];
+        }
+    }
+}
+
+/* Checks both convolutions of ``in'' and ``kernel'' against the
+ * schoolbook, exactly.
+ * */
+int check(int32_t* in, int length, int32_t* kernel, int kernel_length)
+{
+    int full_length = length + kernel_length - 1;
+    int64_t* out = malloc(sizeof(int64_t)*full_length);
+    int64_t* reference = malloc(sizeof(int64_t)*full_length);
+    int failed = 0;
+
+    schoolbook_full(in, length, kernel, kernel_length, reference);
+
+    if (ntt_convolve_full(in, length, kernel, kernel_length, out) != 0){
+        printf("The full NTT convolution of %d by %d failed.\n", length,
+                kernel_length);
+        failed = -1;
+    }
+    for (int i=0; i<full_length && !failed; i++){
+        if (out[i] != reference[i]){
+            printf("The full NTT convolution of %d by %d is wrong at %d.\n",
+                    length, kernel_length, i);
+            failed = -1;
+        }
+    }
+
+    // The valid part is the full convolution less kernel_length-1 each end
+    if (length >= kernel_length){
+        int valid_failed = 0;
+
+        if (ntt_convolve(in, out, length, kernel, kernel_length) != 0){
+            printf("The NTT convolution of %d by %d failed.\n", length,
+                    kernel_length);
+            valid_failed = -1;
+        }
+        for (int i=0; i<length-kernel_length+1 && !valid_failed; i++){
+            if (out[i] != reference[i + kernel_length - 1]){
+                printf("The NTT convolution of %d by %d is wrong at %d.\n",
+                        length, kernel_length, i);
+                valid_failed = -1;
+            }
+        }
+        failed |= valid_failed;
+    }
+
+    free(out);
+    free(reference);
+
+    return failed;
+}
+
+int main()
+{
+    /* {length, kernel_length, bits}. The lengths go either side of 768,
+     * where poly.c starts using the NTT, and of the 4096 point blocks the
+     * transform works in, and the widest values come with kernels short
+     * enough for the sums to fit in an int64_t.
+     * */
+    int cases[][3] = {
+        {1, 1, 31}, {5, 3, 20}, {17, 17, 20}, {100, 16, 24},
+        {767, 31, 20}, {768, 768, 20}, {769, 100, 20}, {770, 769, 20},
+        {1000, 37, 20}, {4095, 64, 20}, {4096, 256, 20}, {4097, 5, 30},
+        {9000, 300, 20}, {3000, 3, 30}, {3, 3000, 30},
+    };
+    int n_cases = sizeof(cases)/sizeof(cases[0]);
+
+    srand(0);
+    int failed = 0;
+
+    for (int c=0; c<n_cases; c++){
+        int length = cases[c][0];
+        int kernel_length = cases[c][1];
+
+        int32_t* in = malloc(sizeof(int32_t)*length);
+        int32_t* kernel = malloc(sizeof(int32_t)*kernel_length);
+
+        for (int i=0; i<length; i++){
+            in[i] = random_value(cases[c][2]);
+        }
+        for (int i=0; i<kernel_length; i++){
+            kernel[i] = random_value(cases[c][2]);
+        }
+        failed |= check(in, length, kernel, kernel_length);
+
+        free(in);
+        free(kernel);
+    }
+
+    // The most negative value, squared, is the largest single product
+    int32_t lowest[1000];
+    for (int i=0; i<1000; i++){
+        lowest[i] = INT32_MIN;
+    }
+    failed |= check(lowest, 1000, lowest, 1);
+
+    if (failed){
+        return -1;
+    }
+
+    printf("NTT convolution is valid.\n");
+
+    return 0;
+}
@@ -0,0 +1,254 @@
+/* Copyright (C) 2012 Henry Gomersall <heng@cantab.net> 
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the organization nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY  THE AUTHOR ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "poly.h"
+
+#define TOLERANCE 1e-4
+
+void random_fill(float* data, int length)
+{
+    for (int i=0; i<length; i++){
+        data[i] = ((float) rand() / RAND_MAX) - 0.5f;
+    }
+}
+
+/* Coefficient i of the product straight from its definition, in double
+ * precision.
+ * */
+double reference_coefficient(float* a, int a_length, float* b,
+        int b_length, int i)
+{
+    double sum = 0.0;
+    int j = i - b_length + 1 > 0 ? i - b_length + 1 : 0;
+
+    for (; j<a_length && j<=i; j++){
+        sum += (double) a[j] * b[i - j];
+    }
+    return sum;
+}
+
+/* The largest error in the product, relative to the largest coefficient,
+ * over every ``stride''th coefficient and the last one.
+ * */
+double product_error(float* a, int a_length, float* b, int b_length,
+        float* out, int stride)
+{
+    int out_length = a_length + b_length - 1;
+    double error = 0.0;
+    double largest = 1.0;
+
+    for (int i=0; i<out_length; i++){
+        if (i % stride != 0 && i != out_length - 1){
+            continue;
+        }
+
+        double reference = reference_coefficient(a, a_length, b, b_length,
+                i);
+        error = fmax(error, fabs(out[i] - reference));
+        largest = fmax(largest, fabs(reference));
+    }
+
+    return error / largest;
+}
+
+int check(const char* name, int a_length, int b_length, double error)
+{
+    if (error > TOLERANCE){
+        printf("%s of %d by %d is incorrect (error %g).\n", name, a_length,
+                b_length, error);
+        return -1;
+    }
+    return 0;
+}
+
+int check_float()
+{
+    /* {a_length, b_length}: schoolbook, Karatsuba either side of its
+     * threshold and unbalanced, the FFT, the shorter polynomial first,
+     * and a long polynomial that is far bigger than a thread's stack.
+     * */
+    int cases[][2] = {
+        {1, 1}, {7, 5}, {1000, 127}, {128, 128}, {300, 129}, {5000, 700},
+        {2047, 2047}, {2048, 2048}, {3000, 2500}, {50, 3000},
+        {4000000, 100},
+    };
+    int n_cases = sizeof(cases)/sizeof(cases[0]);
+    int failed = 0;
+
+    for (int c=0; c<n_cases; c++){
+        int a_length = cases[c][0];
+        int b_length = cases[c][1];
+        int out_length = a_length + b_length - 1;
+
+        float* a = malloc(sizeof(float)*a_length);
+        float* b = malloc(sizeof(float)*b_length);
+        float* out = malloc(sizeof(float)*out_length);
+        random_fill(a, a_length);
+        random_fill(b, b_length);
+
+        if (poly_multiply(a, a_length, b, b_length, out) != 0){
+            printf("The product of %d by %d failed.\n", a_length, b_length);
+            failed = -1;
+        }
+        else{
+            // Only a sample of the longest product is checked
+            failed |= check("The product", a_length, b_length,
+                    product_error(a, a_length, b, b_length, out,
+                        out_length > 100000 ? 997 : 1));
+        }
+
+        free(a);
+        free(b);
+        free(out);
+    }
+
+    return failed;
+}
+
+/* A batch is the same as each of its products on its own, for the
+ * schoolbook, Karatsuba and the FFT with its shared plan.
+ * */
+int check_batch()
+{
+    int cases[][3] = {{40, 9, 37}, {500, 300, 9}, {2100, 2100, 5}};
+    int failed = 0;
+
+    for (int c=0; c<3; c++){
+        int a_length = cases[c][0];
+        int b_length = cases[c][1];
+        int n = cases[c][2];
+        int out_length = a_length + b_length - 1;
+
+        float* a = malloc(sizeof(float)*a_length*n);
+        float* b = malloc(sizeof(float)*b_length*n);
+        float* out = malloc(sizeof(float)*out_length*n);
+        float* single = malloc(sizeof(float)*out_length);
+        random_fill(a, a_length*n);
+        random_fill(b, b_length*n);
+
+        if (poly_multiply_batch(a, a_length, b, b_length, out, n) != 0){
+            printf("The batch of %d by %d failed.\n", a_length, b_length);
+            failed = -1;
+        }
+
+        double error = 0.0;
+        for (int i=0; i<n; i++){
+            poly_multiply(a + i*a_length, a_length, b + i*b_length,
+                    b_length, single);
+            for (int j=0; j<out_length; j++){
+                error = fmax(error, fabs(out[i*out_length + j] - single[j]));
+            }
+        }
+        failed |= check("A batch product", a_length, b_length, error);
+
+        free(a);
+        free(b);
+        free(out);
+        free(single);
+    }
+
+    return failed;
+}
+
+/* The integer product is exact, either side of the switch to the NTT.
+ * The values are small enough for the int64_t schoolbook not to
+ * overflow.
+ * */
+int check_int()
+{
+    int cases[][2] = {{1, 1}, {10, 3}, {767, 767}, {768, 768}, {769, 2000},
+        {5000, 768}, {100, 800}};
+    int failed = 0;
+
+    for (int c=0; c<7; c++){
+        int a_length = cases[c][0];
+        int b_length = cases[c][1];
+        int out_length = a_length + b_length - 1;
+
+        int32_t* a = malloc(sizeof(int32_t)*a_length);
+        int32_t* b = malloc(sizeof(int32_t)*b_length);
+        int64_t* out = malloc(sizeof(int64_t)*out_length);
+
+        for (int i=0; i<a_length; i++){
+            a[i] = (rand() % (1 << 22)) - (1 << 21);
+        }
+        for (int i=0; i<b_length; i++){
+            b[i] = (rand() % (1 << 22)) - (1 << 21);
+        }
+
+        if (poly_multiply_int(a, a_length, b, b_length, out) != 0){
+            printf("The integer product of %d by %d failed.\n", a_length,
+                    b_length);
+            failed = -1;
+            out_length = 0;
+        }
+
+        for (int i=0; i<out_length; i++){
+            int64_t reference = 0;
+            for (int j=0; j<a_length; j++){
+                if (i - j >= 0 && i - j < b_length){
+                    reference += (int64_t) a[j] * b[i - j];
+                }
+            }
+            if (out[i] != reference){
+                printf("The integer product of %d by %d is wrong at %d.\n",
+                        a_length, b_length, i);
+                failed = -1;
+                break;
+            }
+        }
+
+        free(a);
+        free(b);
+        free(out);
+    }
+
+    return failed;
+}
+
+int main()
+{
+    srand(0);
+
+    int failed = 0;
+    failed |= check_float();
+    failed |= check_batch();
+    failed |= check_int();
+
+    if (failed){
+        return -1;
+    }
+
+    printf("Polynomial products are valid.\n");
+
+    return 0;
+}
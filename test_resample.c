@@ -0,0 +1,405 @@
+/* Copyright (C) 2012 Henry Gomersall <heng@cantab.net> 
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the organization nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY  THE AUTHOR ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "resample.h"
+#include "convolve.h"
+
+#define PI 3.14159265358979323846
+
+int filters[] = {RESAMPLE_BILINEAR, RESAMPLE_BICUBIC, RESAMPLE_LANCZOS3};
+char* filter_names[] = {"bilinear", "bicubic", "Lanczos-3"};
+double supports[] = {1.0, 2.0, 3.0};
+
+double sinc(double x)
+{
+    return x == 0.0 ? 1.0 : sin(PI*x) / (PI*x);
+}
+
+/* The filters as they are defined. */
+double filter_at(int filter, double x)
+{
+    x = fabs(x);
+
+    switch(filter){
+        case RESAMPLE_BILINEAR:
+            return x < 1.0 ? 1.0 - x : 0.0;
+        case RESAMPLE_BICUBIC:
+            return x < 1.0 ? 1.5*x*x*x - 2.5*x*x + 1.0
+                : x < 2.0 ? -0.5*x*x*x + 2.5*x*x - 4.0*x + 2.0 : 0.0;
+        default:
+            return x < 3.0 ? sinc(x) * sinc(x/3.0) : 0.0;
+    }
+}
+
+/* The weight the table gives input sample ``j'' in output ``i''. */
+double table_weight(resample_table* table, int i, int j)
+{
+    int k = j - table->starts[i];
+    if (k < 0 || k >= table->taps){
+        return 0.0;
+    }
+    return table->kernels[i*table->taps + table->taps - k - 1];
+}
+
+/* Every output's weights against the filter summed over the input
+ * positions it covers, with those past the ends on the end samples, for
+ * upscales, downscales and one big reduction. Then the blurs and
+ * filters the table refuses.
+ * */
+int check_table()
+{
+    int lengths[][2] = {{10, 10}, {10, 23}, {23, 10}, {7, 64}, {100, 3},
+        {1, 5}, {5, 1}, {200000, 2}};
+    double* expected = malloc(200000*sizeof(double));
+    int failed = 0;
+
+    for (int f=0; f<3; f++){
+        for (int l=0; l<8; l++){
+            int in_length = lengths[l][0];
+            int out_length = lengths[l][1];
+            double scale = (double) in_length / out_length;
+            double stretch = scale > 1.0 ? scale : 1.0;
+            double reach = supports[f]*stretch;
+
+            resample_table table;
+            int wrong = resample_table_init(&table, in_length, out_length,
+                    filters[f], NULL, 0) != 0;
+            double error = 0.0;
+
+            for (int i=0; i<out_length && !wrong; i++){
+                double centre = (i + 0.5)*scale - 0.5;
+                double sum = 0.0;
+
+                memset(expected, 0, in_length*sizeof(double));
+                for (int p=(int) ceil(centre - reach);
+                        p<=(int) floor(centre + reach); p++){
+                    double weight = filter_at(filters[f],
+                            (p - centre) / stretch);
+                    int j = p < 0 ? 0 : p > in_length - 1 ? in_length - 1 : p;
+                    expected[j] += weight;
+                    sum += weight;
+                }
+
+                for (int j=0; j<in_length; j++){
+                    double difference = fabs(table_weight(&table, i, j)
+                            - expected[j] / sum);
+                    error = difference > error ? difference : error;
+                }
+            }
+
+            if (wrong || error > 1e-6){
+                printf("The %s table from %d to %d is off by %g.\n",
+                        filter_names[f], in_length, out_length, error);
+                failed = -1;
+            }
+            if (!wrong){
+                resample_table_destroy(&table);
+            }
+        }
+    }
+
+    resample_table table;
+    float blur[3] = {0.25f, 0.5f, 0.25f};
+    if (resample_table_init(&table, 10, 20, RESAMPLE_BICUBIC, blur, 0) != -1
+            || resample_table_init(&table, 10, 20, RESAMPLE_BICUBIC,
+                blur, -3) != -1
+            || resample_table_init(&table, 10, 20, 3, NULL, 0) != -1
+            || resample_table_init(&table, 0, 20, RESAMPLE_BICUBIC,
+                NULL, 0) != -1){
+        printf("The resample table took arguments it should refuse.\n");
+        failed = -1;
+    }
+
+    free(expected);
+
+    return failed;
+}
+
+#if defined(SSE3) || defined(NEON)
+
+/* Resizes ``in'' with ``row_table'' and then ``col_table'' in double
+ * precision.
+ * */
+void reference_2d(float* in, double* out, int in_cols, int in_rows,
+        resample_table* row_table, resample_table* col_table)
+{
+    int out_cols = row_table->out_length;
+    int out_rows = col_table->out_length;
+    double* rows_done = malloc(in_rows*out_cols*sizeof(double));
+
+    for (int row=0; row<in_rows; row++){
+        for (int c=0; c<out_cols; c++){
+            double sum = 0.0;
+            for (int j=0; j<in_cols; j++){
+                sum += table_weight(row_table, c, j) * in[row*in_cols + j];
+            }
+            rows_done[row*out_cols + c] = sum;
+        }
+    }
+
+    for (int r=0; r<out_rows; r++){
+        for (int c=0; c<out_cols; c++){
+            double sum = 0.0;
+            for (int j=0; j<in_rows; j++){
+                sum += table_weight(col_table, r, j) * rows_done[j*out_cols + c];
+            }
+            out[r*out_cols + c] = sum;
+        }
+    }
+
+    free(rows_done);
+}
+
+/* The largest difference between ``a'' and ``b''. */
+double max_error(float* a, double* b, int length)
+{
+    double error = 0.0;
+    for (int i=0; i<length; i++){
+        // Written so that a NaN is the largest error
+        if (!(fabs(a[i] - b[i]) <= error)){
+            error = isnan(a[i] - b[i]) ? INFINITY : fabs(a[i] - b[i]);
+        }
+    }
+    return error;
+}
+
+/* Random images resized up and down by each filter, against the tables
+ * applied in double precision, at row counts either side of the vector
+ * width so that both passes have rows left over, and constant images,
+ * which must stay constant.
+ * */
+int check_2d()
+{
+    int sizes[][4] = {{64, 48, 128, 96}, {64, 48, 21, 13}, {37, 29, 53, 7},
+        {33, 3, 5, 41}, {17, 61, 17, 61}, {101, 19, 30, 66}};
+    float* in = malloc(128*128*sizeof(float));
+    float* out = malloc(128*128*sizeof(float));
+    float* workspace = malloc(128*128*sizeof(float));
+    double* expected = malloc(128*128*sizeof(double));
+    int failed = 0;
+
+    for (int f=0; f<3; f++){
+        for (int s=0; s<6; s++){
+            int in_cols = sizes[s][0];
+            int in_rows = sizes[s][1];
+            int out_cols = sizes[s][2];
+            int out_rows = sizes[s][3];
+            int out_length = out_cols*out_rows;
+
+            for (int i=0; i<in_cols*in_rows; i++){
+                in[i] = ((float) rand() / RAND_MAX) - 0.5f;
+            }
+
+            resample_table row_table;
+            resample_table col_table;
+            resample_table_init(&row_table, in_cols, out_cols, filters[f],
+                    NULL, 0);
+            resample_table_init(&col_table, in_rows, out_rows, filters[f],
+                    NULL, 0);
+            reference_2d(in, expected, in_cols, in_rows, &row_table,
+                    &col_table);
+            resample_table_destroy(&row_table);
+            resample_table_destroy(&col_table);
+
+            int wrong = resample_2d(in, out, workspace, in_cols, in_rows,
+                    out_cols, out_rows, filters[f]) != 0;
+            double error = max_error(out, expected, out_length);
+
+            if (wrong || error > 1e-5){
+                printf("The %s resize from %dx%d to %dx%d is off by %g.\n",
+                        filter_names[f], in_cols, in_rows, out_cols,
+                        out_rows, error);
+                failed = -1;
+            }
+
+            for (int i=0; i<in_cols*in_rows; i++){
+                in[i] = 0.75f;
+            }
+            for (int i=0; i<out_length; i++){
+                expected[i] = 0.75;
+            }
+
+            wrong = resample_2d(in, out, workspace, in_cols, in_rows,
+                    out_cols, out_rows, filters[f]) != 0;
+            error = max_error(out, expected, out_length);
+
+            if (wrong || error > 1e-6){
+                printf("The %s resize from %dx%d to %dx%d changes a "
+                        "constant by %g.\n", filter_names[f], in_cols,
+                        in_rows, out_cols, out_rows, error);
+                failed = -1;
+            }
+        }
+    }
+
+    free(in);
+    free(out);
+    free(workspace);
+    free(expected);
+
+    return failed;
+}
+
+#ifdef SSE3
+
+/* Convolves the ``length'' samples from ``in'', ``stride'' apart, with
+ * ``blur'', ends repeated, through the generic convolution, into
+ * ``out'' with the same stride.
+ * */
+void blur_line(float* in, float* out, int length, int stride, float* blur,
+        int blur_length)
+{
+    int centre = (blur_length - 1)/2;
+    float padded[length + blur_length - 1];
+    float blurred[length];
+
+    for (int k=0; k<length + blur_length - 1; k++){
+        int j = k - centre;
+        j = j < 0 ? 0 : j > length - 1 ? length - 1 : j;
+        padded[k] = in[j*stride];
+    }
+    convolve_sse_generic(padded, blurred, length + blur_length - 1, blur,
+            blur_length);
+    for (int k=0; k<length; k++){
+        out[k*stride] = blurred[k];
+    }
+}
+
+/* Tables with a blur folded in against blurring first, with the generic
+ * convolution, and then resizing, for blurs that aren't symmetric so
+ * that their order shows.
+ * */
+int check_blur()
+{
+    int in_cols = 45;
+    int in_rows = 38;
+    float* in = malloc(in_cols*in_rows*sizeof(float));
+    float* blurred = malloc(in_cols*in_rows*sizeof(float));
+    float* out = malloc(90*90*sizeof(float));
+    float* expected = malloc(90*90*sizeof(float));
+    float* workspace = malloc(90*90*sizeof(float));
+
+    float blur_odd[5] = {0.05f, 0.1f, 0.2f, 0.3f, 0.35f};
+    float blur_even[4] = {0.4f, 0.3f, 0.2f, 0.1f};
+    float* blurs[] = {blur_odd, blur_even};
+    int blur_lengths[] = {5, 4};
+    int sizes[][2] = {{90, 77}, {20, 11}, {13, 50}};
+    int failed = 0;
+
+    for (int i=0; i<in_cols*in_rows; i++){
+        in[i] = ((float) rand() / RAND_MAX) - 0.5f;
+    }
+
+    for (int b=0; b<2; b++){
+        float* blur = blurs[b];
+        int blur_length = blur_lengths[b];
+
+        for (int row=0; row<in_rows; row++){
+            blur_line(in + row*in_cols, blurred + row*in_cols, in_cols, 1,
+                    blur, blur_length);
+        }
+        for (int col=0; col<in_cols; col++){
+            blur_line(blurred + col, blurred + col, in_rows, in_cols,
+                    blur, blur_length);
+        }
+
+        for (int s=0; s<3; s++){
+            for (int f=0; f<3; f++){
+                int out_cols = sizes[s][0];
+                int out_rows = sizes[s][1];
+
+                resample_table row_table;
+                resample_table col_table;
+                resample_table_init(&row_table, in_cols, out_cols,
+                        filters[f], blur, blur_length);
+                resample_table_init(&col_table, in_rows, out_rows,
+                        filters[f], blur, blur_length);
+
+                int wrong = resample_2d_tables(in, out, workspace, in_cols,
+                        in_rows, &row_table, &col_table) != 0;
+                wrong |= resample_2d(blurred, expected, workspace, in_cols,
+                        in_rows, out_cols, out_rows, filters[f]) != 0;
+
+                float error = 0.0f;
+                for (int i=0; i<out_cols*out_rows; i++){
+                    float difference = fabsf(out[i] - expected[i]);
+                    error = difference > error ? difference : error;
+                }
+
+                if (wrong || !(error <= 1e-5f)){
+                    printf("The folded %d tap blur with %s to %dx%d is "
+                            "off by %g.\n", blur_length, filter_names[f],
+                            out_cols, out_rows, error);
+                    failed = -1;
+                }
+
+                resample_table_destroy(&row_table);
+                resample_table_destroy(&col_table);
+            }
+        }
+    }
+
+    free(in);
+    free(blurred);
+    free(out);
+    free(expected);
+    free(workspace);
+
+    return failed;
+}
+
+#endif
+
+#endif
+
+int main()
+{
+    srand(0);
+
+    int failed = 0;
+    failed |= check_table();
+
+#if defined(SSE3) || defined(NEON)
+    failed |= check_2d();
+#endif
+#ifdef SSE3
+    failed |= check_blur();
+#endif
+
+    if (failed){
+        return -1;
+    }
+
+    printf("Resampling is valid.\n");
+
+    return 0;
+}
@@ -0,0 +1,219 @@
+/* Copyright (C) 2012 Henry Gomersall <heng@cantab.net> 
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the organization nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY  THE AUTHOR ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "spectrum_cache.h"
+
+#define KERNEL_LENGTH 8
+#define SPECTRUM_LENGTH 24
+
+/* Each entry is the kernel and its spectrum. */
+#define ENTRY_BYTES ((KERNEL_LENGTH + SPECTRUM_LENGTH)*sizeof(float))
+
+/* A stand-in for the transform, which can be told apart for each kernel
+ * and transform length and counts how often it is called.
+ * */
+int fake_transform(float* kernel, int kernel_length, int transform_length,
+        float* spectrum, void* context)
+{
+    for (int i=0; i<SPECTRUM_LENGTH; i++){
+        spectrum[i] = kernel[i % kernel_length] + transform_length;
+    }
+    (*(int*) context)++;
+
+    return 0;
+}
+
+/* A transform that always fails. */
+int failing_transform(float* kernel, int kernel_length,
+        int transform_length, float* spectrum, void* context)
+{
+    (*(int*) context)++;
+
+    return -1;
+}
+
+/* Gets the spectrum of kernel ``which'' for a transform of
+ * transform_length, and checks that it is the right one and that the
+ * transform was called only if ``miss'' is set.
+ * */
+int get(spectrum_cache* cache, float kernels[][KERNEL_LENGTH], int which,
+        int transform_length, int miss)
+{
+    int calls = 0;
+    float* spectrum = spectrum_cache_get(cache, kernels[which],
+            KERNEL_LENGTH, transform_length, SPECTRUM_LENGTH,
+            fake_transform, &calls);
+
+    if (spectrum == NULL){
+        printf("Kernel %d could not be cached.\n", which);
+        return -1;
+    }
+
+    for (int i=0; i<SPECTRUM_LENGTH; i++){
+        if (spectrum[i] != kernels[which][i % KERNEL_LENGTH] + 
+                transform_length){
+            printf("The spectrum for kernel %d is wrong.\n", which);
+            return -1;
+        }
+    }
+
+    if (calls != miss){
+        printf("Kernel %d was %s when it should %shave been.\n", which,
+                calls ? "transformed" : "not transformed", miss ? "" : "not ");
+        return -1;
+    }
+
+    return 0;
+}
+
+int check_stats(spectrum_cache* cache, long hits, long misses,
+        long evictions, int entries)
+{
+    spectrum_cache_stats stats;
+    spectrum_cache_get_stats(cache, &stats);
+
+    if (stats.hits != hits || stats.misses != misses ||
+            stats.evictions != evictions || stats.entries != entries ||
+            stats.bytes != entries*ENTRY_BYTES){
+        printf("The stats are %ld hits, %ld misses, %ld evictions and %d "
+                "entries (%zu bytes), rather than %ld, %ld, %ld and %d.\n",
+                stats.hits, stats.misses, stats.evictions, stats.entries,
+                stats.bytes, hits, misses, evictions, entries);
+        return -1;
+    }
+    return 0;
+}
+
+int main()
+{
+    float kernels[4][KERNEL_LENGTH];
+
+    for (int k=0; k<4; k++){
+        for (int i=0; i<KERNEL_LENGTH; i++){
+            kernels[k][i] = k*KERNEL_LENGTH + i;
+        }
+    }
+
+    spectrum_cache cache;
+    int failed = 0;
+
+    // Room for three entries
+    spectrum_cache_init(&cache, 3*ENTRY_BYTES + ENTRY_BYTES/2);
+
+    // A kernel is transformed once for each transform length
+    failed |= get(&cache, kernels, 0, 64, 1);
+    failed |= get(&cache, kernels, 0, 64, 0);
+    failed |= get(&cache, kernels, 0, 128, 1);
+    failed |= get(&cache, kernels, 0, 128, 0);
+    failed |= check_stats(&cache, 2, 2, 0, 2);
+
+    /* A copy of the kernel hits, but one that differs in one place
+     * misses.
+     * */
+    float copy[KERNEL_LENGTH];
+    for (int i=0; i<KERNEL_LENGTH; i++){
+        copy[i] = kernels[0][i];
+    }
+    int calls = 0;
+    spectrum_cache_get(&cache, copy, KERNEL_LENGTH, 64, SPECTRUM_LENGTH,
+            fake_transform, &calls);
+    copy[KERNEL_LENGTH - 1] += 1.0f;
+    spectrum_cache_get(&cache, copy, KERNEL_LENGTH, 64, SPECTRUM_LENGTH,
+            fake_transform, &calls);
+    if (calls != 1){
+        printf("Kernels are not told apart by their contents.\n");
+        failed = -1;
+    }
+    failed |= check_stats(&cache, 3, 3, 0, 3);
+
+    /* The cache now holds, newest first, the changed copy, kernel 0 at
+     * 64 and kernel 0 at 128. Using kernel 0 at 128 leaves kernel 0 at
+     * 64 and then the changed copy as the least recently used, to be
+     * evicted in that order.
+     * */
+    failed |= get(&cache, kernels, 0, 128, 0);
+    failed |= get(&cache, kernels, 1, 64, 1);
+    failed |= check_stats(&cache, 4, 4, 1, 3);
+
+    failed |= get(&cache, kernels, 0, 128, 0);
+    failed |= get(&cache, kernels, 1, 64, 0);
+    failed |= get(&cache, kernels, 2, 64, 1);
+    failed |= check_stats(&cache, 6, 5, 2, 3);
+
+    /* Both are gone, so kernel 0 at 64 misses and evicts kernel 0 at
+     * 128, which was used least recently, and then misses in turn.
+     * */
+    failed |= get(&cache, kernels, 0, 64, 1);
+    failed |= get(&cache, kernels, 1, 64, 0);
+    failed |= get(&cache, kernels, 2, 64, 0);
+    failed |= get(&cache, kernels, 0, 128, 1);
+    failed |= check_stats(&cache, 8, 7, 4, 3);
+
+    /* A transform that fails gives NULL and caches nothing, and evicts
+     * nothing either, so the kernel misses again and only then makes
+     * room.
+     * */
+    calls = 0;
+    if (spectrum_cache_get(&cache, kernels[3], KERNEL_LENGTH, 64,
+                SPECTRUM_LENGTH, failing_transform, &calls) != NULL ||
+            calls != 1){
+        printf("A failed transform was not reported.\n");
+        failed = -1;
+    }
+    failed |= check_stats(&cache, 8, 8, 4, 3);
+    failed |= get(&cache, kernels, 3, 64, 1);
+    failed |= check_stats(&cache, 8, 9, 5, 3);
+
+    /* An entry bigger than the whole budget evicts everything else but
+     * is still returned and kept, and goes as soon as anything else is
+     * added.
+     * */
+    spectrum_cache_clear(&cache);
+    failed |= check_stats(&cache, 8, 9, 5, 0);
+
+    spectrum_cache_init(&cache, ENTRY_BYTES/2);
+    failed |= get(&cache, kernels, 3, 64, 1);
+    failed |= get(&cache, kernels, 3, 64, 0);
+    failed |= check_stats(&cache, 1, 1, 0, 1);
+    failed |= get(&cache, kernels, 2, 64, 1);
+    failed |= check_stats(&cache, 1, 2, 1, 1);
+    failed |= get(&cache, kernels, 3, 64, 1);
+    failed |= check_stats(&cache, 1, 3, 2, 1);
+
+    spectrum_cache_clear(&cache);
+
+    if (failed){
+        return -1;
+    }
+
+    printf("Spectrum cache is valid.\n");
+
+    return 0;
+}